@@ -5,8 +5,11 @@
 Mutex BoardProgram::threadMutex;
 bool BoardProgram::resetConfirmed = false;
 Window* BoardProgram::templateWindow;
+EntryManager* BoardProgram::entryManager;
 uint16_t BoardProgram::scrollIndex = 0;
 uint16_t BoardProgram::currentEntry = 0;
+uint8_t BoardProgram::wipeProgress = 100;
+uint32_t BoardProgram::drawnCredentialVersion = 0;
 uint8_t BoardProgram::masterPassword[6];
 WindowType BoardProgram::currentWindow = Login;
 
@@ -54,7 +57,7 @@ uint8_t BoardProgram::initialize(void)
     int returnValue = 0;
     do
     {
-      flashMemory.eraseChip();
+      entryManager->formatStorage(); // Old data is erased in background after login
       returnValue = runFirstStartupRoutine();
 
       if(returnValue != 0)
@@ -116,51 +119,66 @@ uint8_t BoardProgram::run(void)
       serialCommunication->process();
     }
   });
+
+  Thread maintenanceThread(MAINTENANCE_PRIORITY);
+  maintenanceThread.start([this]()
+  {
+    while(true)
+    {
+      ThisThread::sleep_for(chrono::milliseconds(MAINTENANCE_INTERVAL));
+
+      entryManager->runMaintenance();
+    }
+  });
   
 
   while(true)
   {
-    serialCommunication->serialComMutex.lock();
-    EntryManager::credentialInfo = vector<tuple<uint16_t, string>>(entryManager->getEntriesTitleInfo());
-    serialCommunication->serialComMutex.unlock();
+    // Credential list is kept up to date by EntryManager
+    wipeProgress = entryManager->getWipeProgress();
 
     templateWindow->Load(mainWindow_onLoad);
 
     if(currentWindow == SendEntry)
     {
       uint8_t kbData[128];
-      uint8_t email[MAX_EMAIL_LEN];
-      uint8_t pwd[MAX_PASSWORD_LEN];
+      EntryView entry;
 
-      serialCommunication->serialComMutex.lock();
-      entryManager->getEntry(currentEntry, NULL, NULL, email, pwd, NULL);
-      serialCommunication->serialComMutex.unlock();
+      bool entryRead = entryManager->readEntry(currentEntry, ENTRY_FIELD_EMAIL | ENTRY_FIELD_PASSWORD, &entry);
 
-      uint8_t idx = 0;
       uint8_t dataIdx = 0;
-      while(email[idx] != 0xFF && email[idx] != 0x00)
+      if(entryRead)
       {
-        kbData[dataIdx++] = email[idx++];
-      }
+        uint8_t emailLength = entry.getFieldLength(ENTRY_FIELD_EMAIL);
+        copy_n(entry.getField(ENTRY_FIELD_EMAIL), emailLength, kbData);
+        dataIdx += emailLength;
 
-      kbData[dataIdx++] = US; // Unit Seperator for Tab
+        kbData[dataIdx++] = US; // Unit Seperator for Tab
 
-      idx = 0;
-      while(pwd[idx] != 0xFF && pwd[idx] != 0x00)
-      {
-        kbData[dataIdx++] = pwd[idx++];
-      }
+        uint8_t pwdLength = entry.getFieldLength(ENTRY_FIELD_PASSWORD);
+        copy_n(entry.getField(ENTRY_FIELD_PASSWORD), pwdLength, &kbData[dataIdx]);
+        dataIdx += pwdLength;
+        entry.clear();
 
-      serialCommunication->serialComMutex.lock();
-      serialCommunication->typeKeyboard((char*)kbData, dataIdx);
-      serialCommunication->serialComMutex.unlock();
+        serialCommunication->serialComMutex.lock();
+        serialCommunication->typeKeyboard((char*)kbData, dataIdx);
+        serialCommunication->serialComMutex.unlock();
+
+        entryManager->recordUse(currentEntry);
+      }
 
       currentWindow = MainWindow;
     }
     if(currentWindow == LogOff)
     {
+      // Let running EntryManager calls finish, lock is held until reset
+      entryManager->getAccessLock()->lock();
       serialComThread.terminate();
+      maintenanceThread.terminate();
       entryManager->saveSettings();
+
+      // Cached entries would survive the software reset in RAM, formatStorage() wipes them on reset
+      entryManager->clearEntryCache();
       break;
     }
     else if(currentWindow == ResetConfirm)
@@ -169,8 +187,10 @@ uint8_t BoardProgram::run(void)
 
       if(resetConfirmed)
       {
+        entryManager->getAccessLock()->lock();
         serialComThread.terminate();
-        flashMemory.eraseChip();
+        maintenanceThread.terminate();
+        entryManager->formatStorage();
         break;
       }
     }
@@ -6,6 +6,8 @@
 #include <cstdio>
 
 #define BOARD_SOFTWARE_VERSION "KeylessGo 1.1 alpha"
+#define MAINTENANCE_INTERVAL   500   // Time between flash maintenance runs (e.g. entry log garbage collection) in ms
+#define MAINTENANCE_PRIORITY   osPriorityLow  // Maintenance thread only runs while UI and serial thread are idle
 
 enum WindowType {CreateLogin, Login, MainWindow, ResetConfirm, LogOff, SendEntry};
 
@@ -21,7 +23,7 @@ class BoardProgram
     ILI9341 displayDriver;
     HR2046 touchDriver;
     CryptoEngine* cryptoEngine;
-    EntryManager* entryManager;
+    static EntryManager* entryManager;
     KeylessCom* serialCommunication;
 
     static Window* templateWindow;
@@ -31,6 +33,8 @@ class BoardProgram
     static Mutex threadMutex;
     static uint16_t scrollIndex;
     static uint16_t currentEntry;
+    static uint8_t wipeProgress;
+    static uint32_t drawnCredentialVersion;  // Version of EntryManager::credentialInfo shown in credential list
 
     void updateEntryCount(uint16_t entryCount);
     uint8_t runFirstStartupRoutine(void);
@@ -41,12 +45,21 @@ class BoardProgram
       vector<CredentialEntry> credentialEntries;
 
       uint16_t posY = 50;
-      uint16_t entryEndIndex = (scrollIndex + 5) > EntryManager::credentialInfo.size() ? EntryManager::credentialInfo.size() : scrollIndex + 5;
+      Snapshot<vector<uint16_t>> credentialInfo = EntryManager::credentialInfo.read();
+      drawnCredentialVersion = credentialInfo.getVersion();
+      uint16_t entryEndIndex = (scrollIndex + 5) > credentialInfo->size() ? credentialInfo->size() : scrollIndex + 5;
 
       for(uint16_t i = scrollIndex; i < entryEndIndex; i++)
       {
+        // List only holds ids, titles of drawn entries are read from flash (entry removed since snapshot is skipped)
+        EntryView entry;
+        if(!entryManager->readEntry(credentialInfo->at(i), ENTRY_FIELD_TITLE, &entry))
+        {
+          continue;
+        }
+
         CredentialEntry tmp = CredentialEntry(displayDrv, Point(5, posY), BLACK, WHITE);
-        tmp.SetCredentialInfo(get<0>(EntryManager::credentialInfo.at(i)), get<1>(EntryManager::credentialInfo.at(i)));
+        tmp.SetCredentialInfo(entry.getId(), string(entry.getField(ENTRY_FIELD_TITLE), entry.getFieldLength(ENTRY_FIELD_TITLE)));
         tmp.SetWhenClicked(writeAsKeyboardButton_onClick);
         
         credentialEntries.push_back(tmp);
@@ -167,7 +180,7 @@ class BoardProgram
 
     static void scrollDownButton_onClick(GUIElement* sender)
     {
-      scrollIndex = scrollIndex > EntryManager::credentialInfo.size() - 5 ? 0 : scrollIndex + 5;
+      scrollIndex = scrollIndex > EntryManager::credentialInfo.read()->size() - 5 ? 0 : scrollIndex + 5;
       vector<CredentialEntry> entries = getEntriesToDraw(sender->displayDrv);
       
       templateWindow->uiEntries.clear();
@@ -199,6 +212,12 @@ class BoardProgram
 
     static void refreshButton_onClick(GUIElement* sender)
     {
+      // Nothing changed since list was drawn
+      if(scrollIndex == 0 && drawnCredentialVersion == EntryManager::credentialInfo.getVersion())
+      {
+        return;
+      }
+
       scrollIndex = 0;
       vector<CredentialEntry> entries = getEntriesToDraw(sender->displayDrv);
 
@@ -314,6 +333,16 @@ class BoardProgram
       sender->uiLabels.push_back(titleLabel);
       sender->uiLabels.push_back(barLabel);
 
+      // Old data of a reset device is still being erased in background
+      if(wipeProgress < 100)
+      {
+        char wipeText[10];
+        sprintf(wipeText, "WIPE %d%%", wipeProgress);
+
+        Label wipeLabel = Label(displayDrv, Point(138, 15), Point(50, 20), Point(1, 6), 1, BLACK, CYAN, wipeText);
+        sender->uiLabels.push_back(wipeLabel);
+      }
+
       Button resetButton = Button(displayDrv, Point(190, 10), Point(30, 30), Point(10, 8), 2, DARK_GRAY, WHITE, " ");
       resetButton.strText[0] = RESET_ICON;
       resetButton.SetWhenClicked(resetButton_onClick);
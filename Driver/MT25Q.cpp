@@ -2,13 +2,28 @@
 #include <chrono>
 #include <cstdint>
 
-uint8_t MT25Q::sectorBuffer[];
+uint8_t MT25Q::sectorBuffer[][MT25Q_SUBSECTOR_SIZE];
+uint8_t MT25Q::cacheData[][MT25Q_PAGE_SIZE];
 
 MT25Q::MT25Q(PinName mosi, PinName miso, PinName clk, PinName cs) : spi(mosi, miso, clk), chipSelect(cs)
 {
   spi.format(8);
   spi.frequency(40000000);
 
+  fill_n(bufferedSubsector, MT25Q_WRITE_BACK_SLOTS, MT25Q_NO_SUBSECTOR);
+  fill_n(dirtyPages, MT25Q_WRITE_BACK_SLOTS, 0);
+  nextEvictedSlot = 0;
+  skippedPageUpdates = 0;
+  programmedPageUpdates = 0;
+  erasedPageUpdates = 0;
+
+  fill_n(cachedPage, MT25Q_CACHE_PAGES, MT25Q_NO_PAGE);
+  fill_n(cacheLastUse, MT25Q_CACHE_PAGES, 0);
+  cacheClock = 0;
+  nextSequentialAddr = MT25Q_NO_PAGE;
+  cacheHits = 0;
+  cacheMisses = 0;
+
   // Code for further initizialation of device
 }
 
@@ -76,10 +91,160 @@ void MT25Q::sendReadCommand(uint64_t addr, uint8_t* buffer, size_t size)
 
 /*
   void readBytes(uint32_t, uint8_t*, size_t) reads bytes starting from given 4 byte address.
+  Buffered updates of the read subsectors are written first.
+
+  Pages are served from the RAM page cache if possible. A missed page is loaded as a whole, and a read which
+  continues the previous one also loads the next MT25Q_CACHE_READ_AHEAD pages. Programs and erases keep the
+  cache in sync, so cached pages always match flash.
 */
 void MT25Q::readBytes(uint32_t addr, uint8_t* buffer, size_t size)
 {
+  bufferMutex.lock();
+
+  flushOverlappingSlots(addr, size);
+
+  bool isSequential = addr == nextSequentialAddr;
+  bool isCacheable = size >= MT25Q_CACHE_MIN_READ;
+  bool hasMissed = false;
+  nextSequentialAddr = addr + size;
+
+  // Whole subsectors are read for updates and scans, caching them would only push out hot pages
+  if(size > MT25Q_CACHE_MAX_READ)
+  {
+    sendReadCommand(addr, buffer, size);
+    bufferMutex.unlock();
+    return;
+  }
+
+  while(size > 0)
+  {
+    size_t chunkSize = min<size_t>(size, MT25Q_PAGE_SIZE - (addr & 0xFF));
+    uint8_t entry = findCachedPage(addr & 0xFFFFFF00);
+
+    if(entry != MT25Q_CACHE_MISS)
+    {
+      cacheHits++;
+    }
+    else
+    {
+      cacheMisses++;
+      hasMissed = true;
+
+      if(!isCacheable)
+      {
+        sendReadCommand(addr, buffer, chunkSize);
+      }
+      else
+      {
+        entry = loadCachedPage(addr & 0xFFFFFF00);
+      }
+    }
+
+    if(entry != MT25Q_CACHE_MISS)
+    {
+      cacheLastUse[entry] = ++cacheClock;
+      copy_n(&cacheData[entry][addr & 0xFF], chunkSize, buffer);
+    }
+
+    addr += chunkSize;
+    buffer += chunkSize;
+    size -= chunkSize;
+  }
+
+  if(isSequential && isCacheable && hasMissed)
+  {
+    readAhead((addr + MT25Q_PAGE_SIZE - 1) & 0xFFFFFF00);
+  }
+
+  bufferMutex.unlock();
+}
+
+/*
+  void readBurst(uint32_t, uint8_t*, size_t) reads bytes with a single read command, bypassing the page cache.
+  Used by scans which read each page once, so they do not push hot pages out of the cache.
+*/
+void MT25Q::readBurst(uint32_t addr, uint8_t* buffer, size_t size)
+{
+  bufferMutex.lock();
+
+  flushOverlappingSlots(addr, size);
+  nextSequentialAddr = addr + size;
   sendReadCommand(addr, buffer, size);
+
+  bufferMutex.unlock();
+}
+
+/*
+  uint8_t findCachedPage(uint32_t) returns cache entry holding page at given address.
+
+  Returns MT25Q_CACHE_MISS if page is not cached.
+*/
+uint8_t MT25Q::findCachedPage(uint32_t pageAddr)
+{
+  for(uint8_t i = 0; i < MT25Q_CACHE_PAGES; i++)
+  {
+    if(cachedPage[i] == pageAddr)
+    {
+      return i;
+    }
+  }
+
+  return MT25Q_CACHE_MISS;
+}
+
+/*
+  uint8_t loadCachedPage(uint32_t) reads page at given address into an unused or the least recently used
+  cache entry and returns the entry.
+*/
+uint8_t MT25Q::loadCachedPage(uint32_t pageAddr)
+{
+  uint8_t entry = 0;
+
+  for(uint8_t i = 0; i < MT25Q_CACHE_PAGES && cachedPage[entry] != MT25Q_NO_PAGE; i++)
+  {
+    if(cachedPage[i] == MT25Q_NO_PAGE || cacheLastUse[i] < cacheLastUse[entry])
+    {
+      entry = i;
+    }
+  }
+
+  sendReadCommand(pageAddr, cacheData[entry], MT25Q_PAGE_SIZE);
+  cachedPage[entry] = pageAddr;
+  cacheLastUse[entry] = ++cacheClock;
+
+  return entry;
+}
+
+/*
+  void readAhead(uint32_t) loads up to MT25Q_CACHE_READ_AHEAD pages starting at given page address.
+  Stops at the first page which is already cached.
+*/
+void MT25Q::readAhead(uint32_t pageAddr)
+{
+  for(auto i = 0; i < MT25Q_CACHE_READ_AHEAD && pageAddr < MT25Q_MEMORY_SIZE; i++)
+  {
+    if(findCachedPage(pageAddr) != MT25Q_CACHE_MISS)
+    {
+      return;
+    }
+
+    loadCachedPage(pageAddr);
+    pageAddr += MT25Q_PAGE_SIZE;
+  }
+}
+
+/*
+  void invalidateCachedPages(uint32_t, uint32_t) drops cached pages in given address range.
+*/
+void MT25Q::invalidateCachedPages(uint32_t addr, uint32_t size)
+{
+  for(auto i = 0; i < MT25Q_CACHE_PAGES; i++)
+  {
+    if(cachedPage[i] != MT25Q_NO_PAGE && cachedPage[i] >= addr && cachedPage[i] - addr < size)
+    {
+      cachedPage[i] = MT25Q_NO_PAGE;
+    }
+  }
 }
 
 /*
@@ -92,7 +257,9 @@ void MT25Q::readBytes(uint32_t addr, uint8_t* buffer, size_t size)
 bool MT25Q::isAvailable(void)
 {
   uint8_t jedecInfo[3];
+  bufferMutex.lock();
   sendGeneralCommand(MT25Q_JEDEC_ID, NO_ADDRESS_COMMAND, NULL, 0, jedecInfo, 3);
+  bufferMutex.unlock();
 
   printf("%X %X %X\n", jedecInfo[0], jedecInfo[1], jedecInfo[2]);
 
@@ -113,6 +280,8 @@ bool MT25Q::isMemoryReady(void)
   uint8_t statusValues[2];
   int retries = 0;
 
+  bufferMutex.lock();
+
   do
   {
     ThisThread::sleep_for(chrono::milliseconds(1));
@@ -121,6 +290,8 @@ bool MT25Q::isMemoryReady(void)
 
   } while((statusValues[0] & WRITE_IN_PROGRESS) != 0 && retries < 1000);
 
+  bufferMutex.unlock();
+
   if((statusValues[0] & WRITE_IN_PROGRESS) != 0)
   {
     return false;
@@ -138,6 +309,16 @@ void MT25Q::sendProgramCommand(uint64_t addr, const uint8_t* data)
   sendGeneralCommand(MT25Q_WRITE_ENABLE, NO_ADDRESS_COMMAND, NULL, 0, NULL, 0);
   sendGeneralCommand(MT25Q_PROGRAM, addr, data, MT25Q_PAGE_SIZE, NULL, 0);
 
+  // Program only clears bits, cached copy stays valid the same way
+  uint8_t entry = findCachedPage(addr & 0xFFFFFF00);
+  if(entry != MT25Q_CACHE_MISS)
+  {
+    for(auto i = 0; i < MT25Q_PAGE_SIZE; i++)
+    {
+      cacheData[entry][i] &= data[i];
+    }
+  }
+
   // Wait until all write operations are finished
   isMemoryReady();
 }
@@ -148,7 +329,12 @@ void MT25Q::sendProgramCommand(uint64_t addr, const uint8_t* data)
 */
 void MT25Q::writeBytes(uint32_t addr, const uint8_t *data)
 {
+  bufferMutex.lock();
+
+  flushOverlappingSlots(addr, MT25Q_PAGE_SIZE);
   sendProgramCommand(addr, data);
+
+  bufferMutex.unlock();
 }
 
 /*
@@ -159,43 +345,240 @@ void MT25Q::sendEraseCommand(uint8_t eraseCmd, uint64_t addr)
   sendGeneralCommand(MT25Q_WRITE_ENABLE, NO_ADDRESS_COMMAND, NULL, 0, NULL, 0);
   sendGeneralCommand(eraseCmd, addr, NULL, 0, NULL, 0);
 
+  if(addr == NO_ADDRESS_COMMAND)
+  {
+    invalidateCachedPages(0, MT25Q_MEMORY_SIZE);
+  }
+  else
+  {
+    invalidateCachedPages(addr & 0xFFFFF000, MT25Q_SUBSECTOR_SIZE);
+  }
+
   // Wait until all write operations are finished
   isMemoryReady();
 }
 
 /*
   void eraseBytes(uint32_t) erases a whole Subsector (4KB) at a given address.
+  Buffered updates of this subsector are dropped.
 */
 void MT25Q::eraseBytes(uint32_t addr)
 {
+  bufferMutex.lock();
+
+  for(auto i = 0; i < MT25Q_WRITE_BACK_SLOTS; i++)
+  {
+    if(bufferedSubsector[i] == (addr & 0xFFFFF000))
+    {
+      bufferedSubsector[i] = MT25Q_NO_SUBSECTOR;
+      dirtyPages[i] = 0;
+    }
+  }
+
   sendEraseCommand(MT25Q_SUBSECTOR_ERASE, addr);
+
+  bufferMutex.unlock();
 }
 
 /*
-  void eraseChip(void) erases whole chip and waits until operation is done.
+  void eraseChip(void) erases whole chip and waits until operation is done. All buffered updates are dropped.
 */
 void MT25Q::eraseChip(void)
 {
+  bufferMutex.lock();
+
+  fill_n(bufferedSubsector, MT25Q_WRITE_BACK_SLOTS, MT25Q_NO_SUBSECTOR);
+  fill_n(dirtyPages, MT25Q_WRITE_BACK_SLOTS, 0);
+
   sendEraseCommand(MT25Q_BULK_ERASE, NO_ADDRESS_COMMAND);
+
+  bufferMutex.unlock();
+}
+
+/*
+  bool isProgrammable(const uint8_t*, const uint8_t*) returns true if current page content can be turned into
+  data by a page program only, i.e. no bit has to change from 0 to 1.
+*/
+bool MT25Q::isProgrammable(const uint8_t* current, const uint8_t* data)
+{
+  for(auto i = 0; i < MT25Q_PAGE_SIZE; i++)
+  {
+    if((data[i] & ~current[i]) != 0)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/*
+  void flushBufferSlot(uint8_t) writes buffered subsector back to flash and frees the buffer slot.
+  Updated pages are compared against flash: unchanged pages are skipped, pages only clearing bits are
+  programmed in place, and only if a bit has to be set the subsector is erased and re-written.
+*/
+void MT25Q::flushBufferSlot(uint8_t slot)
+{
+  if(bufferedSubsector[slot] == MT25Q_NO_SUBSECTOR)
+  {
+    return;
+  }
+
+  uint16_t changedPages = 0;
+  bool needsErase = false;
+
+  for(auto i = 0; i < MT25Q_SUBSECTOR_SIZE / MT25Q_PAGE_SIZE; i++)
+  {
+    if((dirtyPages[slot] & (1 << i)) == 0)
+    {
+      continue;
+    }
+
+    uint8_t flashPage[MT25Q_PAGE_SIZE];
+    uint8_t* page = &sectorBuffer[slot][i * MT25Q_PAGE_SIZE];
+    sendReadCommand(bufferedSubsector[slot] | (i << 8), flashPage, MT25Q_PAGE_SIZE);
+
+    if(equal(page, page + MT25Q_PAGE_SIZE, flashPage))
+    {
+      skippedPageUpdates++;
+      continue;
+    }
+
+    changedPages |= 1 << i;
+    needsErase |= !isProgrammable(flashPage, page);
+  }
+
+  if(needsErase)
+  {
+    sendEraseCommand(MT25Q_SUBSECTOR_ERASE, bufferedSubsector[slot]);
+  }
+
+  for(auto i = 0; i < MT25Q_SUBSECTOR_SIZE / MT25Q_PAGE_SIZE; i++)
+  {
+    uint8_t* page = &sectorBuffer[slot][i * MT25Q_PAGE_SIZE];
+
+    if(changedPages & (1 << i))
+    {
+      needsErase ? erasedPageUpdates++ : programmedPageUpdates++;
+    }
+    else if(!needsErase)
+    {
+      continue;
+    }
+
+    // Erased pages need no program
+    if(!all_of(page, page + MT25Q_PAGE_SIZE, [](uint8_t value) { return value == 0xFF; }))
+    {
+      sendProgramCommand(bufferedSubsector[slot] | (i << 8), page);
+    }
+  }
+
+  bufferedSubsector[slot] = MT25Q_NO_SUBSECTOR;
+  dirtyPages[slot] = 0;
+}
+
+/*
+  void flushOverlappingSlots(uint32_t, size_t) writes back buffered subsectors overlapping given address range.
+*/
+void MT25Q::flushOverlappingSlots(uint32_t addr, size_t size)
+{
+  for(auto i = 0; i < MT25Q_WRITE_BACK_SLOTS; i++)
+  {
+    if(bufferedSubsector[i] != MT25Q_NO_SUBSECTOR && bufferedSubsector[i] < addr + size &&
+      addr < bufferedSubsector[i] + MT25Q_SUBSECTOR_SIZE)
+    {
+      flushBufferSlot(i);
+    }
+  }
 }
 
 /*
   void updateBytes(uint32_t, const uint8_t*) updates page at given address.
   Because page must be erased before re-written and the min size to erase
   is a Subsector (4KB), rest of Subsector must be buffered and also re-written.
+
+  Updates are collected per subsector in RAM and written back once on commit(), when the buffer slot is needed
+  for another subsector or before the subsector is read or programmed. Callers must commit() to make updates
+  durable.
 */
 void MT25Q::updateBytes(uint32_t addr, const uint8_t* data)
 {
-  sendReadCommand(addr & 0xFFFFF000, sectorBuffer, MT25Q_SUBSECTOR_SIZE);
+  bufferMutex.lock();
 
-  uint16_t pageAddr = addr & 0xF00;
-  copy_n(data, MT25Q_PAGE_SIZE, &sectorBuffer[addr & 0xF00]);
+  uint32_t subsectorAddr = addr & 0xFFFFF000;
+  uint8_t slot = 0;
 
-  sendEraseCommand(MT25Q_SUBSECTOR_ERASE, addr & 0xFFFFF000);
+  while(slot < MT25Q_WRITE_BACK_SLOTS && bufferedSubsector[slot] != subsectorAddr)
+  {
+    slot++;
+  }
 
-  for(auto i = 0; i < MT25Q_SUBSECTOR_SIZE / MT25Q_PAGE_SIZE; i++)
+  if(slot == MT25Q_WRITE_BACK_SLOTS)
+  {
+    // Evict slots round robin
+    slot = nextEvictedSlot;
+    nextEvictedSlot = (nextEvictedSlot + 1) % MT25Q_WRITE_BACK_SLOTS;
+
+    flushBufferSlot(slot);
+    sendReadCommand(subsectorAddr, sectorBuffer[slot], MT25Q_SUBSECTOR_SIZE);
+    bufferedSubsector[slot] = subsectorAddr;
+  }
+
+  uint8_t* page = &sectorBuffer[slot][addr & 0xF00];
+
+  if(equal(data, data + MT25Q_PAGE_SIZE, page))
+  {
+    skippedPageUpdates++;
+  }
+  else
+  {
+    copy_n(data, MT25Q_PAGE_SIZE, page);
+    dirtyPages[slot] |= 1 << ((addr & 0xF00) >> 8);
+  }
+
+  bufferMutex.unlock();
+}
+
+/*
+  void commit(void) writes all buffered subsector updates to flash.
+*/
+void MT25Q::commit(void)
+{
+  bufferMutex.lock();
+
+  for(auto i = 0; i < MT25Q_WRITE_BACK_SLOTS; i++)
   {
-    uint32_t pageAddr = (addr & 0xFFFFF000) | (i << 8);
-    writeBytes(pageAddr, &sectorBuffer[i * MT25Q_PAGE_SIZE]);
+    flushBufferSlot(i);
   }
+
+  bufferMutex.unlock();
+}
+
+/*
+  void getUpdateStats(uint32_t*, uint32_t*, uint32_t*) returns how many page updates were skipped (unchanged),
+  programmed without erase, or written by erasing and re-writing their subsector.
+*/
+void MT25Q::getUpdateStats(uint32_t* skipped, uint32_t* programmed, uint32_t* erased)
+{
+  bufferMutex.lock();
+
+  *skipped = skippedPageUpdates;
+  *programmed = programmedPageUpdates;
+  *erased = erasedPageUpdates;
+
+  bufferMutex.unlock();
+}
+
+/*
+  void getCacheStats(uint32_t*, uint32_t*) returns how many pages read by readBytes() were found in the page
+  cache and how many had to be read from flash.
+*/
+void MT25Q::getCacheStats(uint32_t* hits, uint32_t* misses)
+{
+  bufferMutex.lock();
+
+  *hits = cacheHits;
+  *misses = cacheMisses;
+
+  bufferMutex.unlock();
 }
\ No newline at end of file
@@ -15,6 +15,20 @@
 // MT25Q Memory Constants (from datasheet of Micron MT25QL256ABA)
 #define MT25Q_PAGE_SIZE           256   // 256 Byte
 #define MT25Q_SUBSECTOR_SIZE      4096  // 4KB
+#define MT25Q_ERASE_ENDURANCE     100000  // Minimum erase cycles per subsector
+#define MT25Q_MEMORY_SIZE         0x2000000  // 32MB
+
+// Write-back buffer of updateBytes
+#define MT25Q_WRITE_BACK_SLOTS    2     // Subsectors buffered in RAM until commit
+#define MT25Q_NO_SUBSECTOR        0xFFFFFFFF
+
+// Page cache of readBytes
+#define MT25Q_CACHE_PAGES         64    // Pages kept in RAM (16KB), least recently used page is replaced
+#define MT25Q_CACHE_READ_AHEAD    4     // Pages loaded behind a read which continues the previous one
+#define MT25Q_CACHE_MIN_READ      16    // Smaller reads (e.g. record headers) do not load a whole page on a miss
+#define MT25Q_CACHE_MAX_READ      (MT25Q_CACHE_PAGES / 4 * MT25Q_PAGE_SIZE)  // Larger reads bypass the cache
+#define MT25Q_CACHE_MISS          0xFF
+#define MT25Q_NO_PAGE             0xFFFFFFFF
 
 // SPI Commands for MT25Q Nor Flash Chips
 #define MT25Q_ENABLE_4BYTE_ADDR 0xB7
@@ -36,15 +50,41 @@ class MT25Q
     bool isAvailable(void);
     bool isMemoryReady(void);
     void readBytes(uint32_t addr, uint8_t* buffer, size_t size);
+    void readBurst(uint32_t addr, uint8_t* buffer, size_t size);
     void writeBytes(uint32_t addr, const uint8_t* data);
     void eraseBytes(uint32_t addr);
     void eraseChip(void);
     void updateBytes(uint32_t addr, const uint8_t* data);
+    void commit(void);
+    void getUpdateStats(uint32_t* skipped, uint32_t* programmed, uint32_t* erased);
+    void getCacheStats(uint32_t* hits, uint32_t* misses);
+    static bool isProgrammable(const uint8_t* current, const uint8_t* data);
 
   private:
     SPI spi;
     DigitalOut chipSelect;
-    static uint8_t sectorBuffer[MT25Q_SUBSECTOR_SIZE];
+    Mutex bufferMutex;                          // Bus lock: SPI transfers, write-back buffer and page cache
+    static uint8_t sectorBuffer[MT25Q_WRITE_BACK_SLOTS][MT25Q_SUBSECTOR_SIZE];
+    uint32_t bufferedSubsector[MT25Q_WRITE_BACK_SLOTS];
+    uint16_t dirtyPages[MT25Q_WRITE_BACK_SLOTS];
+    uint8_t nextEvictedSlot;
+    uint32_t skippedPageUpdates;
+    uint32_t programmedPageUpdates;
+    uint32_t erasedPageUpdates;
+    static uint8_t cacheData[MT25Q_CACHE_PAGES][MT25Q_PAGE_SIZE];
+    uint32_t cachedPage[MT25Q_CACHE_PAGES];     // Address of cached page, MT25Q_NO_PAGE if unused
+    uint32_t cacheLastUse[MT25Q_CACHE_PAGES];
+    uint32_t cacheClock;
+    uint32_t nextSequentialAddr;                // First address behind previous read
+    uint32_t cacheHits;
+    uint32_t cacheMisses;
+
+    void flushBufferSlot(uint8_t slot);
+    void flushOverlappingSlots(uint32_t addr, size_t size);
+    uint8_t findCachedPage(uint32_t pageAddr);
+    uint8_t loadCachedPage(uint32_t pageAddr);
+    void readAhead(uint32_t pageAddr);
+    void invalidateCachedPages(uint32_t addr, uint32_t size);
 
     void sendGeneralCommand(uint8_t cmd, uint64_t addr, const uint8_t* txBuffer, size_t txSize, uint8_t* rxBuffer, size_t rxSize);
     void sendReadCommand(uint64_t addr, uint8_t* buffer, size_t size);
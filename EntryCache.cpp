@@ -0,0 +1,225 @@
+#include "EntryCache.h"
+#include <algorithm>
+
+uint8_t EntryCache::cachedPages[][MT25Q_PAGE_SIZE];
+
+/*
+  EntryCache(CryptoEngine*) initializes an empty cache. Session key is taken on first insert.
+*/
+EntryCache::EntryCache(CryptoEngine* cryptoEngine)
+{
+  this->cryptoEngine = cryptoEngine;
+  mbedtls_aes_init(&sessionContext);
+  hasSessionKey = false;
+  nextNonce = 0;
+  cacheClock = 0;
+  cacheHits = 0;
+  cacheMisses = 0;
+
+  for(uint8_t slot = 0; slot < ENTRY_CACHE_SLOTS; slot++)
+  {
+    cachedIds[slot] = ENTRY_CACHE_NO_ID;
+    cacheLastUse[slot] = 0;
+  }
+}
+
+/*
+  bool read(uint16_t, bool, uint8_t*) copies cached page of entry to page buffer. Secret half is only
+  decrypted if needed, otherwise only the plaintext half is written.
+
+  Returns false if entry is not cached.
+*/
+bool EntryCache::read(uint16_t id, bool needsSecret, uint8_t* page)
+{
+  ScopedLock<Mutex> lock(cacheMutex);
+
+  uint8_t slot = findSlot(id);
+
+  if(slot == ENTRY_CACHE_SLOTS)
+  {
+    cacheMisses++;
+    return false;
+  }
+
+  cacheHits++;
+  cacheLastUse[slot] = ++cacheClock;
+  copy_n(cachedPages[slot], ENTRY_CACHE_PLAIN_SIZE, page);
+
+  if(needsSecret)
+  {
+    cryptSecret(cachedNonces[slot], &cachedPages[slot][ENTRY_CACHE_PLAIN_SIZE], &page[ENTRY_CACHE_PLAIN_SIZE]);
+  }
+
+  return true;
+}
+
+/*
+  void insert(uint16_t, const uint8_t*) caches decrypted page of entry, replacing the least recently used one.
+  Secret half gets encrypted under the session key with a fresh nonce.
+*/
+void EntryCache::insert(uint16_t id, const uint8_t* page)
+{
+  ScopedLock<Mutex> lock(cacheMutex);
+
+  // Nonces must not repeat under one key, a new session key starts them over
+  if((!hasSessionKey || nextNonce == UINT32_MAX) && !createSessionKey())
+  {
+    return;
+  }
+
+  uint8_t slot = findSlot(id);
+
+  if(slot == ENTRY_CACHE_SLOTS)
+  {
+    slot = 0;
+
+    for(uint8_t i = 1; i < ENTRY_CACHE_SLOTS; i++)
+    {
+      if(cacheLastUse[i] < cacheLastUse[slot])
+      {
+        slot = i;
+      }
+    }
+  }
+
+  cachedIds[slot] = id;
+  cachedNonces[slot] = nextNonce++;
+  cacheLastUse[slot] = ++cacheClock;
+  copy_n(page, ENTRY_CACHE_PLAIN_SIZE, cachedPages[slot]);
+  cryptSecret(cachedNonces[slot], &page[ENTRY_CACHE_PLAIN_SIZE], &cachedPages[slot][ENTRY_CACHE_PLAIN_SIZE]);
+}
+
+/*
+  void remove(uint16_t) drops cached page of entry, e.g. after it was edited or removed.
+*/
+void EntryCache::remove(uint16_t id)
+{
+  ScopedLock<Mutex> lock(cacheMutex);
+
+  uint8_t slot = findSlot(id);
+
+  if(slot != ENTRY_CACHE_SLOTS)
+  {
+    wipeSlot(slot);
+  }
+}
+
+/*
+  void clear(void) wipes all cached pages and the session key, e.g. on logoff and reset.
+*/
+void EntryCache::clear(void)
+{
+  ScopedLock<Mutex> lock(cacheMutex);
+
+  for(uint8_t slot = 0; slot < ENTRY_CACHE_SLOTS; slot++)
+  {
+    wipeSlot(slot);
+  }
+
+  // Frees nothing but overwrites the key schedule
+  mbedtls_aes_free(&sessionContext);
+  mbedtls_aes_init(&sessionContext);
+  hasSessionKey = false;
+  nextNonce = 0;
+}
+
+/*
+  void getStats(uint32_t*, uint32_t*) returns count of reads served from cache and count of reads missing it.
+*/
+void EntryCache::getStats(uint32_t* hits, uint32_t* misses)
+{
+  *hits = cacheHits;
+  *misses = cacheMisses;
+}
+
+/*
+  uint8_t findSlot(uint16_t) returns slot holding given entry, ENTRY_CACHE_SLOTS if it is not cached.
+*/
+uint8_t EntryCache::findSlot(uint16_t id)
+{
+  for(uint8_t slot = 0; slot < ENTRY_CACHE_SLOTS; slot++)
+  {
+    if(cachedIds[slot] == id)
+    {
+      return slot;
+    }
+  }
+
+  return ENTRY_CACHE_SLOTS;
+}
+
+/*
+  bool createSessionKey(void) sets up a new AES-128 session key from the TRNG. Cached pages encrypted under the
+  previous key are dropped.
+
+  Returns false if TRNG failed, nothing gets cached then.
+*/
+bool EntryCache::createSessionKey(void)
+{
+  for(uint8_t slot = 0; slot < ENTRY_CACHE_SLOTS; slot++)
+  {
+    wipeSlot(slot);
+  }
+
+  // TRNG output of salt size is exactly one AES-128 key
+  uint8_t key[MAX_SALT_LENGTH];
+
+  hasSessionKey = cryptoEngine->generateRandomSalt(key) == 0;
+
+  if(hasSessionKey)
+  {
+    mbedtls_aes_setkey_enc(&sessionContext, key, 128);
+    nextNonce = 0;
+  }
+  else
+  {
+    printf("[Error] Could not create session key of entry cache!\n");
+  }
+
+  volatile uint8_t* keyData = key;
+  for(auto i = 0; i < MAX_SALT_LENGTH; i++)
+  {
+    keyData[i] = 0x00;
+  }
+
+  return hasSessionKey;
+}
+
+/*
+  void cryptSecret(uint32_t, const uint8_t*, uint8_t*) en- or decrypts a secret half with AES-CTR under the
+  session key. Nonce fills the upper bytes of the counter block, the lower bytes count the blocks of the half.
+*/
+void EntryCache::cryptSecret(uint32_t nonce, const uint8_t* input, uint8_t* output)
+{
+  uint8_t counter[16] = {0};
+  uint8_t streamBlock[16];
+  size_t streamOffset = 0;
+
+  counter[0] = (nonce >> 24) & 0xFF;
+  counter[1] = (nonce >> 16) & 0xFF;
+  counter[2] = (nonce >> 8) & 0xFF;
+  counter[3] = nonce & 0xFF;
+
+  mbedtls_aes_crypt_ctr(&sessionContext, ENTRY_CACHE_SECRET_SIZE, &streamOffset, counter, streamBlock, input, output);
+
+  volatile uint8_t* streamData = streamBlock;
+  for(auto i = 0; i < 16; i++)
+  {
+    streamData[i] = 0x00;
+  }
+}
+
+/*
+  void wipeSlot(uint8_t) overwrites cached page of slot and marks slot as unused.
+*/
+void EntryCache::wipeSlot(uint8_t slot)
+{
+  volatile uint8_t* pageData = cachedPages[slot];
+  for(auto i = 0; i < MT25Q_PAGE_SIZE; i++)
+  {
+    pageData[i] = 0x00;
+  }
+
+  cachedIds[slot] = ENTRY_CACHE_NO_ID;
+  cacheLastUse[slot] = 0;
+}
@@ -0,0 +1,53 @@
+#include "mbed.h"
+#include "MT25Q.h"
+#include "CryptoEngine.h"
+#include "aes.h"
+#include <cstdint>
+
+#ifndef ENTRY_CACHE_H
+#define ENTRY_CACHE_H
+
+#define ENTRY_CACHE_SLOTS             8       // Recently read entry pages kept in RAM (2KB), least recently used is replaced
+#define ENTRY_CACHE_NO_ID             0xFFFF  // Marks an unused cache slot
+#define ENTRY_CACHE_PLAIN_SIZE        128     // Unencrypted first half of entry page, kept as it is
+#define ENTRY_CACHE_SECRET_SIZE       128     // Secret half of entry page, kept encrypted under session key
+
+/*
+  EntryCache keeps the pages of recently read entries in RAM, so sending the same entry again neither reads
+  flash nor runs the AES-CBC decrypt with its key setup.
+
+  Secret halves are never kept in plaintext: they are encrypted with AES-CTR under a session key taken from the
+  TRNG, whose key schedule is set up once. A hit costs one CTR pass over 128 bytes. clear() wipes pages and
+  session key, a new key is taken on the next insert.
+*/
+class EntryCache
+{
+  public:
+    EntryCache(CryptoEngine* cryptoEngine);
+    bool read(uint16_t id, bool needsSecret, uint8_t* page);
+    void insert(uint16_t id, const uint8_t* page);
+    void remove(uint16_t id);
+    void clear(void);
+    void getStats(uint32_t* hits, uint32_t* misses);
+
+  private:
+    CryptoEngine* cryptoEngine;
+    Mutex cacheMutex;                           // Readers of EntryManager share the cache
+    mbedtls_aes_context sessionContext;
+    bool hasSessionKey;
+    uint32_t nextNonce;                         // Nonce of next inserted page, unique per session key
+    uint16_t cachedIds[ENTRY_CACHE_SLOTS];
+    uint32_t cachedNonces[ENTRY_CACHE_SLOTS];
+    uint32_t cacheLastUse[ENTRY_CACHE_SLOTS];
+    uint32_t cacheClock;
+    uint32_t cacheHits;
+    uint32_t cacheMisses;
+    static uint8_t cachedPages[ENTRY_CACHE_SLOTS][MT25Q_PAGE_SIZE];
+
+    uint8_t findSlot(uint16_t id);
+    bool createSessionKey(void);
+    void cryptSecret(uint32_t nonce, const uint8_t* input, uint8_t* output);
+    void wipeSlot(uint8_t slot);
+};
+
+#endif
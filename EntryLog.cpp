@@ -0,0 +1,1063 @@
+#include "EntryLog.h"
+
+#define LOG_PAGES_PER_SUBSECTOR (MT25Q_SUBSECTOR_SIZE / MT25Q_PAGE_SIZE)
+#define LOG_PAGE_ADDRESS(page)  (ENTRY_LOG_START_ADDRESS + ((uint32_t)(page) << 8))
+
+// Commit record: [COMMIT ID 2 bytes] [BATCH SEQUENCE 4 bytes] [COUNT 1 byte] [OPERATIONS 116 bytes] [FLAGS] [SEQUENCE]
+#define COMMIT_BATCH_OFFSET       2
+#define COMMIT_COUNT_OFFSET       6
+#define COMMIT_OPERATIONS_OFFSET  7
+
+// Packed record: [PACKED ID 2 bytes] [ENTRIES 121 bytes] [FLAGS] [SEQUENCE] [ENTRIES 128 bytes]
+#define PACKED_PAGE_OFFSET(offset) ((offset) < ENTRY_LOG_FLAGS_OFFSET - 2 ? (offset) + 2 : (offset) + (MT25Q_PAGE_SIZE - ENTRY_LOG_PACKED_AREA_SIZE))
+
+/*
+  EntryLog(MT25Q*, IntegrityIndex*) initializes class. Log must be mounted before use. Pages are programmed and
+  erased through IntegrityIndex, which keeps their digests.
+*/
+EntryLog::EntryLog(MT25Q* flashMemory, IntegrityIndex* integrityIndex)
+{
+  this->flashMemory = flashMemory;
+  this->integrityIndex = integrityIndex;
+
+  fill_n(idPage, MAX_ENTRY_COUNT, ENTRY_LOG_NO_PAGE);
+  fill_n(idOffset, MAX_ENTRY_COUNT, ENTRY_LOG_NO_OFFSET);
+  fill_n(idSize, MAX_ENTRY_COUNT, 0);
+  fill_n(liveCount, ENTRY_LOG_SUBSECTOR_COUNT, 0);
+  erasedSubsectors.markAllUsed();
+  headPage = ENTRY_LOG_NO_PAGE;
+  lastHeadSubsector = 0;
+  packUsed = 0;
+  nextSequence = 0;
+  lastCommitPage = ENTRY_LOG_NO_PAGE;
+  lastCommitSequence = 0;
+  appliedSequence = ENTRY_LOG_NOTHING_APPLIED;
+}
+
+/*
+  void readRecordHeader(uint16_t, uint16_t*, uint8_t*, uint32_t*) reads id, flags and sequence number of record
+  at given log page.
+*/
+void EntryLog::readRecordHeader(uint16_t page, uint16_t* id, uint8_t* flags, uint32_t* seq)
+{
+  uint8_t idBytes[2];
+  flashMemory->readBytes(LOG_PAGE_ADDRESS(page), idBytes, 2);
+  *id = (idBytes[0] << 8) | idBytes[1];
+
+  uint8_t tail[5];
+  flashMemory->readBytes(LOG_PAGE_ADDRESS(page) + ENTRY_LOG_FLAGS_OFFSET, tail, 5);
+  *flags = tail[0];
+  *seq = (tail[1] << 24) | (tail[2] << 16) | (tail[3] << 8) | tail[4];
+}
+
+/*
+  uint32_t readBatchSequence(uint16_t) reads batch sequence number of commit record at given log page.
+*/
+uint32_t EntryLog::readBatchSequence(uint16_t page)
+{
+  uint8_t seq[4];
+  flashMemory->readBytes(LOG_PAGE_ADDRESS(page) + COMMIT_BATCH_OFFSET, seq, 4);
+
+  return (seq[0] << 24) | (seq[1] << 16) | (seq[2] << 8) | seq[3];
+}
+
+/*
+  bool isPending(uint32_t) returns true if commit record of given batch is not applied to address table yet.
+*/
+bool EntryLog::isPending(uint32_t batchSequence)
+{
+  return appliedSequence == ENTRY_LOG_NOTHING_APPLIED || batchSequence > appliedSequence;
+}
+
+/*
+  bool isPendingPage(uint16_t) returns true if given page holds a commit record which is not applied yet.
+*/
+bool EntryLog::isPendingPage(uint16_t page)
+{
+  for(auto& commit : pendingCommits)
+  {
+    if(get<1>(commit) == page)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*
+  void mount(uint32_t) scans record headers of the whole log and rebuilds id map, live record counts, unapplied
+  commit records and log head. Pages of a subsector are always programmed in order, so scanning a subsector
+  stops at its first erased page.
+
+  appliedSequence is the batch sequence of the newest commit record already applied to the address table.
+*/
+void EntryLog::mount(uint32_t appliedSequence)
+{
+  fill_n(idPage, MAX_ENTRY_COUNT, ENTRY_LOG_NO_PAGE);
+  fill_n(idOffset, MAX_ENTRY_COUNT, ENTRY_LOG_NO_OFFSET);
+  fill_n(idSize, MAX_ENTRY_COUNT, 0);
+  fill_n(liveCount, ENTRY_LOG_SUBSECTOR_COUNT, 0);
+  erasedSubsectors.markAllUsed();
+  headPage = ENTRY_LOG_NO_PAGE;
+  lastCommitPage = ENTRY_LOG_NO_PAGE;
+  lastCommitSequence = 0;
+  this->appliedSequence = appliedSequence;
+  pendingCommits.clear();
+  batchRecords.clear();
+  packEntries.clear();
+  packUsed = 0;
+
+  // First pass finds newest commit record, everything written after it belongs to an unfinished batch
+  bool commitFound = false;
+  uint32_t commitSequence = 0;
+
+  for(uint16_t subsector = 0; subsector < ENTRY_LOG_SUBSECTOR_COUNT; subsector++)
+  {
+    for(uint16_t i = 0; i < LOG_PAGES_PER_SUBSECTOR; i++)
+    {
+      uint16_t id;
+      uint8_t flags;
+      uint32_t seq;
+      readRecordHeader(subsector * LOG_PAGES_PER_SUBSECTOR + i, &id, &flags, &seq);
+
+      if(id == 0xFFFF && seq == 0xFFFFFFFF)
+      {
+        break;
+      }
+
+      if(id == ENTRY_LOG_COMMIT_ID && seq != 0xFFFFFFFF && flags != ENTRY_LOG_RECORD_VOID &&
+        (!commitFound || seq > commitSequence))
+      {
+        commitFound = true;
+        commitSequence = seq;
+      }
+    }
+  }
+
+  bool recordFound = false;
+  uint32_t maxSequence = 0;
+  uint16_t maxSequencePage = 0;
+
+  for(uint16_t subsector = 0; subsector < ENTRY_LOG_SUBSECTOR_COUNT; subsector++)
+  {
+    for(uint16_t i = 0; i < LOG_PAGES_PER_SUBSECTOR; i++)
+    {
+      uint16_t page = subsector * LOG_PAGES_PER_SUBSECTOR + i;
+
+      uint16_t id;
+      uint8_t flags;
+      uint32_t seq;
+      readRecordHeader(page, &id, &flags, &seq);
+
+      if(id == 0xFFFF && seq == 0xFFFFFFFF)
+      {
+        if(i == 0)
+        {
+          erasedSubsectors.markFree(subsector);
+        }
+        break;
+      }
+
+      // Skip torn records (sequence number never programmed)
+      if(seq == 0xFFFFFFFF)
+      {
+        continue;
+      }
+
+      if(!recordFound || seq > maxSequence)
+      {
+        recordFound = true;
+        maxSequence = seq;
+        maxSequencePage = page;
+      }
+
+      if(flags == ENTRY_LOG_RECORD_VOID)
+      {
+        continue;
+      }
+
+      // Void records of unfinished batch, a later commit record must not make them valid
+      if(commitFound && seq > commitSequence)
+      {
+        voidRecord(page);
+        continue;
+      }
+
+      if(id == ENTRY_LOG_COMMIT_ID)
+      {
+        uint32_t batchSequence = readBatchSequence(page);
+        bool isLast = seq == commitSequence;
+
+        if(isLast)
+        {
+          lastCommitPage = page;
+          lastCommitSequence = batchSequence;
+        }
+
+        // Garbage collection may have left a copy of a commit record behind
+        bool isDuplicate = false;
+        for(auto& commit : pendingCommits)
+        {
+          isDuplicate |= get<0>(commit) == batchSequence;
+        }
+
+        if(isPending(batchSequence) && !isDuplicate)
+        {
+          pendingCommits.push_back(tuple<uint32_t, uint16_t>(batchSequence, page));
+          liveCount[subsector]++;
+        }
+        else if(isLast)
+        {
+          liveCount[subsector]++;
+        }
+
+        continue;
+      }
+
+      if(id == ENTRY_LOG_PACKED_ID)
+      {
+        forEachPackedEntry(page, [&](uint16_t entryId, uint8_t offset, uint8_t size)
+        {
+          mountRecord(entryId, page, offset, size, seq);
+        });
+        continue;
+      }
+
+      // Skip foreign data
+      if(id >= MAX_ENTRY_COUNT)
+      {
+        continue;
+      }
+
+      mountRecord(id, page, ENTRY_LOG_NO_OFFSET, 0, seq);
+    }
+  }
+
+  sort(pendingCommits.begin(), pendingCommits.end());
+
+  nextSequence = recordFound ? maxSequence + 1 : 0;
+  lastHeadSubsector = maxSequencePage / LOG_PAGES_PER_SUBSECTOR;
+
+  // Continue appending behind newest record if its subsector still has room
+  uint16_t nextPage = maxSequencePage + 1;
+  if(recordFound && (nextPage % LOG_PAGES_PER_SUBSECTOR) != 0)
+  {
+    uint16_t id;
+    uint8_t flags;
+    uint32_t seq;
+    readRecordHeader(nextPage, &id, &flags, &seq);
+
+    if(id == 0xFFFF && flags == 0xFF && seq == 0xFFFFFFFF)
+    {
+      headPage = nextPage;
+    }
+  }
+
+  // Logs written before commit records existed are valid as they are, commit them once
+  if(!commitFound)
+  {
+    commitBatch(NULL, NULL, 0);
+  }
+}
+
+/*
+  void mountRecord(uint16_t, uint16_t, uint8_t, uint8_t, uint32_t) maps id to record found while mounting,
+  unless id already has a newer one.
+*/
+void EntryLog::mountRecord(uint16_t id, uint16_t page, uint8_t offset, uint8_t size, uint32_t seq)
+{
+  if(idPage[id] != ENTRY_LOG_NO_PAGE)
+  {
+    uint16_t oldId;
+    uint8_t oldFlags;
+    uint32_t oldSeq;
+    readRecordHeader(idPage[id], &oldId, &oldFlags, &oldSeq);
+
+    if(oldSeq > seq)
+    {
+      return;
+    }
+  }
+
+  mapRecord(id, page, offset, size);
+}
+
+/*
+  void forEachPackedEntry(uint16_t, function<void(uint16_t, uint8_t, uint8_t)>) calls visit with id, offset and size
+  of every entry in packed record at given log page. Only entry headers are read.
+*/
+void EntryLog::forEachPackedEntry(uint16_t page, function<void(uint16_t, uint8_t, uint8_t)> visit)
+{
+  uint16_t offset = 0;
+  while(offset + ENTRY_LOG_PACKED_HEADER_SIZE <= ENTRY_LOG_PACKED_AREA_SIZE)
+  {
+    uint8_t header[ENTRY_LOG_PACKED_HEADER_SIZE];
+    readPackedArea(page, offset, header, ENTRY_LOG_PACKED_HEADER_SIZE);
+
+    uint16_t id = (header[0] << 8) | header[1];
+    uint8_t size = header[2];
+
+    // Rest of packed area is erased
+    if(id == 0xFFFF || offset + ENTRY_LOG_PACKED_HEADER_SIZE + size > ENTRY_LOG_PACKED_AREA_SIZE)
+    {
+      break;
+    }
+
+    if(id < MAX_ENTRY_COUNT)
+    {
+      visit(id, offset, size);
+    }
+
+    offset += ENTRY_LOG_PACKED_HEADER_SIZE + size;
+  }
+}
+
+/*
+  void readPackedArea(uint16_t, uint8_t, uint8_t*, uint16_t) reads bytes of packed area of given log page with one
+  burst, skipping flags and sequence number.
+*/
+void EntryLog::readPackedArea(uint16_t page, uint8_t offset, uint8_t* buffer, uint16_t size)
+{
+  uint8_t record[MT25Q_PAGE_SIZE];
+  uint16_t start = PACKED_PAGE_OFFSET(offset);
+  uint16_t end = PACKED_PAGE_OFFSET(offset + size - 1) + 1;
+  flashMemory->readBytes(LOG_PAGE_ADDRESS(page) + start, record, end - start);
+
+  for(uint16_t i = 0; i < size; i++)
+  {
+    buffer[i] = record[PACKED_PAGE_OFFSET(offset + i) - start];
+  }
+}
+
+/*
+  void mapRecord(uint16_t, uint16_t, uint8_t, uint8_t) points id to new record, its previous record becomes stale.
+*/
+void EntryLog::mapRecord(uint16_t id, uint16_t page, uint8_t offset, uint8_t size)
+{
+  release(id);
+  idPage[id] = page;
+  idOffset[id] = offset;
+  idSize[id] = size;
+  liveCount[page / LOG_PAGES_PER_SUBSECTOR]++;
+}
+
+/*
+  bool contains(uint16_t) returns true if log holds a record for given id.
+*/
+bool EntryLog::contains(uint16_t id)
+{
+  return id < MAX_ENTRY_COUNT && idPage[id] != ENTRY_LOG_NO_PAGE;
+}
+
+/*
+  bool isPacked(uint16_t) returns true if newest record of given id is an entry inside a packed record.
+*/
+bool EntryLog::isPacked(uint16_t id)
+{
+  return contains(id) && idOffset[id] != ENTRY_LOG_NO_OFFSET;
+}
+
+/*
+  uint8_t readPacked(uint16_t, uint8_t*, uint8_t) reads up to maxSize bytes of packed entry of given id.
+
+  Returns number of bytes read, 0 if id has no packed entry.
+*/
+uint8_t EntryLog::readPacked(uint16_t id, uint8_t* buffer, uint8_t maxSize)
+{
+  if(!isPacked(id))
+  {
+    return 0;
+  }
+
+  uint8_t size = min(idSize[id], maxSize);
+  uint8_t area[ENTRY_LOG_PACKED_AREA_SIZE];
+  readPackedArea(idPage[id], idOffset[id], area, ENTRY_LOG_PACKED_HEADER_SIZE + size);
+
+  if(((area[0] << 8) | area[1]) != id)
+  {
+    return 0;
+  }
+
+  copy_n(&area[ENTRY_LOG_PACKED_HEADER_SIZE], size, buffer);
+
+  return size;
+}
+
+/*
+  uint8_t copyPacked(uint16_t, const uint8_t*, uint8_t*, uint8_t) copies up to maxSize bytes of packed entry of given
+  id out of its record page, which was already read into RAM (e.g. by a scan).
+
+  Returns number of bytes copied, 0 if id has no packed entry.
+*/
+uint8_t EntryLog::copyPacked(uint16_t id, const uint8_t* record, uint8_t* buffer, uint8_t maxSize)
+{
+  if(!isPacked(id) || ((record[PACKED_PAGE_OFFSET(idOffset[id])] << 8) | record[PACKED_PAGE_OFFSET(idOffset[id] + 1)]) != id)
+  {
+    return 0;
+  }
+
+  uint8_t size = min(idSize[id], maxSize);
+
+  for(uint8_t i = 0; i < size; i++)
+  {
+    buffer[i] = record[PACKED_PAGE_OFFSET(idOffset[id] + ENTRY_LOG_PACKED_HEADER_SIZE + i)];
+  }
+
+  return size;
+}
+
+/*
+  uint32_t getPageAddress(uint16_t) returns flash address of newest record of given id.
+
+  Returns ENTRY_NO_ADDRESS if log holds no record for id.
+*/
+uint32_t EntryLog::getPageAddress(uint16_t id)
+{
+  if(!contains(id))
+  {
+    return ENTRY_NO_ADDRESS;
+  }
+
+  return LOG_PAGE_ADDRESS(idPage[id]);
+}
+
+/*
+  uint16_t getErasedSubsectorCount(void) returns number of erased subsectors ready to be used as log head.
+*/
+uint16_t EntryLog::getErasedSubsectorCount(void)
+{
+  return erasedSubsectors.countFree();
+}
+
+/*
+  uint16_t getFreePageCount(void) returns number of pages which can be appended without garbage collection.
+*/
+uint16_t EntryLog::getFreePageCount(void)
+{
+  uint16_t headPages = headPage != ENTRY_LOG_NO_PAGE ? LOG_PAGES_PER_SUBSECTOR - (headPage % LOG_PAGES_PER_SUBSECTOR) : 0;
+
+  return getErasedSubsectorCount() * LOG_PAGES_PER_SUBSECTOR + headPages;
+}
+
+/*
+  uint16_t getPendingCommitCount(void) returns number of commit records not applied to address table yet.
+*/
+uint16_t EntryLog::getPendingCommitCount(void)
+{
+  return pendingCommits.size();
+}
+
+/*
+  uint32_t getLastCommitSequence(void) returns batch sequence of newest commit record. Passing it to
+  setAppliedSequence() marks all commit records as applied.
+*/
+uint32_t EntryLog::getLastCommitSequence(void)
+{
+  return lastCommitSequence;
+}
+
+/*
+  void setAppliedSequence(uint32_t) marks commit records up to given batch sequence as applied to address
+  table in flash, so they can be reclaimed.
+*/
+void EntryLog::setAppliedSequence(uint32_t sequence)
+{
+  appliedSequence = sequence;
+
+  while(!pendingCommits.empty() && !isPending(get<0>(pendingCommits.front())))
+  {
+    uint16_t page = get<1>(pendingCommits.front());
+    pendingCommits.erase(pendingCommits.begin());
+
+    // Newest commit record stays live, it marks end of valid log
+    if(page != lastCommitPage)
+    {
+      liveCount[page / LOG_PAGES_PER_SUBSECTOR]--;
+    }
+  }
+}
+
+/*
+  void forEachPendingOperation(function<void(uint16_t, uint16_t)>) calls apply with slot and id of every
+  address table change in unapplied commit records, oldest first.
+*/
+void EntryLog::forEachPendingOperation(function<void(uint16_t, uint16_t)> apply)
+{
+  uint8_t record[ENTRY_LOG_FLAGS_OFFSET];
+
+  for(auto& commit : pendingCommits)
+  {
+    flashMemory->readBytes(LOG_PAGE_ADDRESS(get<1>(commit)), record, ENTRY_LOG_FLAGS_OFFSET);
+
+    for(uint8_t i = 0; i < record[COMMIT_COUNT_OFFSET] && i < ENTRY_LOG_COMMIT_MAX_OPERATIONS; i++)
+    {
+      uint8_t* operation = &record[COMMIT_OPERATIONS_OFFSET + i * 4];
+      apply((operation[0] << 8) | operation[1], (operation[2] << 8) | operation[3]);
+    }
+  }
+}
+
+/*
+  bool openHeadSubsector(void) moves log head to next erased subsector, continuing after the last head so
+  erases are spread over the whole log region.
+*/
+bool EntryLog::openHeadSubsector(void)
+{
+  uint16_t subsector = erasedSubsectors.findNextFree(lastHeadSubsector + 1);
+
+  if(subsector == FREE_BITMAP_NONE)
+  {
+    return false;
+  }
+
+  erasedSubsectors.markUsed(subsector);
+  lastHeadSubsector = subsector;
+  headPage = subsector * LOG_PAGES_PER_SUBSECTOR;
+
+  return true;
+}
+
+/*
+  uint16_t programRecord(const uint8_t*) programs page (id already set) as newest record at log head.
+  Page is programmed first and committed afterwards by programming its sequence number.
+
+  Returns log page of the record, ENTRY_LOG_NO_PAGE if log has no erased page left.
+*/
+uint16_t EntryLog::programRecord(const uint8_t* page)
+{
+  uint8_t record[MT25Q_PAGE_SIZE];
+
+  while(true)
+  {
+    if(headPage == ENTRY_LOG_NO_PAGE && !openHeadSubsector())
+    {
+      printf("[Error] Entry log has no erased subsector left!\n");
+      return ENTRY_LOG_NO_PAGE;
+    }
+
+    // Skip pages left dirty by an interrupted program or erase
+    flashMemory->readBytes(LOG_PAGE_ADDRESS(headPage), record, MT25Q_PAGE_SIZE);
+    if(all_of(record, record + MT25Q_PAGE_SIZE, [](uint8_t value) { return value == 0xFF; }))
+    {
+      break;
+    }
+
+    headPage++;
+    if(headPage % LOG_PAGES_PER_SUBSECTOR == 0)
+    {
+      headPage = ENTRY_LOG_NO_PAGE;
+    }
+  }
+
+  copy_n(page, MT25Q_PAGE_SIZE, record);
+  fill_n(&record[ENTRY_LOG_FLAGS_OFFSET], 5, 0xFF);
+  integrityIndex->programPage(headPage, record);
+
+  // Commit record, bits already programmed stay untouched by 0xFF bytes
+  fill_n(record, MT25Q_PAGE_SIZE, 0xFF);
+  record[ENTRY_LOG_SEQUENCE_OFFSET] = (nextSequence >> 24) & 0xFF;
+  record[ENTRY_LOG_SEQUENCE_OFFSET + 1] = (nextSequence >> 16) & 0xFF;
+  record[ENTRY_LOG_SEQUENCE_OFFSET + 2] = (nextSequence >> 8) & 0xFF;
+  record[ENTRY_LOG_SEQUENCE_OFFSET + 3] = nextSequence & 0xFF;
+  integrityIndex->programPage(headPage, record);
+  nextSequence++;
+
+  uint16_t programmedPage = headPage;
+
+  headPage++;
+  if(headPage % LOG_PAGES_PER_SUBSECTOR == 0)
+  {
+    headPage = ENTRY_LOG_NO_PAGE;
+  }
+
+  return programmedPage;
+}
+
+/*
+  void voidRecord(uint16_t) marks record at given log page as dropped by programming its flags.
+*/
+void EntryLog::voidRecord(uint16_t page)
+{
+  uint8_t record[MT25Q_PAGE_SIZE];
+  fill_n(record, MT25Q_PAGE_SIZE, 0xFF);
+  record[ENTRY_LOG_FLAGS_OFFSET] = ENTRY_LOG_RECORD_VOID;
+
+  integrityIndex->programPage(page, record);
+}
+
+/*
+  bool reserve(uint16_t) makes sure given number of pages can be appended, running garbage collection if
+  needed. Erased subsectors reserved for garbage collection are not counted.
+
+  Returns false if log is full.
+*/
+bool EntryLog::reserve(uint16_t pageCount)
+{
+  while(getFreePageCount() < pageCount + ENTRY_LOG_RESERVED_SUBSECTORS * LOG_PAGES_PER_SUBSECTOR)
+  {
+    if(!collectGarbage(1))
+    {
+      printf("[Error] Entry log is full!\n");
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/*
+  bool appendPage(uint16_t, const uint8_t*) appends entry page as newest version of given id. Record is part of
+  the current batch and only survives a restart once commitBatch() was called. Space must be reserved first.
+
+  Returns false if log is full.
+*/
+bool EntryLog::appendPage(uint16_t id, const uint8_t* page)
+{
+  if(id >= MAX_ENTRY_COUNT)
+  {
+    return false;
+  }
+
+  uint8_t record[MT25Q_PAGE_SIZE];
+  copy_n(page, MT25Q_PAGE_SIZE, record);
+  record[0] = (id & 0xFF00) >> 8;
+  record[1] = id & 0xFF;
+
+  uint16_t programmedPage = programRecord(record);
+
+  if(programmedPage == ENTRY_LOG_NO_PAGE)
+  {
+    return false;
+  }
+
+  batchRecords.push_back(tuple<uint16_t, uint16_t, uint8_t, uint8_t, uint16_t>(id, idPage[id], idOffset[id], idSize[id], programmedPage));
+  mapRecord(id, programmedPage, ENTRY_LOG_NO_OFFSET, 0);
+
+  return true;
+}
+
+/*
+  bool appendPacked(uint16_t, const uint8_t*, uint8_t) appends entry data as newest version of given id. Entries
+  are collected in a packed record, which is programmed once the next entry does not fit or the batch gets
+  committed. Space must be reserved first (one page per entry at most).
+
+  Returns false if entry is too large or log is full.
+*/
+bool EntryLog::appendPacked(uint16_t id, const uint8_t* data, uint8_t size)
+{
+  if(id >= MAX_ENTRY_COUNT || size > ENTRY_LOG_PACKED_AREA_SIZE - ENTRY_LOG_PACKED_HEADER_SIZE)
+  {
+    return false;
+  }
+
+  if(packUsed + ENTRY_LOG_PACKED_HEADER_SIZE + size > ENTRY_LOG_PACKED_AREA_SIZE && !flushPackBuffer())
+  {
+    return false;
+  }
+
+  if(packEntries.empty())
+  {
+    fill_n(packBuffer, MT25Q_PAGE_SIZE, 0xFF);
+    packBuffer[0] = (ENTRY_LOG_PACKED_ID & 0xFF00) >> 8;
+    packBuffer[1] = ENTRY_LOG_PACKED_ID & 0xFF;
+  }
+
+  packBuffer[PACKED_PAGE_OFFSET(packUsed)] = (id & 0xFF00) >> 8;
+  packBuffer[PACKED_PAGE_OFFSET(packUsed + 1)] = id & 0xFF;
+  packBuffer[PACKED_PAGE_OFFSET(packUsed + 2)] = size;
+
+  for(uint8_t i = 0; i < size; i++)
+  {
+    packBuffer[PACKED_PAGE_OFFSET(packUsed + ENTRY_LOG_PACKED_HEADER_SIZE + i)] = data[i];
+  }
+
+  packEntries.push_back(tuple<uint16_t, uint8_t, uint8_t>(id, packUsed, size));
+  packUsed += ENTRY_LOG_PACKED_HEADER_SIZE + size;
+
+  return true;
+}
+
+/*
+  bool flushPackBuffer(void) programs collected packed record and maps its entries. Entries become part of the
+  current batch.
+
+  Returns false if log is full, collected entries are dropped then.
+*/
+bool EntryLog::flushPackBuffer(void)
+{
+  if(packEntries.empty())
+  {
+    return true;
+  }
+
+  uint16_t programmedPage = programRecord(packBuffer);
+
+  if(programmedPage != ENTRY_LOG_NO_PAGE)
+  {
+    for(auto& entry : packEntries)
+    {
+      uint16_t id = get<0>(entry);
+      batchRecords.push_back(tuple<uint16_t, uint16_t, uint8_t, uint8_t, uint16_t>(id, idPage[id], idOffset[id], idSize[id], programmedPage));
+      mapRecord(id, programmedPage, get<1>(entry), get<2>(entry));
+    }
+  }
+
+  packEntries.clear();
+  packUsed = 0;
+
+  return programmedPage != ENTRY_LOG_NO_PAGE;
+}
+
+/*
+  bool commitBatch(const uint16_t*, const uint16_t*, uint8_t) writes commit record, which makes all records
+  appended since last commit valid. Address table changes (slot and new id, ENTRY_SLOT_UNUSED for removed) of
+  the batch are stored with it, up to ENTRY_LOG_COMMIT_MAX_OPERATIONS.
+
+  Returns false if commit record could not be written, batch must be aborted then.
+*/
+bool EntryLog::commitBatch(const uint16_t* slots, const uint16_t* ids, uint8_t count)
+{
+  if(count > ENTRY_LOG_COMMIT_MAX_OPERATIONS)
+  {
+    printf("[Error] Too many address table changes for one commit record!\n");
+    return false;
+  }
+
+  if(!flushPackBuffer())
+  {
+    return false;
+  }
+
+  uint8_t record[MT25Q_PAGE_SIZE];
+  fill_n(record, MT25Q_PAGE_SIZE, 0xFF);
+
+  uint32_t batchSequence = nextSequence;
+  record[0] = (ENTRY_LOG_COMMIT_ID & 0xFF00) >> 8;
+  record[1] = ENTRY_LOG_COMMIT_ID & 0xFF;
+  record[COMMIT_BATCH_OFFSET] = (batchSequence >> 24) & 0xFF;
+  record[COMMIT_BATCH_OFFSET + 1] = (batchSequence >> 16) & 0xFF;
+  record[COMMIT_BATCH_OFFSET + 2] = (batchSequence >> 8) & 0xFF;
+  record[COMMIT_BATCH_OFFSET + 3] = batchSequence & 0xFF;
+  record[COMMIT_COUNT_OFFSET] = count;
+
+  for(uint8_t i = 0; i < count; i++)
+  {
+    uint8_t* operation = &record[COMMIT_OPERATIONS_OFFSET + i * 4];
+    operation[0] = (slots[i] & 0xFF00) >> 8;
+    operation[1] = slots[i] & 0xFF;
+    operation[2] = (ids[i] & 0xFF00) >> 8;
+    operation[3] = ids[i] & 0xFF;
+  }
+
+  uint16_t programmedPage = programRecord(record);
+
+  if(programmedPage == ENTRY_LOG_NO_PAGE)
+  {
+    return false;
+  }
+
+  uint16_t previousCommitPage = lastCommitPage;
+  lastCommitPage = programmedPage;
+  lastCommitSequence = batchSequence;
+  liveCount[programmedPage / LOG_PAGES_PER_SUBSECTOR]++;
+
+  if(count > 0)
+  {
+    pendingCommits.push_back(tuple<uint32_t, uint16_t>(batchSequence, programmedPage));
+  }
+
+  if(previousCommitPage != ENTRY_LOG_NO_PAGE && !isPendingPage(previousCommitPage))
+  {
+    liveCount[previousCommitPage / LOG_PAGES_PER_SUBSECTOR]--;
+  }
+
+  batchRecords.clear();
+
+  return true;
+}
+
+/*
+  void abortBatch(void) voids all records appended or moved since last commit and restores previous versions.
+*/
+void EntryLog::abortBatch(void)
+{
+  packEntries.clear();
+  packUsed = 0;
+
+  for(auto record = batchRecords.rbegin(); record != batchRecords.rend(); record++)
+  {
+    uint16_t id = get<0>(*record);
+    uint16_t previousPage = get<1>(*record);
+    uint16_t newPage = get<4>(*record);
+
+    if(id == ENTRY_LOG_COMMIT_ID)
+    {
+      voidRecord(newPage);
+      moveCommitRecord(newPage, previousPage);
+      continue;
+    }
+
+    // Packed record is voided once per entry, programming the flags again does not change them
+    voidRecord(newPage);
+    release(id);
+
+    if(previousPage != ENTRY_LOG_NO_PAGE)
+    {
+      mapRecord(id, previousPage, get<2>(*record), get<3>(*record));
+    }
+  }
+
+  batchRecords.clear();
+}
+
+/*
+  void moveCommitRecord(uint16_t, uint16_t) points pending and newest commit record at given page to its copy at
+  another page, e.g. when garbage collection moved it.
+*/
+void EntryLog::moveCommitRecord(uint16_t fromPage, uint16_t toPage)
+{
+  for(auto& commit : pendingCommits)
+  {
+    if(get<1>(commit) == fromPage)
+    {
+      get<1>(commit) = toPage;
+    }
+  }
+
+  if(fromPage == lastCommitPage)
+  {
+    lastCommitPage = toPage;
+  }
+
+  liveCount[fromPage / LOG_PAGES_PER_SUBSECTOR]--;
+  liveCount[toPage / LOG_PAGES_PER_SUBSECTOR]++;
+}
+
+/*
+  void tombstone(uint16_t) programs zeros over data of newest record of given id and drops it from map. Header,
+  flags and sequence number stay intact, so the record still shadows older versions of the entry on mount. Only
+  bits are cleared, no erase is needed. Id must not have an uncommitted record.
+*/
+void EntryLog::tombstone(uint16_t id)
+{
+  if(!contains(id))
+  {
+    return;
+  }
+
+  uint8_t record[MT25Q_PAGE_SIZE];
+  fill_n(record, MT25Q_PAGE_SIZE, 0xFF);
+
+  if(idOffset[id] == ENTRY_LOG_NO_OFFSET)
+  {
+    fill(&record[2], &record[ENTRY_LOG_FLAGS_OFFSET], 0x00);
+    fill(&record[ENTRY_LOG_SEQUENCE_OFFSET + 4], &record[MT25Q_PAGE_SIZE], 0x00);
+  }
+  else
+  {
+    // Keep [ID] [SIZE] header, later entries of packed record are found through it
+    for(uint8_t i = 0; i < idSize[id]; i++)
+    {
+      record[PACKED_PAGE_OFFSET(idOffset[id] + ENTRY_LOG_PACKED_HEADER_SIZE + i)] = 0x00;
+    }
+  }
+
+  integrityIndex->programPage(idPage[id], record);
+  release(id);
+}
+
+/*
+  void release(uint16_t) drops record of given id from map, its page becomes stale.
+*/
+void EntryLog::release(uint16_t id)
+{
+  if(!contains(id))
+  {
+    return;
+  }
+
+  liveCount[idPage[id] / LOG_PAGES_PER_SUBSECTOR]--;
+  idPage[id] = ENTRY_LOG_NO_PAGE;
+  idOffset[id] = ENTRY_LOG_NO_OFFSET;
+}
+
+/*
+  uint16_t findCompactionVictim(void) returns subsector which should be reclaimed next.
+  Subsectors without live records are always reclaimed, partly live ones only when log runs low on
+  erased subsectors.
+
+  Returns FREE_BITMAP_NONE if nothing should be reclaimed.
+*/
+uint16_t EntryLog::findCompactionVictim(void)
+{
+  uint16_t headSubsector = headPage != ENTRY_LOG_NO_PAGE ? headPage / LOG_PAGES_PER_SUBSECTOR : FREE_BITMAP_NONE;
+  uint16_t victim = FREE_BITMAP_NONE;
+
+  for(uint16_t subsector = 0; subsector < ENTRY_LOG_SUBSECTOR_COUNT; subsector++)
+  {
+    if(erasedSubsectors.isFree(subsector) || subsector == headSubsector)
+    {
+      continue;
+    }
+
+    if(liveCount[subsector] == 0)
+    {
+      return subsector;
+    }
+
+    if(victim == FREE_BITMAP_NONE || liveCount[subsector] < liveCount[victim])
+    {
+      victim = subsector;
+    }
+  }
+
+  // Moved records need a commit record as well
+  if(getErasedSubsectorCount() >= ENTRY_LOG_GC_THRESHOLD || victim == FREE_BITMAP_NONE ||
+    liveCount[victim] >= LOG_PAGES_PER_SUBSECTOR - 1)
+  {
+    return FREE_BITMAP_NONE;
+  }
+
+  return victim;
+}
+
+/*
+  void eraseSubsector(uint16_t) erases log subsector and marks it ready for use.
+*/
+void EntryLog::eraseSubsector(uint16_t subsector)
+{
+  integrityIndex->eraseSubsector(subsector);
+  liveCount[subsector] = 0;
+  erasedSubsectors.markFree(subsector);
+}
+
+/*
+  bool collectGarbage(uint8_t) reclaims up to maxSteps subsectors. Live records of a reclaimed subsector are
+  appended at log head and committed before it is erased. Must not be called while a batch is open.
+
+  Returns true if at least one subsector was reclaimed.
+*/
+bool EntryLog::collectGarbage(uint8_t maxSteps)
+{
+  bool reclaimed = false;
+
+  if(!batchRecords.empty() || !packEntries.empty())
+  {
+    return false;
+  }
+
+  for(uint8_t step = 0; step < maxSteps; step++)
+  {
+    uint16_t victim = findCompactionVictim();
+
+    if(victim == FREE_BITMAP_NONE)
+    {
+      break;
+    }
+
+    bool moved = false;
+
+    for(uint16_t i = 0; i < LOG_PAGES_PER_SUBSECTOR && liveCount[victim] > 0; i++)
+    {
+      uint16_t page = victim * LOG_PAGES_PER_SUBSECTOR + i;
+
+      uint8_t record[MT25Q_PAGE_SIZE];
+      flashMemory->readBytes(LOG_PAGE_ADDRESS(page), record, MT25Q_PAGE_SIZE);
+      uint16_t id = (record[0] << 8) | record[1];
+
+      // Live entries of a packed record are packed again, they are mapped once their new record is programmed
+      if(id == ENTRY_LOG_PACKED_ID)
+      {
+        bool isAppended = true;
+
+        forEachPackedEntry(page, [&](uint16_t entryId, uint8_t offset, uint8_t size)
+        {
+          if(isAppended && idPage[entryId] == page && idOffset[entryId] == offset)
+          {
+            uint8_t data[ENTRY_LOG_PACKED_AREA_SIZE];
+            for(uint8_t i = 0; i < size; i++)
+            {
+              data[i] = record[PACKED_PAGE_OFFSET(offset + ENTRY_LOG_PACKED_HEADER_SIZE + i)];
+            }
+
+            isAppended = appendPacked(entryId, data, size);
+            moved = true;
+          }
+        });
+
+        if(!isAppended)
+        {
+          abortBatch();
+          return reclaimed;
+        }
+
+        continue;
+      }
+
+      bool isLiveEntry = id < MAX_ENTRY_COUNT && idPage[id] == page;
+      bool isLiveCommit = id == ENTRY_LOG_COMMIT_ID && (page == lastCommitPage || isPendingPage(page));
+
+      if(!isLiveEntry && !isLiveCommit)
+      {
+        continue;
+      }
+
+      // Copies keep the batch sequence of a commit record, so pending changes are still applied in order
+      uint16_t programmedPage = programRecord(record);
+
+      if(programmedPage == ENTRY_LOG_NO_PAGE)
+      {
+        abortBatch();
+        return reclaimed;
+      }
+
+      moved = true;
+
+      // Moves are part of the batch like appended records, so an aborted batch maps the originals again
+      if(isLiveEntry)
+      {
+        batchRecords.push_back(tuple<uint16_t, uint16_t, uint8_t, uint8_t, uint16_t>(id, idPage[id], idOffset[id], idSize[id], programmedPage));
+        mapRecord(id, programmedPage, ENTRY_LOG_NO_OFFSET, 0);
+      }
+      else
+      {
+        batchRecords.push_back(tuple<uint16_t, uint16_t, uint8_t, uint8_t, uint16_t>(id, page, ENTRY_LOG_NO_OFFSET, 0, programmedPage));
+        moveCommitRecord(page, programmedPage);
+      }
+    }
+
+    // Moved records are only valid once committed, victim keeps the originals until then
+    if(moved && !commitBatch(NULL, NULL, 0))
+    {
+      abortBatch();
+      return reclaimed;
+    }
+
+    eraseSubsector(victim);
+    reclaimed = true;
+  }
+
+  return reclaimed;
+}
+
+/*
+  bool eraseStaleSubsector(uint16_t) erases given log subsector if it only holds stale records, e.g. to get rid of
+  old data after a factory reset. Unlike collectGarbage() no live records are moved.
+
+  Returns true if subsector was erased.
+*/
+bool EntryLog::eraseStaleSubsector(uint16_t subsector)
+{
+  uint16_t headSubsector = headPage != ENTRY_LOG_NO_PAGE ? headPage / LOG_PAGES_PER_SUBSECTOR : FREE_BITMAP_NONE;
+
+  if(subsector >= ENTRY_LOG_SUBSECTOR_COUNT || erasedSubsectors.isFree(subsector) || subsector == headSubsector ||
+    liveCount[subsector] > 0 || !batchRecords.empty() || !packEntries.empty())
+  {
+    return false;
+  }
+
+  eraseSubsector(subsector);
+
+  return true;
+}
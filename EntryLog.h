@@ -0,0 +1,103 @@
+#include "MT25Q.h"
+#include "FreeBitmap.h"
+#include "IntegrityIndex.h"
+#include "EntryManager.h"
+#include <cstdint>
+#include <vector>
+#include <functional>
+
+#ifndef ENTRY_LOG_H
+#define ENTRY_LOG_H
+
+#define ENTRY_LOG_NO_PAGE             0xFFFF  // Id has no record in log
+#define ENTRY_LOG_COMMIT_ID           0xFFFE  // Id of commit records
+#define ENTRY_LOG_PACKED_ID           0xFFFD  // Id of records packed with several entries
+#define ENTRY_LOG_NO_OFFSET           0xFF    // Record of id is a whole entry page
+#define ENTRY_LOG_PACKED_AREA_SIZE    249     // Bytes of packed record around flags and sequence number ([2..122] and [128..255])
+#define ENTRY_LOG_PACKED_HEADER_SIZE  3       // [ID 2 bytes] [SIZE 1 byte] in front of every packed entry
+#define ENTRY_LOG_RECORD_VOID         0x00    // Flags of records dropped by an aborted or interrupted batch
+#define ENTRY_LOG_NOTHING_APPLIED     0xFFFFFFFF  // No commit record has been applied to address table yet
+#define ENTRY_LOG_COMMIT_MAX_OPERATIONS 29    // Address table changes per commit record ([SLOT 2 bytes] [ID 2 bytes] each)
+
+/*
+  EntryLog is a log-structured store for entry pages.
+
+  Every write appends the entry page as a new record at the log head instead of erasing and re-writing a
+  subsector, so an edit costs a single page program. A RAM map points every id to its newest record.
+  Subsectors only holding stale records are erased by collectGarbage(), which also moves the few live records
+  out of mostly stale subsectors.
+
+  Records are normal entry pages with a sequence number in the unused part of the plaintext half. The sequence
+  number is programmed after the page itself, so a record torn by power loss is never taken as valid.
+
+  Packed records hold several variable-length entries, each with a small header ([ID] [SIZE]). The RAM map keeps
+  offset and size of every packed entry, so an entry is read with a single burst of exactly its bytes.
+
+  Records are written in batches. A batch becomes valid at once with its commit record, which also lists the
+  address table changes of the batch. Records written after the newest commit record are voided on mount.
+  Commit records stay live until their changes are applied to the address table in flash (setAppliedSequence).
+*/
+class EntryLog
+{
+  public:
+    EntryLog(MT25Q* flashMemory, IntegrityIndex* integrityIndex);
+    void mount(uint32_t appliedSequence);
+    bool reserve(uint16_t pageCount);
+    bool appendPage(uint16_t id, const uint8_t* page);
+    bool appendPacked(uint16_t id, const uint8_t* data, uint8_t size);
+    bool commitBatch(const uint16_t* slots, const uint16_t* ids, uint8_t count);
+    void abortBatch(void);
+    void release(uint16_t id);
+    void tombstone(uint16_t id);
+    bool contains(uint16_t id);
+    bool isPacked(uint16_t id);
+    uint8_t readPacked(uint16_t id, uint8_t* buffer, uint8_t maxSize);
+    uint8_t copyPacked(uint16_t id, const uint8_t* record, uint8_t* buffer, uint8_t maxSize);
+    uint32_t getPageAddress(uint16_t id);
+    uint16_t getErasedSubsectorCount(void);
+    uint16_t getPendingCommitCount(void);
+    uint32_t getLastCommitSequence(void);
+    void setAppliedSequence(uint32_t sequence);
+    void forEachPendingOperation(function<void(uint16_t, uint16_t)> apply);
+    bool collectGarbage(uint8_t maxSteps);
+    bool eraseStaleSubsector(uint16_t subsector);
+
+  private:
+    MT25Q* flashMemory;
+    IntegrityIndex* integrityIndex;
+    uint16_t idPage[MAX_ENTRY_COUNT];
+    uint8_t idOffset[MAX_ENTRY_COUNT];  // Offset in packed area, ENTRY_LOG_NO_OFFSET for whole page records
+    uint8_t idSize[MAX_ENTRY_COUNT];    // Size of packed entry without header
+    uint8_t liveCount[ENTRY_LOG_SUBSECTOR_COUNT];
+    FreeBitmap<ENTRY_LOG_SUBSECTOR_COUNT> erasedSubsectors;
+    uint16_t headPage;
+    uint16_t lastHeadSubsector;
+    uint32_t nextSequence;
+    uint16_t lastCommitPage;
+    uint32_t lastCommitSequence;
+    uint32_t appliedSequence;
+    vector<tuple<uint32_t, uint16_t>> pendingCommits;         // Batch sequence and page of unapplied commit records
+    vector<tuple<uint16_t, uint16_t, uint8_t, uint8_t, uint16_t>> batchRecords; // Id, previous page, offset and size, new page of uncommitted records and moved commit records
+    uint8_t packBuffer[MT25Q_PAGE_SIZE];                      // Packed record filled by appendPacked()
+    uint8_t packUsed;
+    vector<tuple<uint16_t, uint8_t, uint8_t>> packEntries;    // Id, offset and size of entries in packBuffer
+
+    void readRecordHeader(uint16_t page, uint16_t* id, uint8_t* flags, uint32_t* seq);
+    uint32_t readBatchSequence(uint16_t page);
+    bool isPending(uint32_t batchSequence);
+    bool isPendingPage(uint16_t page);
+    uint16_t getFreePageCount(void);
+    bool openHeadSubsector(void);
+    uint16_t programRecord(const uint8_t* page);
+    bool flushPackBuffer(void);
+    void mountRecord(uint16_t id, uint16_t page, uint8_t offset, uint8_t size, uint32_t seq);
+    void forEachPackedEntry(uint16_t page, function<void(uint16_t, uint8_t, uint8_t)> visit);
+    void readPackedArea(uint16_t page, uint8_t offset, uint8_t* buffer, uint16_t size);
+    void mapRecord(uint16_t id, uint16_t page, uint8_t offset, uint8_t size);
+    void voidRecord(uint16_t page);
+    void moveCommitRecord(uint16_t fromPage, uint16_t toPage);
+    uint16_t findCompactionVictim(void);
+    void eraseSubsector(uint16_t subsector);
+};
+
+#endif
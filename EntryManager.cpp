@@ -1,7 +1,23 @@
 #include "EntryManager.h"
-
-uint8_t EntryManager::addressTable[];
-vector<tuple<uint16_t, string>> EntryManager::credentialInfo;
+#include "EntryLog.h"
+#include "WearLeveler.h"
+#include "SearchIndex.h"
+#include "EntryCache.h"
+#include "UsageLog.h"
+#include "IntegrityIndex.h"
+
+#define TABLE_SEGMENT_HOME_ADDRESS(segment) ((segment) == 0 ? ADDRESS_TABLE_START_ADDRESS : \
+  ADDRESS_TABLE_SEGMENT_START_ADDRESS + ((segment) - 1) * MT25Q_SUBSECTOR_SIZE)
+
+SlotIndex<ENTRY_TABLE_SEGMENT_COUNT * ENTRY_TABLE_SEGMENT_SLOTS, MAX_ENTRY_COUNT> EntryManager::slotIndex;
+uint16_t EntryManager::credentialRanks[];
+FreeBitmap<MAX_ENTRY_COUNT> EntryManager::freeIds;
+FreeBitmap<MAX_ENTRY_COUNT> EntryManager::freeSlots;
+uint8_t EntryManager::metadataBuffer[];
+uint8_t EntryManager::scanBuffer[];
+uint8_t EntryManager::subsectorBuffer[];
+uint8_t EntryManager::transactionPages[][MT25Q_PAGE_SIZE];
+SnapshotPublisher<vector<uint16_t>> EntryManager::credentialInfo;
 
 /*
   EntryManager(MT25Q*, CryptoEngine*) initializes class.
@@ -12,381 +28,2396 @@ EntryManager::EntryManager(MT25Q* flashMemory, CryptoEngine* cryptoEngine)
 {
   this->flashMemory = flashMemory;
   this->cryptoEngine = cryptoEngine;
+  integrityIndex = new IntegrityIndex(flashMemory);
+  entryLog = new EntryLog(flashMemory, integrityIndex);
+  systemStorage = new WearLeveler(flashMemory);
+  searchIndex = new SearchIndex();
+  entryCache = new EntryCache(cryptoEngine);
+  usageLog = new UsageLog(flashMemory);
+  transactionOpen = false;
+  transactionSize = 0;
+  importOpen = false;
+
+  reloadSettings();
+}
+
+/*
+  void reloadSettings(void) reads settings from memory.
+*/
+void EntryManager::reloadSettings(void)
+{
+  WriteLock writeLock(&accessLock);
+
+  systemStorage->mount();
+  readSettingsRecord();
+  loadAddressTable();
+
+  transactionOpen = false;
+  transactionSize = 0;
+  importOpen = false;
+  migrationCursor = 0;
+  scanBufferSize = 0;
+  searchIndexValid = false;
+  searchIndex->clear();
+  entryCache->clear();
+
+  // Mounting EntryLog may void records, which already updates digests
+  integrityIndex->mount();
+
+  if(usesEntryLog())
+  {
+    mountEntryLog();
+  }
+  else
+  {
+    rebuildIdIndex();
+  }
+
+  usageLog->mount();
+  loadCredentialInfo();
+}
+
+/*
+  void loadAddressTable(void) reads address table segments listed in device settings page (the segment root)
+  into RAM. Devices written by older firmware only have the first segment.
+*/
+void EntryManager::loadAddressTable(void)
+{
+  tableSegmentCount = deviceSettings[TABLE_SEGMENT_COUNT_ADDRESS];
+  if(tableSegmentCount == 0 || tableSegmentCount > ENTRY_TABLE_SEGMENT_COUNT)
+  {
+    tableSegmentCount = 1;
+  }
+
+  dirtyTableSegments = 0;
+  slotIndex.clear();
+
+  for(uint8_t segment = 0; segment < tableSegmentCount; segment++)
+  {
+    systemStorage->readBytes(getTableSegmentAddress(segment), &slotIndex.getTable()[segment * MT25Q_SUBSECTOR_SIZE], MT25Q_SUBSECTOR_SIZE);
+  }
+}
+
+/*
+  uint32_t getTableSegmentAddress(uint8_t) returns home address of given address table segment from segment root.
+*/
+uint32_t EntryManager::getTableSegmentAddress(uint8_t segment)
+{
+  const uint8_t* root = &deviceSettings[TABLE_SEGMENT_ROOT_ADDRESS + segment * 4];
+  uint32_t segmentAddr = (root[0] << 24) | (root[1] << 16) | (root[2] << 8) | root[3];
+
+  // Root of older firmware is erased, its only segment is at ADDRESS_TABLE_START_ADDRESS
+  if(segmentAddr == 0xFFFFFFFF && segment == 0)
+  {
+    return ADDRESS_TABLE_START_ADDRESS;
+  }
+
+  bool isValid = segmentAddr == ADDRESS_TABLE_START_ADDRESS || ((segmentAddr & 0xFFF) == 0 &&
+    segmentAddr >= ADDRESS_TABLE_SEGMENT_START_ADDRESS &&
+    segmentAddr < ADDRESS_TABLE_SEGMENT_START_ADDRESS + (ENTRY_TABLE_SEGMENT_COUNT - 1) * MT25Q_SUBSECTOR_SIZE);
+
+  if(!isValid)
+  {
+    printf("[Error] Address table segment %d has invalid address 0x%08lX!\n", segment, (unsigned long)segmentAddr);
+    return TABLE_SEGMENT_HOME_ADDRESS(segment);
+  }
+
+  return segmentAddr;
+}
+
+/*
+  void writeAddressTable(void) writes address table segments changed since last call. Segment root is part of
+  device settings page and has to be written afterwards.
+*/
+void EntryManager::writeAddressTable(void)
+{
+  for(uint8_t segment = 0; segment < tableSegmentCount; segment++)
+  {
+    if(dirtyTableSegments & (1 << segment))
+    {
+      systemStorage->updateSubsector(getTableSegmentAddress(segment), &slotIndex.getTable()[segment * MT25Q_SUBSECTOR_SIZE]);
+    }
+  }
+
+  dirtyTableSegments = 0;
+}
+
+/*
+  void rebuildIdIndex(void) rebuilds id index, free id/slot bitmaps and entry count from address table.
+*/
+void EntryManager::rebuildIdIndex(void)
+{
+  const uint16_t slotCount = min<uint16_t>(tableSegmentCount * ENTRY_TABLE_SEGMENT_SLOTS, MAX_ENTRY_COUNT);
+
+  slotIndex.rebuild(slotCount);
+  freeIds.markAllFree();
+  freeSlots.markAllFree();
+
+  for(auto i = 0; i < slotCount; i++)
+  {
+    uint16_t foundId = slotIndex.getIdAtSlot(i);
+
+    if(foundId == ENTRY_SLOT_UNUSED)
+    {
+      continue;
+    }
+
+    // Slot stays occupied even if id is invalid so its page is never overwritten
+    freeSlots.markUsed(i);
+
+    if(foundId >= MAX_ENTRY_COUNT)
+    {
+      printf("[Error] Address table slot %d holds invalid id %d!\n", i, foundId);
+      continue;
+    }
+
+    freeIds.markUsed(foundId);
+  }
+
+  setEntryCount(MAX_ENTRY_COUNT - freeIds.countFree());
+}
+
+/*
+  bool usesEntryLog(void) returns true if entries of this device are stored in EntryLog instead of fixed slot pages.
+*/
+bool EntryManager::usesEntryLog(void)
+{
+  return !needsToBeInitialized() &&
+    (deviceSettings[STORE_FORMAT_ADDRESS] == ENTRY_STORE_LOG || deviceSettings[STORE_FORMAT_ADDRESS] == ENTRY_STORE_PACKED);
+}
+
+/*
+  bool usesPackedEntries(void) returns true if entries of this device are written packed into EntryLog records.
+*/
+bool EntryManager::usesPackedEntries(void)
+{
+  return !needsToBeInitialized() && deviceSettings[STORE_FORMAT_ADDRESS] == ENTRY_STORE_PACKED;
+}
+
+/*
+  void mountEntryLog(void) scans EntryLog, applies address table changes of commit records written since last
+  saveSettings() and drops records of ids which are not in address table anymore.
+*/
+void EntryManager::mountEntryLog(void)
+{
+  entryLog->mount(getAppliedSequence());
+
+  // Replaying changes already contained in address table is harmless, last change of a slot wins
+  entryLog->forEachPendingOperation([this](uint16_t slot, uint16_t id)
+  {
+    if(slot < MAX_ENTRY_COUNT)
+    {
+      setIdAtSlot(slot, id);
+    }
+  });
+
+  rebuildIdIndex();
+
+  for(uint16_t id = 0; id < MAX_ENTRY_COUNT; id++)
+  {
+    if(entryLog->contains(id) && slotIndex.getSlotOfId(id) == ENTRY_SLOT_UNUSED)
+    {
+      entryLog->release(id);
+    }
+  }
+}
+
+/*
+  uint32_t getAppliedSequence(void) returns batch sequence of newest EntryLog commit record contained in
+  address table in flash.
+*/
+uint32_t EntryManager::getAppliedSequence(void)
+{
+  return (deviceSettings[ENTRY_LOG_APPLIED_ADDRESS] << 24) | (deviceSettings[ENTRY_LOG_APPLIED_ADDRESS + 1] << 16) |
+    (deviceSettings[ENTRY_LOG_APPLIED_ADDRESS + 2] << 8) | deviceSettings[ENTRY_LOG_APPLIED_ADDRESS + 3];
+}
+
+/*
+  uint32_t getEntryPageAddress(uint16_t) returns flash address of entry page stored in given slot.
+
+  Returns ENTRY_NO_ADDRESS if entry page could not be found.
+*/
+uint32_t EntryManager::getEntryPageAddress(uint16_t slot)
+{
+  if(usesEntryLog())
+  {
+    uint32_t entryAddr = entryLog->getPageAddress(slotIndex.getIdAtSlot(slot));
+
+    // Entries of a migrated fixed slot store stay in their slot page until they get packed
+    if(entryAddr != ENTRY_NO_ADDRESS || !usesPackedEntries() || slot >= FIXED_STORE_MAX_SLOTS)
+    {
+      return entryAddr;
+    }
+  }
+
+  return ENTRY_START_ADDRESS + (slot << 8);
+}
+
+/*
+  void runMaintenance(void) does deferred flash work (e.g. EntryLog garbage collection, writing address table
+  once enough commit records piled up, erasing old data after formatStorage(), erasing subsectors and title/URL
+  records in advance, packing entries of older store formats, moving cold system subsectors, checking integrity of
+  EntryLog after mount). Does at most one of them per call. Should be called periodically from a low priority
+  thread once the AES key is set.
+
+  Erases done here keep adding and editing entries at page programs: EntryLog keeps ENTRY_LOG_GC_THRESHOLD
+  erased subsectors, WearLeveler keeps WEAR_ERASED_POOL_SIZE and the records of the ENTRY_PREPARED_SLOT_COUNT
+  lowest free slots are erased (see prepareFreeSlots()).
+*/
+void EntryManager::runMaintenance(void)
+{
+  WriteLock writeLock(&accessLock);
+
+  // Pages of scan buffer may be moved or erased below
+  scanBufferSize = 0;
+
+  if(transactionOpen)
+  {
+    return;
+  }
+
+  if(usesEntryLog() && entryLog->getPendingCommitCount() >= ENTRY_LOG_CHECKPOINT_INTERVAL)
+  {
+    saveSettings();
+    return;
+  }
+
+  if(wipeOldData())
+  {
+    return;
+  }
+
+  if(usesEntryLog() && entryLog->collectGarbage(1))
+  {
+    return;
+  }
+
+  if(prepareFreeSlots())
+  {
+    return;
+  }
+
+  if(migrateToPackedEntries())
+  {
+    return;
+  }
+
+  if(usageLog->prepareErasedJournalSubsector())
+  {
+    return;
+  }
+
+  // Checking reads up to 4MB, which must not hold back work above
+  if(integrityIndex->checkNextSubsectors())
+  {
+    return;
+  }
+
+  if(integrityIndex->prepareErasedJournalSubsector())
+  {
+    return;
+  }
+
+  if(systemStorage->prepareErasedJournalSubsector())
+  {
+    return;
+  }
+
+  // Erasing in advance comes last, it has work after every relocation and would hold back balancing
+  if(systemStorage->balance())
+  {
+    return;
+  }
+
+  systemStorage->prepareErasedSubsector();
+}
+
+/*
+  bool migrateToPackedEntries(void) moves entries of a fixed slot store or of whole page EntryLog records to
+  packed entries, one transaction per call. Store format is switched first, entries which are not packed yet
+  are still read from their old page until they get rewritten.
+
+  Returns true if anything was written.
+*/
+bool EntryManager::migrateToPackedEntries(void)
+{
+  if(needsToBeInitialized() || migrationCursor >= MAX_ENTRY_COUNT)
+  {
+    return false;
+  }
+
+  if(!usesPackedEntries())
+  {
+    bool isLogMounted = usesEntryLog();
+    deviceSettings[STORE_FORMAT_ADDRESS] = ENTRY_STORE_PACKED;
+
+    if(!isLogMounted)
+    {
+      mountEntryLog();
+    }
+
+    saveSettings();
+    return true;
+  }
+
+  if(!beginTransaction())
+  {
+    return false;
+  }
+
+  while(migrationCursor < MAX_ENTRY_COUNT && transactionSize < ENTRY_TRANSACTION_MAX_OPERATIONS)
+  {
+    uint16_t id = migrationCursor++;
+
+    if(slotIndex.getSlotOfId(id) == ENTRY_SLOT_UNUSED || entryLog->isPacked(id))
+    {
+      continue;
+    }
+
+    EntryView entry;
+    if(!readEntry(id, ENTRY_FIELDS_ALL, &entry))
+    {
+      continue;
+    }
+
+    char title[ENTRY_TITLE_SIZE + 1] = {};
+    char usr[ENTRY_USERNAME_SIZE + 1] = {};
+    char email[ENTRY_EMAIL_SIZE + 1] = {};
+    char pwd[ENTRY_PASSWORD_SIZE + 1] = {};
+    char url[ENTRY_URL_SIZE + 1] = {};
+
+    copy_n(entry.getField(ENTRY_FIELD_TITLE), entry.getFieldLength(ENTRY_FIELD_TITLE), title);
+    copy_n(entry.getField(ENTRY_FIELD_USERNAME), entry.getFieldLength(ENTRY_FIELD_USERNAME), usr);
+    copy_n(entry.getField(ENTRY_FIELD_EMAIL), entry.getFieldLength(ENTRY_FIELD_EMAIL), email);
+    copy_n(entry.getField(ENTRY_FIELD_PASSWORD), entry.getFieldLength(ENTRY_FIELD_PASSWORD), pwd);
+    copy_n(entry.getField(ENTRY_FIELD_URL), entry.getFieldLength(ENTRY_FIELD_URL), url);
+
+    queueEditEntry(id, title, usr, email, pwd, url);
+
+    fill_n(usr, ENTRY_USERNAME_SIZE, 0);
+    fill_n(email, ENTRY_EMAIL_SIZE, 0);
+    fill_n(pwd, ENTRY_PASSWORD_SIZE, 0);
+  }
+
+  if(transactionSize == 0)
+  {
+    abortTransaction();
+    return false;
+  }
+
+  return commitTransaction();
+}
+
+/*
+  void formatStorage(void) resets device to the state of first start without erasing the whole chip, which takes
+  minutes. Only device settings and first address table segment are rewritten and salt and password hash are
+  destroyed in every copy left in flash, so entries of the old vault are neither found nor can their AES key be
+  derived again. Takes a few subsector erases.
+
+  EntryLog records are retired by marking the newest commit record as applied, so they are never replayed. Old
+  data left in flash is erased by runMaintenance() afterwards (see wipeOldData()).
+*/
+void EntryManager::formatStorage(void)
+{
+  WriteLock writeLock(&accessLock);
+
+  flashMemory->commit();
+
+  if(!usesEntryLog())
+  {
+    entryLog->mount(ENTRY_LOG_NOTHING_APPLIED);
+  }
+
+  uint32_t retiredSequence = entryLog->getLastCommitSequence();
+
+  fill_n(deviceSettings, MT25Q_PAGE_SIZE, 0xFF);
+  deviceSettings[ENTRY_LOG_APPLIED_ADDRESS] = (retiredSequence >> 24) & 0xFF;
+  deviceSettings[ENTRY_LOG_APPLIED_ADDRESS + 1] = (retiredSequence >> 16) & 0xFF;
+  deviceSettings[ENTRY_LOG_APPLIED_ADDRESS + 2] = (retiredSequence >> 8) & 0xFF;
+  deviceSettings[ENTRY_LOG_APPLIED_ADDRESS + 3] = retiredSequence & 0xFF;
+  setWipeCursor(0);
+
+  // Settings first, an interrupted format leaves a device which needs to be initialized (and formatted) again.
+  // Fresh subsector leaves older records in a free pool subsector only.
+  writeSettingsRecord(true);
+
+  fill_n(subsectorBuffer, MT25Q_SUBSECTOR_SIZE, 0xFF);
+  systemStorage->updateSubsector(ADDRESS_TABLE_START_ADDRESS, subsectorBuffer);
+
+  // Older records stay in free pool subsectors, settings of firmware without wear leveling at their home address
+  const uint16_t keyMaterialSize = HASHED_PWD_START_ADDRESS + 32 - SALT_START_ADDRESS;
+  uint8_t page[MT25Q_PAGE_SIZE];
+  fill_n(page, MT25Q_PAGE_SIZE, 0xFF);
+  fill_n(&page[SALT_START_ADDRESS], keyMaterialSize, 0x00);
+
+  flashMemory->writeBytes(DEVICE_SETTINGS_START_ADDRESS, page);
+  systemStorage->destroyFreeCopies(SALT_START_ADDRESS, keyMaterialSize);
+  cryptoEngine->clearKeys();
+  usageLog->format();
+
+  reloadSettings();
+}
+
+/*
+  bool prepareFreeSlots(void) clears title/URL records left behind by removed entries in the lowest free slots,
+  which are taken by the next added entries. Their records can then be programmed without relocating the
+  title/URL index subsector.
+
+  Returns true if a subsector of title/URL index was rewritten.
+*/
+bool EntryManager::prepareFreeSlots(void)
+{
+  if(needsToBeInitialized())
+  {
+    return false;
+  }
+
+  const uint16_t recordsPerSubsector = MT25Q_SUBSECTOR_SIZE / METADATA_RECORD_SIZE;
+  uint8_t checkedSlots = 0;
+
+  for(uint16_t slot = freeSlots.findFirstFree(); slot < MAX_ENTRY_COUNT && checkedSlots < ENTRY_PREPARED_SLOT_COUNT; slot++)
+  {
+    if(!freeSlots.isFree(slot))
+    {
+      continue;
+    }
+
+    uint8_t record[METADATA_RECORD_SIZE];
+    systemStorage->readBytes(getMetadataAddress(slot), record, METADATA_RECORD_SIZE);
+    checkedSlots++;
+
+    if(!all_of(record, record + METADATA_RECORD_SIZE, [](uint8_t value) { return value == 0xFF; }))
+    {
+      return wipeMetadataSubsector(slot / recordsPerSubsector);
+    }
+  }
+
+  return false;
+}
+
+/*
+  bool wipeOldData(void) erases old data left in flash by formatStorage(), up to ENTRY_WIPE_ERASES_PER_RUN
+  subsectors per call. Wipe cursor is kept in device settings, so an interrupted wipe continues after restart.
+
+  Returns true if anything was erased.
+*/
+bool EntryManager::wipeOldData(void)
+{
+  uint16_t cursor = getWipeCursor();
+
+  if(needsToBeInitialized() || cursor == ENTRY_WIPE_DONE)
+  {
+    return false;
+  }
+
+  uint8_t erased = 0;
+  for(uint8_t i = 0; i < ENTRY_WIPE_CHECKS_PER_RUN && cursor < ENTRY_WIPE_SUBSECTOR_COUNT && erased < ENTRY_WIPE_ERASES_PER_RUN; i++)
+  {
+    if(wipeSubsector(cursor++))
+    {
+      erased++;
+    }
+  }
+
+  if(cursor < ENTRY_WIPE_SUBSECTOR_COUNT)
+  {
+    setWipeCursor(cursor);
+    return erased > 0;
+  }
+
+  setWipeCursor(ENTRY_WIPE_DONE);
+  saveSettings();
+
+  return true;
+}
+
+/*
+  bool wipeSubsector(uint16_t) erases subsector with given wipe index if it only holds old data. Log subsectors
+  come first, followed by fixed slot pages, title/URL index, home addresses of system subsectors, wear
+  leveling pool and usage log. Title/URL index is wiped before the pool, as rewriting it leaves its old copy in the pool.
+
+  Returns true if a subsector was erased or rewritten.
+*/
+bool EntryManager::wipeSubsector(uint16_t index)
+{
+  if(index < ENTRY_LOG_SUBSECTOR_COUNT)
+  {
+    return usesEntryLog() && entryLog->eraseStaleSubsector(index);
+  }
+  index -= ENTRY_LOG_SUBSECTOR_COUNT;
+
+  if(index < ENTRY_WIPE_FIXED_SUBSECTORS)
+  {
+    return wipeFixedSubsector(index);
+  }
+  index -= ENTRY_WIPE_FIXED_SUBSECTORS;
+
+  if(index < ENTRY_WIPE_METADATA_SUBSECTORS)
+  {
+    return wipeMetadataSubsector(index);
+  }
+  index -= ENTRY_WIPE_METADATA_SUBSECTORS;
+
+  if(index < WEAR_LOGICAL_SUBSECTOR_COUNT)
+  {
+    return systemStorage->eraseHomeSubsector(index);
+  }
+  index -= WEAR_LOGICAL_SUBSECTOR_COUNT;
+
+  if(index < WEAR_POOL_SUBSECTOR_COUNT)
+  {
+    return systemStorage->eraseFreeSubsector(index);
+  }
+  index -= WEAR_POOL_SUBSECTOR_COUNT;
+
+  return usageLog->eraseStaleJournalSubsector(index);
+}
+
+/*
+  bool wipeFixedSubsector(uint16_t) erases subsector of fixed slot store unless one of its slot pages still
+  holds an entry (fixed slot store in use or entry not packed yet).
+
+  Returns true if subsector was erased.
+*/
+bool EntryManager::wipeFixedSubsector(uint16_t subsector)
+{
+  const uint16_t slotsPerSubsector = MT25Q_SUBSECTOR_SIZE / MT25Q_PAGE_SIZE;
+  uint32_t subsectorAddr = ENTRY_START_ADDRESS + subsector * MT25Q_SUBSECTOR_SIZE;
+
+  if(!usesEntryLog())
+  {
+    return false;
+  }
+
+  for(uint16_t slot = subsector * slotsPerSubsector; slot < (subsector + 1) * slotsPerSubsector; slot++)
+  {
+    if(!freeSlots.isFree(slot) && getEntryPageAddress(slot) == ENTRY_START_ADDRESS + ((uint32_t)slot << 8))
+    {
+      return false;
+    }
+  }
+
+  flashMemory->readBytes(subsectorAddr, subsectorBuffer, MT25Q_SUBSECTOR_SIZE);
+  if(all_of(subsectorBuffer, subsectorBuffer + MT25Q_SUBSECTOR_SIZE, [](uint8_t value) { return value == 0xFF; }))
+  {
+    return false;
+  }
+
+  flashMemory->eraseBytes(subsectorAddr);
+
+  return true;
+}
+
+/*
+  bool wipeMetadataSubsector(uint8_t) clears title/URL records of unused slots in given subsector of title/URL
+  index, counted over the index of all address table segments.
+
+  Returns true if subsector was rewritten.
+*/
+bool EntryManager::wipeMetadataSubsector(uint8_t subsector)
+{
+  const uint16_t recordsPerSubsector = MT25Q_SUBSECTOR_SIZE / METADATA_RECORD_SIZE;
+  uint32_t subsectorAddr = getMetadataAddress(subsector * recordsPerSubsector);
+  bool isChanged = false;
+
+  systemStorage->readBytes(subsectorAddr, subsectorBuffer, MT25Q_SUBSECTOR_SIZE);
+
+  for(uint16_t i = 0; i < recordsPerSubsector; i++)
+  {
+    uint8_t* record = &subsectorBuffer[i * METADATA_RECORD_SIZE];
+    uint16_t slot = subsector * recordsPerSubsector + i;
+
+    if(slot < MAX_ENTRY_COUNT && freeSlots.isFree(slot) &&
+      !all_of(record, record + METADATA_RECORD_SIZE, [](uint8_t value) { return value == 0xFF; }))
+    {
+      fill_n(record, METADATA_RECORD_SIZE, 0xFF);
+      isChanged = true;
+    }
+  }
+
+  if(isChanged)
+  {
+    systemStorage->updateSubsector(subsectorAddr, subsectorBuffer);
+  }
+
+  return isChanged;
+}
+
+/*
+  uint8_t getWipeProgress(void) returns progress of erasing old data after formatStorage() in percent,
+  100 once everything is erased.
+*/
+uint8_t EntryManager::getWipeProgress(void)
+{
+  ReadLock readLock(&accessLock);
+
+  uint16_t cursor = getWipeCursor();
+
+  if(cursor == ENTRY_WIPE_DONE)
+  {
+    return 100;
+  }
+
+  return min<uint32_t>(cursor, ENTRY_WIPE_SUBSECTOR_COUNT - 1) * 100 / ENTRY_WIPE_SUBSECTOR_COUNT;
+}
+
+/*
+  uint16_t getWipeCursor(void) returns wipe index of next subsector to check, ENTRY_WIPE_DONE if no old data is
+  left. Devices written by older firmware have an erased cursor.
+*/
+uint16_t EntryManager::getWipeCursor(void)
+{
+  return (deviceSettings[WIPE_CURSOR_ADDRESS] << 8) | deviceSettings[WIPE_CURSOR_ADDRESS + 1];
+}
+
+/*
+  void setWipeCursor(uint16_t) sets wipe cursor in device settings. It is written with next saveSettings().
+*/
+void EntryManager::setWipeCursor(uint16_t cursor)
+{
+  deviceSettings[WIPE_CURSOR_ADDRESS] = (cursor & 0xFF00) >> 8;
+  deviceSettings[WIPE_CURSOR_ADDRESS + 1] = cursor & 0xFF;
+}
+
+/*
+  ReadWriteLock* getAccessLock(void) returns lock taken by all EntryManager methods, e.g. to wait for running
+  calls of other threads before stopping them.
+*/
+ReadWriteLock* EntryManager::getAccessLock(void)
+{
+  return &accessLock;
+}
+
+/*
+  void clearEntryCache(void) wipes cached entries and their session key. Must be called on logoff and reset,
+  RAM keeps its content over a software reset.
+*/
+void EntryManager::clearEntryCache(void)
+{
+  WriteLock writeLock(&accessLock);
+
+  entryCache->clear();
+}
+
+/*
+  uint8_t getIntegrityStatus(uint8_t*, uint32_t*, vector<uint16_t>*) returns result of integrity check of EntryLog
+  (see IntegrityIndex) with check progress in percent, root digest and damaged subsectors.
+*/
+uint8_t EntryManager::getIntegrityStatus(uint8_t* progress, uint32_t* rootDigest, vector<uint16_t>* damagedSubsectors)
+{
+  ReadLock readLock(&accessLock);
+
+  *progress = integrityIndex->getCheckProgress();
+  *rootDigest = integrityIndex->getRootDigest();
+  *damagedSubsectors = integrityIndex->getDamagedSubsectors();
+
+  return integrityIndex->getStatus();
+}
+
+/*
+  void getStats(uint32_t*) returns STATS_COUNT counters of flash and cache use, indexed by STATS_* (see
+  EntryManager.h).
+*/
+void EntryManager::getStats(uint32_t* stats)
+{
+  ReadLock readLock(&accessLock);
+
+  flashMemory->getCacheStats(&stats[STATS_FLASH_CACHE_HITS], &stats[STATS_FLASH_CACHE_MISSES]);
+  flashMemory->getUpdateStats(&stats[STATS_FLASH_UPDATES_SKIPPED], &stats[STATS_FLASH_UPDATES_PROGRAMMED],
+    &stats[STATS_FLASH_UPDATES_ERASED]);
+  systemStorage->getUpdateStats(&stats[STATS_WEAR_UPDATES_SKIPPED], &stats[STATS_WEAR_UPDATES_PROGRAMMED],
+    &stats[STATS_WEAR_UPDATES_RELOCATED]);
+  entryCache->getStats(&stats[STATS_ENTRY_CACHE_HITS], &stats[STATS_ENTRY_CACHE_MISSES]);
+  systemStorage->getWearStats(&stats[STATS_WEAR_MIN_ERASES], &stats[STATS_WEAR_MAX_ERASES],
+    &stats[STATS_WEAR_TOTAL_ERASES]);
+  stats[STATS_WEAR_REMAINING_ERASES] = systemStorage->getRemainingErases();
+}
+
+/*
+  uint16_t getEntryCount(void) returns current entry count from device settings.
+*/
+uint16_t EntryManager::getEntryCount(void)
+{
+  ReadLock readLock(&accessLock);
+  return (deviceSettings[1] << 8) | deviceSettings[2];
+}
+
+/*
+  void setEntryCount(uint16_t) sets new entry count.
+*/
+void EntryManager::setEntryCount(uint16_t entryCount)
+{
+  deviceSettings[1] = (entryCount & 0xFF00) >> 8;
+  deviceSettings[2] = entryCount & 0xFF;
+}
+
+/*
+  uint8_t getStringLength(const char*, uint8_t) returns length of a string (ending with '\0').
+  If string is longer than maxLength, value of maxLength will be returned.
+*/
+uint8_t EntryManager::getStringLength(const char* str, uint8_t maxLength)
+{
+  int length = 0;
+  while(length < maxLength && str[length] != '\0')
+  {
+    length++;
+  }
+
+  return length;
+}
+
+/*
+  void setIdAtSlot(uint16_t, uint16_t) writes id to given address table slot and keeps id index in sync.
+  Passing ENTRY_SLOT_UNUSED as id frees the slot.
+*/
+void EntryManager::setIdAtSlot(uint16_t slot, uint16_t id)
+{
+  useTableSegment(slot);
+  uint16_t oldId = slotIndex.setIdAtSlot(slot, id);
+
+  if(oldId < MAX_ENTRY_COUNT)
+  {
+    freeIds.markFree(oldId);
+  }
+
+  if(id == ENTRY_SLOT_UNUSED)
+  {
+    freeSlots.markFree(slot);
+    return;
+  }
+
+  freeSlots.markUsed(slot);
+
+  if(id < MAX_ENTRY_COUNT)
+  {
+    freeIds.markUsed(id);
+  }
+}
+
+/*
+  void useTableSegment(uint16_t) marks address table segment holding given slot for writeAddressTable(). Segments
+  up to this one are added to segment root if needed.
+*/
+void EntryManager::useTableSegment(uint16_t slot)
+{
+  uint8_t segment = slot / ENTRY_TABLE_SEGMENT_SLOTS;
+
+  if(segment >= tableSegmentCount)
+  {
+    for(uint8_t i = 0; i <= segment; i++)
+    {
+      uint32_t segmentAddr = i < tableSegmentCount ? getTableSegmentAddress(i) : TABLE_SEGMENT_HOME_ADDRESS(i);
+      uint8_t* root = &deviceSettings[TABLE_SEGMENT_ROOT_ADDRESS + i * 4];
+
+      root[0] = (segmentAddr >> 24) & 0xFF;
+      root[1] = (segmentAddr >> 16) & 0xFF;
+      root[2] = (segmentAddr >> 8) & 0xFF;
+      root[3] = segmentAddr & 0xFF;
+    }
+
+    // New segments are written completely, old content of their subsector is never read
+    for(uint8_t i = tableSegmentCount; i <= segment; i++)
+    {
+      dirtyTableSegments |= 1 << i;
+    }
+
+    tableSegmentCount = segment + 1;
+    deviceSettings[TABLE_SEGMENT_COUNT_ADDRESS] = tableSegmentCount;
+  }
+
+  dirtyTableSegments |= 1 << segment;
+}
+
+/*
+  uint8_t getFieldLength(const uint8_t*, uint8_t) returns length of a stored entry field.
+  Fields end at first '\0' or erased (0xFF) byte, or fill all maxLength bytes.
+*/
+uint8_t EntryManager::getFieldLength(const uint8_t* field, uint8_t maxLength)
+{
+  uint8_t length = 0;
+  while(length < maxLength && field[length] != '\0' && field[length] != 0xFF)
+  {
+    length++;
+  }
+
+  return length;
+}
+
+/*
+  uint16_t getUsedSlotRange(void) returns number of address table slots up to and including the last used one.
+  Slots reserved by an open transaction count as used.
+*/
+uint16_t EntryManager::getUsedSlotRange(void)
+{
+  uint16_t lastSlot = freeSlots.findLastUsed();
+  return lastSlot == FREE_BITMAP_NONE ? 0 : lastSlot + 1;
+}
+
+/*
+  void buildMetadataRecord(uint8_t, uint8_t*) builds title/URL index record ([ID] [TITLE] [URL]) of queued operation.
+*/
+void EntryManager::buildMetadataRecord(uint8_t index, uint8_t* record)
+{
+  if(!usesPackedEntries())
+  {
+    copy_n(transactionPages[index], METADATA_RECORD_SIZE, record);
+    return;
+  }
+
+  const uint8_t* data = transactionPages[index];
+  uint8_t titleLength = data[0];
+  uint8_t urlLength = data[1 + titleLength];
+
+  fill_n(record, METADATA_RECORD_SIZE, 0xFF);
+  record[0] = (transactionIds[index] & 0xFF00) >> 8;
+  record[1] = transactionIds[index] & 0xFF;
+  copy_n(&data[1], titleLength, &record[ENTRY_TITLE_OFFSET]);
+  copy_n(&data[2 + titleLength], urlLength, &record[ENTRY_URL_OFFSET]);
+}
+
+/*
+  uint32_t getMetadataAddress(uint16_t) returns home address of title/URL record of given slot. Every address
+  table segment has its own index region, the first one at METADATA_START_ADDRESS, further ones behind the
+  integrity journal at METADATA_SEGMENT_START_ADDRESS.
+*/
+uint32_t EntryManager::getMetadataAddress(uint16_t slot)
+{
+  if(slot < ENTRY_TABLE_SEGMENT_SLOTS)
+  {
+    return METADATA_START_ADDRESS + slot * METADATA_RECORD_SIZE;
+  }
+
+  return METADATA_SEGMENT_START_ADDRESS + (uint32_t)(slot - ENTRY_TABLE_SEGMENT_SLOTS) * METADATA_RECORD_SIZE;
+}
+
+/*
+  void tombstoneMetadataRecords(void) programs zeros over title/URL records of entries removed by current
+  transaction, so their plaintext is gone right away without relocating the index subsector. The id is kept, a
+  cleared record must not read as record of id 0. Cleared records are erased later by prepareFreeSlots().
+*/
+void EntryManager::tombstoneMetadataRecords(void)
+{
+  for(uint8_t i = 0; i < transactionSize; i++)
+  {
+    if(transactionTypes[i] != ENTRY_OPERATION_REMOVE)
+    {
+      continue;
+    }
+
+    uint32_t recordAddr = getMetadataAddress(transactionSlots[i]);
+    uint8_t page[MT25Q_PAGE_SIZE];
+    systemStorage->readBytes(recordAddr & 0xFFFFFF00, page, MT25Q_PAGE_SIZE);
+    fill(&page[(recordAddr & 0xFF) + ENTRY_TITLE_OFFSET], &page[(recordAddr & 0xFF) + METADATA_RECORD_SIZE], 0x00);
+
+    systemStorage->updateBytes(recordAddr & 0xFFFFFF00, page);
+  }
+}
+
+/*
+  void writeMetadataRecords(void) stores plaintext part ([ID] [TITLE] [URL]) of all entry pages written by
+  current transaction in title/URL index, so listing entries does not need to read or decrypt entry pages.
+  Records are grouped by subsector, each touched subsector of the index is written once.
+*/
+void EntryManager::writeMetadataRecords(void)
+{
+  for(uint8_t i = 0; i < transactionSize; i++)
+  {
+    if(transactionTypes[i] == ENTRY_OPERATION_REMOVE)
+    {
+      continue;
+    }
+
+    uint32_t subsectorAddr = getMetadataAddress(transactionSlots[i]) & 0xFFFFF000;
+    bool isWritten = false;
+
+    for(uint8_t j = 0; j < i; j++)
+    {
+      isWritten |= transactionTypes[j] != ENTRY_OPERATION_REMOVE &&
+        (getMetadataAddress(transactionSlots[j]) & 0xFFFFF000) == subsectorAddr;
+    }
+
+    if(isWritten)
+    {
+      continue;
+    }
+
+    systemStorage->readBytes(subsectorAddr, subsectorBuffer, MT25Q_SUBSECTOR_SIZE);
+
+    for(uint8_t j = i; j < transactionSize; j++)
+    {
+      uint32_t recordAddr = getMetadataAddress(transactionSlots[j]);
+
+      if(transactionTypes[j] != ENTRY_OPERATION_REMOVE && (recordAddr & 0xFFFFF000) == subsectorAddr)
+      {
+        buildMetadataRecord(j, &subsectorBuffer[recordAddr & 0xFFF]);
+      }
+    }
+
+    // Edits which do not change title or url leave index untouched
+    systemStorage->updateSubsector(subsectorAddr, subsectorBuffer);
+  }
+}
+
+/*
+  void saveSettings(void) writes Address Table and Device Settings to memory and commits buffered page updates.
+  Afterwards EntryLog commit records are not needed to restore address table anymore.
+*/
+void EntryManager::saveSettings(void)
+{
+  WriteLock writeLock(&accessLock);
+
+  uint32_t appliedSequence = entryLog->getLastCommitSequence();
+
+  if(usesEntryLog())
+  {
+    deviceSettings[ENTRY_LOG_APPLIED_ADDRESS] = (appliedSequence >> 24) & 0xFF;
+    deviceSettings[ENTRY_LOG_APPLIED_ADDRESS + 1] = (appliedSequence >> 16) & 0xFF;
+    deviceSettings[ENTRY_LOG_APPLIED_ADDRESS + 2] = (appliedSequence >> 8) & 0xFF;
+    deviceSettings[ENTRY_LOG_APPLIED_ADDRESS + 3] = appliedSequence & 0xFF;
+  }
+
+  // Address table first, if settings do not get written the commit records are replayed once more
+  writeAddressTable();
+  writeSettingsRecord(false);
+  flashMemory->commit();
+
+  if(usesEntryLog())
+  {
+    entryLog->setAppliedSequence(appliedSequence);
+  }
+}
+
+/*
+  void readSettingsRecord(void) loads newest device settings record. Every saveSettings() appends a record with
+  a higher sequence number to the settings subsector, records torn by power loss fail their checksum and are
+  skipped. Devices written by older firmware have a single settings page without sequence number and checksum,
+  which is used as it is.
+*/
+void EntryManager::readSettingsRecord(void)
+{
+  systemStorage->readBytes(DEVICE_SETTINGS_START_ADDRESS, subsectorBuffer, MT25Q_SUBSECTOR_SIZE);
+
+  bool recordFound = false;
+  settingsSequence = 0;
+  settingsRecord = 0;
+  nextSettingsRecord = 0;
+
+  for(uint8_t i = 0; i < SETTINGS_RECORD_COUNT; i++)
+  {
+    const uint8_t* record = &subsectorBuffer[i * MT25Q_PAGE_SIZE];
+
+    if(all_of(record, record + MT25Q_PAGE_SIZE, [](uint8_t value) { return value == 0xFF; }))
+    {
+      continue;
+    }
+
+    nextSettingsRecord = i + 1;
+
+    const uint8_t* seqBytes = &record[SETTINGS_SEQUENCE_ADDRESS];
+    const uint8_t* checksumBytes = &record[SETTINGS_CHECKSUM_ADDRESS];
+    uint32_t seq = (seqBytes[0] << 24) | (seqBytes[1] << 16) | (seqBytes[2] << 8) | seqBytes[3];
+    uint32_t checksum = (checksumBytes[0] << 24) | (checksumBytes[1] << 16) | (checksumBytes[2] << 8) | checksumBytes[3];
+
+    if(seq != 0xFFFFFFFF && checksum == getSettingsChecksum(record) && (!recordFound || seq > settingsSequence))
+    {
+      recordFound = true;
+      settingsSequence = seq;
+      settingsRecord = i;
+    }
+  }
+
+  copy_n(&subsectorBuffer[settingsRecord * MT25Q_PAGE_SIZE], MT25Q_PAGE_SIZE, deviceSettings);
+}
+
+/*
+  void writeSettingsRecord(bool) appends device settings as new record behind the newest one, which only
+  programs a page. Settings subsector is rewritten (relocated by WearLeveler) once all SETTINGS_RECORD_COUNT
+  pages are used or if isFresh is set, which drops all older records. Unchanged settings are not written.
+*/
+void EntryManager::writeSettingsRecord(bool isFresh)
+{
+  uint8_t newest[SETTINGS_SEQUENCE_ADDRESS];
+  systemStorage->readBytes(DEVICE_SETTINGS_START_ADDRESS + settingsRecord * MT25Q_PAGE_SIZE, newest, SETTINGS_SEQUENCE_ADDRESS);
+
+  if(nextSettingsRecord > 0 && equal(newest, newest + SETTINGS_SEQUENCE_ADDRESS, deviceSettings))
+  {
+    return;
+  }
+
+  settingsSequence++;
+  deviceSettings[SETTINGS_SEQUENCE_ADDRESS] = (settingsSequence >> 24) & 0xFF;
+  deviceSettings[SETTINGS_SEQUENCE_ADDRESS + 1] = (settingsSequence >> 16) & 0xFF;
+  deviceSettings[SETTINGS_SEQUENCE_ADDRESS + 2] = (settingsSequence >> 8) & 0xFF;
+  deviceSettings[SETTINGS_SEQUENCE_ADDRESS + 3] = settingsSequence & 0xFF;
+
+  uint32_t checksum = getSettingsChecksum(deviceSettings);
+  deviceSettings[SETTINGS_CHECKSUM_ADDRESS] = (checksum >> 24) & 0xFF;
+  deviceSettings[SETTINGS_CHECKSUM_ADDRESS + 1] = (checksum >> 16) & 0xFF;
+  deviceSettings[SETTINGS_CHECKSUM_ADDRESS + 2] = (checksum >> 8) & 0xFF;
+  deviceSettings[SETTINGS_CHECKSUM_ADDRESS + 3] = checksum & 0xFF;
+
+  if(isFresh || nextSettingsRecord >= SETTINGS_RECORD_COUNT)
+  {
+    fill_n(subsectorBuffer, MT25Q_SUBSECTOR_SIZE, 0xFF);
+    copy_n(deviceSettings, MT25Q_PAGE_SIZE, subsectorBuffer);
+    systemStorage->updateSubsector(DEVICE_SETTINGS_START_ADDRESS, subsectorBuffer);
+    settingsRecord = 0;
+  }
+  else
+  {
+    systemStorage->updateBytes(DEVICE_SETTINGS_START_ADDRESS + nextSettingsRecord * MT25Q_PAGE_SIZE, deviceSettings);
+    settingsRecord = nextSettingsRecord;
+  }
+
+  nextSettingsRecord = settingsRecord + 1;
+}
+
+/*
+  uint32_t getSettingsChecksum(const uint8_t*) returns FNV-1a hash of device settings record up to its checksum.
+*/
+uint32_t EntryManager::getSettingsChecksum(const uint8_t* record)
+{
+  uint32_t hash = 2166136261;
+
+  for(uint16_t i = 0; i < SETTINGS_CHECKSUM_ADDRESS; i++)
+  {
+    hash = (hash ^ record[i]) * 16777619;
+  }
+
+  return hash;
+}
+
+/*
+  void buildEntryPage(uint16_t, const char*, const char*, const char*, const char*, const char*, uint8_t*) builds
+  entry page with encrypted secret half.
+*/
+void EntryManager::buildEntryPage(uint16_t id, const char* title, const char* usr, const char* email, const char* pwd, const char* url, uint8_t* page)
+{
+  memset(page, 0xFF, MT25Q_PAGE_SIZE);
+
+  page[0] = (id & 0xFF00) >> 8;
+  page[1] = id & 0xFF;
+
+  /*
+    Entries are saved in 256 byte pages in following format:
+
+    [ID 2 bytes] [TITLE 16 bytes] [URL 24 bytes] [Not Defined 86 bytes] (First 128 bytes - unencrypted)
+    [USERNAME 32 bytes] [EMAIL 64 bytes] [PASSWORD 32 bytes]            (Last 128 bytes - encrypted with AES)
+  */
+
+  // [TITLE 16 bytes]
+  copy_n(title, getStringLength(title, ENTRY_TITLE_SIZE), &page[2]);
+
+  // [URL 24 bytes]
+  copy_n(url, getStringLength(url, ENTRY_URL_SIZE), &page[2 + ENTRY_TITLE_SIZE]);
+
+  // [USERNAME 32 bytes]
+  copy_n(usr, getStringLength(usr, ENTRY_USERNAME_SIZE), &page[128]);
+
+  // [EMAIL 64 bytes]
+  copy_n(email, getStringLength(email, ENTRY_EMAIL_SIZE), &page[128 + ENTRY_USERNAME_SIZE]);
+
+  // [PASSWORD 32 bytes]
+  copy_n(pwd, getStringLength(pwd, ENTRY_PASSWORD_SIZE), &page[128 + ENTRY_USERNAME_SIZE + ENTRY_EMAIL_SIZE]);
+
+  uint8_t encData[128];
+  cryptoEngine->cryptWithAesCBC(&page[128], encData, MBEDTLS_AES_ENCRYPT);
+
+  // Write encrypted Data (128 bytes) back to page
+  copy_n(encData, 128, &page[128]);
+}
+
+/*
+  uint8_t buildPackedEntry(const char*, const char*, const char*, const char*, const char*, uint8_t*) builds packed
+  entry with length-prefixed fields, only the secret part gets encrypted.
+
+  Returns size of packed entry.
+*/
+uint8_t EntryManager::buildPackedEntry(const char* title, const char* usr, const char* email, const char* pwd, const char* url, uint8_t* data)
+{
+  /*
+    Packed entries use as many bytes as their fields need:
+
+    [TITLE LEN] [TITLE] [URL LEN] [URL] [SECRET SIZE]                          (unencrypted)
+    [USERNAME LEN] [USERNAME] [EMAIL LEN] [EMAIL] [PASSWORD LEN] [PASSWORD]   (padded to AES block size, encrypted)
+  */
+  uint8_t size = 0;
+
+  uint8_t titleLength = getStringLength(title, ENTRY_TITLE_SIZE);
+  data[size++] = titleLength;
+  copy_n(title, titleLength, &data[size]);
+  size += titleLength;
+
+  uint8_t urlLength = getStringLength(url, ENTRY_URL_SIZE);
+  data[size++] = urlLength;
+  copy_n(url, urlLength, &data[size]);
+  size += urlLength;
+
+  uint8_t secret[ENTRY_PACKED_SECRET_MAX_SIZE];
+  uint8_t secretSize = 0;
+
+  uint8_t usrLength = getStringLength(usr, ENTRY_USERNAME_SIZE);
+  secret[secretSize++] = usrLength;
+  copy_n(usr, usrLength, &secret[secretSize]);
+  secretSize += usrLength;
+
+  uint8_t emailLength = getStringLength(email, ENTRY_EMAIL_SIZE);
+  secret[secretSize++] = emailLength;
+  copy_n(email, emailLength, &secret[secretSize]);
+  secretSize += emailLength;
+
+  uint8_t pwdLength = getStringLength(pwd, ENTRY_PASSWORD_SIZE);
+  secret[secretSize++] = pwdLength;
+  copy_n(pwd, pwdLength, &secret[secretSize]);
+  secretSize += pwdLength;
+
+  uint8_t paddedSize = (secretSize + 15) & 0xF0;
+  fill(&secret[secretSize], &secret[paddedSize], 0x00);
+
+  data[size++] = paddedSize;
+  cryptoEngine->cryptWithAesCBC(secret, &data[size], MBEDTLS_AES_ENCRYPT, paddedSize);
+  size += paddedSize;
+
+  fill_n(secret, ENTRY_PACKED_SECRET_MAX_SIZE, 0x00);
+
+  return size;
+}
+
+/*
+  void buildTransactionEntry(uint8_t, uint16_t, const char*, const char*, const char*, const char*, const char*)
+  builds entry data of queued operation in the format of the entry store.
+*/
+void EntryManager::buildTransactionEntry(uint8_t index, uint16_t id, const char* title, const char* usr, const char* email, const char* pwd, const char* url)
+{
+  if(usesPackedEntries())
+  {
+    transactionSizes[index] = buildPackedEntry(title, usr, email, pwd, url, transactionPages[index]);
+    return;
+  }
+
+  buildEntryPage(id, title, usr, email, pwd, url, transactionPages[index]);
+  transactionSizes[index] = 0;
+}
+
+/*
+  bool addEntry(const char*, const char*, const char*, const char*, const char*) adds entry to next free slot in
+  address table and stores it in the corresponding address on the flash.
+
+  Returns true if entry has been added.
+*/
+bool EntryManager::addEntry(const char* title, const char* usr, const char* email, const char* pwd, const char* url)
+{
+  WriteLock writeLock(&accessLock);
+
+  if(!beginTransaction())
+  {
+    return false;
+  }
+
+  if(!queueAddEntry(title, usr, email, pwd, url))
+  {
+    abortTransaction();
+    return false;
+  }
+
+  return commitTransaction();
+}
+
+/*
+  bool getEntry(uint16_t, char*, char*, char*, char*, char*) gets information of entry via its id.
+  Fields passed as NULL are skipped, secret half is only decrypted if usr, email or pwd is requested.
+
+  Returns true if entry was found.
+*/
+bool EntryManager::getEntry(uint16_t id, uint8_t *title, uint8_t *usr, uint8_t *email, uint8_t *pwd, uint8_t *url)
+{
+  ReadLock readLock(&accessLock);
+
+  uint8_t fieldMask = (title != NULL ? ENTRY_FIELD_TITLE : 0) | (url != NULL ? ENTRY_FIELD_URL : 0) |
+    (usr != NULL ? ENTRY_FIELD_USERNAME : 0) | (email != NULL ? ENTRY_FIELD_EMAIL : 0) | (pwd != NULL ? ENTRY_FIELD_PASSWORD : 0);
+
+  EntryView entry;
+  if(!readEntry(id, fieldMask, &entry))
+  {
+    return false;
+  }
+
+  if(title != NULL)
+  {
+    // [TITLE 16 bytes]
+    copy_n(entry.getField(ENTRY_FIELD_TITLE), ENTRY_TITLE_SIZE, title);
+  }
+
+  if(url != NULL)
+  {
+    // [URL 24 bytes]
+    copy_n(entry.getField(ENTRY_FIELD_URL), ENTRY_URL_SIZE, url);
+  }
+
+  if(usr != NULL)
+  {
+    // [USERNAME 32 bytes]
+    copy_n(entry.getField(ENTRY_FIELD_USERNAME), ENTRY_USERNAME_SIZE, usr);
+  }
+
+  if(email != NULL)
+  {
+    // [EMAIL 64 bytes]
+    copy_n(entry.getField(ENTRY_FIELD_EMAIL), ENTRY_EMAIL_SIZE, email);
+  }
+
+  if(pwd != NULL)
+  {
+    // [PASSWORD 32 bytes]
+    copy_n(entry.getField(ENTRY_FIELD_PASSWORD), ENTRY_PASSWORD_SIZE, pwd);
+  }
+
+  return true;
+}
+
+/*
+  bool readEntry(uint16_t, uint8_t, EntryView*) reads entry via its id into view. fieldMask (ENTRY_FIELD_*) selects
+  which fields are needed: only the plaintext half of the page is read unless a secret field is requested,
+  and only then the secret half gets read and decrypted. Entries read with secret fields are kept in EntryCache,
+  reading them again takes neither flash reads nor the AES-CBC decrypt.
+
+  Returns true if entry was found.
+*/
+bool EntryManager::readEntry(uint16_t id, uint8_t fieldMask, EntryView* view)
+{
+  ReadLock readLock(&accessLock);
+
+  if(getEntryCount() == 0)
+  {
+    printf("[Error] No entry found!\n");
+    return false;
+  }
+
+  uint16_t slot = slotIndex.getSlotOfId(id);
+
+  if(slot == ENTRY_SLOT_UNUSED)
+  {
+    printf("[Error] Entry with given id does not exist!\n");
+    return false;
+  }
+
+  bool needsSecret = (fieldMask & ENTRY_FIELDS_SECRET) != 0;
+
+  view->clear();
+
+  if(entryCache->read(id, needsSecret, view->page))
+  {
+    view->loadedFields = ENTRY_FIELDS_PLAIN | (needsSecret ? ENTRY_FIELDS_SECRET : 0);
+    return true;
+  }
+
+  bool isRead;
+
+  if(usesEntryLog() && entryLog->isPacked(id))
+  {
+    isRead = readPackedEntry(id, fieldMask, view);
+  }
+  else
+  {
+    uint32_t entryAddr = getEntryPageAddress(slot);
+
+    if(entryAddr == ENTRY_NO_ADDRESS)
+    {
+      printf("[Error] Entry page of id %d is missing!\n", id);
+      return false;
+    }
+
+    flashMemory->readBytes(entryAddr, view->page, needsSecret ? MT25Q_PAGE_SIZE : ENTRY_PLAIN_SIZE);
+    isRead = openEntryPage(id, needsSecret, view);
+  }
+
+  // Only complete pages are cached, plaintext reads of listing and search would just push them out
+  if(isRead && needsSecret)
+  {
+    entryCache->insert(id, view->page);
+  }
+
+  return isRead;
+}
+
+/*
+  bool openEntryPage(uint16_t, bool, EntryView*) checks id of entry page read into view and decrypts its secret
+  half in place if needed.
+
+  Returns true if page belongs to given id.
+*/
+bool EntryManager::openEntryPage(uint16_t id, bool needsSecret, EntryView* view)
+{
+  if(view->getId() != id)
+  {
+    printf("[Error] Found entry was saved with the wrong id! Id was: %d\n", view->getId());
+    view->clear();
+    return false;
+  }
+
+  view->loadedFields = ENTRY_FIELDS_PLAIN;
+
+  if(needsSecret)
+  {
+    // Decrypt secret half in place
+    cryptoEngine->cryptWithAesCBC(&view->page[ENTRY_PLAIN_SIZE], &view->page[ENTRY_PLAIN_SIZE], MBEDTLS_AES_DECRYPT);
+    view->loadedFields |= ENTRY_FIELDS_SECRET;
+  }
+
+  return true;
+}
+
+/*
+  void recordUse(uint16_t) counts a use of entry (typed on the keyboard or sent to the computer) and moves it up
+  in credentialInfo past the entries used less often. Mostly costs a single page program, see UsageLog.
+*/
+void EntryManager::recordUse(uint16_t id)
+{
+  WriteLock writeLock(&accessLock);
+
+  if(slotIndex.getSlotOfId(id) == ENTRY_SLOT_UNUSED || !usageLog->increment(id))
+  {
+    return;
+  }
+
+  uint16_t oldRank = credentialRanks[id];
+  if(oldRank == ENTRY_SLOT_UNUSED)
+  {
+    return;
+  }
+
+  vector<uint16_t> nextCredentialInfo(*credentialInfo.read());
+
+  uint16_t newRank = oldRank;
+  while(newRank > 0 && isRankedBefore(id, nextCredentialInfo[newRank - 1]))
+  {
+    newRank--;
+  }
+
+  if(newRank == oldRank)
+  {
+    return;
+  }
+
+  rotate(nextCredentialInfo.begin() + newRank, nextCredentialInfo.begin() + oldRank, nextCredentialInfo.begin() + oldRank + 1);
+  setCredentialRanks(nextCredentialInfo, newRank, oldRank + 1);
+  credentialInfo.publish(move(nextCredentialInfo));
+}
+
+/*
+  void beginScan(EntryScan*, uint16_t) starts a scan over all entries in slots from firstSlot on. readNextEntry()
+  hands them out in the order of their pages in flash, so neighbouring entries are read with a single burst.
+*/
+void EntryManager::beginScan(EntryScan* scan, uint16_t firstSlot)
+{
+  ReadLock readLock(&accessLock);
+
+  const uint16_t slotRange = getUsedSlotRange();
+
+  scan->positions.clear();
+  scan->positions.reserve(getEntryCount());
+  scan->nextPosition = 0;
+
+  for(uint16_t slot = firstSlot; slot < slotRange; slot++)
+  {
+    uint16_t id = slotIndex.getIdAtSlot(slot);
+
+    if(id != ENTRY_SLOT_UNUSED)
+    {
+      // Missing pages (ENTRY_NO_ADDRESS) are sorted to the end and reported by readEntry()
+      scan->positions.push_back(tuple<uint32_t, uint16_t>(getEntryPageAddress(slot), id));
+    }
+  }
+
+  sort(scan->positions.begin(), scan->positions.end());
+}
+
+/*
+  bool readNextEntry(EntryScan*, uint8_t, EntryView*) reads next entry of scan into view. Like readEntry(),
+  fieldMask selects the fields to load and the secret half is only decrypted if a secret field is requested.
+
+  Pages are taken from the scan buffer, which is filled with up to ENTRY_SCAN_BUFFER_SIZE bytes of consecutive
+  pages at once. Entries removed since beginScan() are skipped, entries written again since then are read from
+  their new page.
+
+  Returns false if scan has no entry left.
+*/
+bool EntryManager::readNextEntry(EntryScan* scan, uint8_t fieldMask, EntryView* view)
+{
+  ReadLock readLock(&accessLock);
+
+  // Scan buffer is shared by all readers
+  ScopedLock<Mutex> scanLock(scanMutex);
+
+  bool needsSecret = (fieldMask & ENTRY_FIELDS_SECRET) != 0;
+
+  while(scan->nextPosition < scan->positions.size())
+  {
+    uint32_t entryAddr = get<0>(scan->positions[scan->nextPosition]);
+    uint16_t id = get<1>(scan->positions[scan->nextPosition]);
+    uint16_t slot = slotIndex.getSlotOfId(id);
+
+    if(slot == ENTRY_SLOT_UNUSED)
+    {
+      scan->nextPosition++;
+      continue;
+    }
+
+    if(entryAddr == ENTRY_NO_ADDRESS || getEntryPageAddress(slot) != entryAddr)
+    {
+      scan->nextPosition++;
+
+      if(readEntry(id, fieldMask, view))
+      {
+        return true;
+      }
+
+      continue;
+    }
+
+    if(scanBufferSize == 0 || entryAddr < scanBufferAddr || entryAddr >= scanBufferAddr + scanBufferSize)
+    {
+      loadScanBuffer(scan);
+    }
+
+    scan->nextPosition++;
+
+    const uint8_t* page = &scanBuffer[entryAddr - scanBufferAddr];
+    bool isRead;
+
+    if(usesEntryLog() && entryLog->isPacked(id))
+    {
+      uint8_t data[ENTRY_PACKED_MAX_SIZE];
+      uint8_t size = entryLog->copyPacked(id, page, data, needsSecret ? ENTRY_PACKED_MAX_SIZE : ENTRY_PACKED_PLAIN_MAX_SIZE);
+      isRead = unpackEntry(id, data, size, needsSecret, view);
+    }
+    else
+    {
+      view->clear();
+      copy_n(page, needsSecret ? MT25Q_PAGE_SIZE : ENTRY_PLAIN_SIZE, view->page);
+      isRead = openEntryPage(id, needsSecret, view);
+    }
+
+    if(isRead)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*
+  void loadScanBuffer(EntryScan*) reads page of next entry of scan and the pages of following entries which fit
+  into the scan buffer with one burst. Stale pages in between are read along, a single long read is still
+  cheaper than a read command per entry.
+*/
+void EntryManager::loadScanBuffer(EntryScan* scan)
+{
+  uint32_t startAddr = get<0>(scan->positions[scan->nextPosition]);
+  uint32_t endAddr = startAddr + MT25Q_PAGE_SIZE;
+
+  for(uint16_t i = scan->nextPosition + 1; i < scan->positions.size(); i++)
+  {
+    uint32_t entryAddr = get<0>(scan->positions[i]);
+
+    if(entryAddr == ENTRY_NO_ADDRESS || entryAddr + MT25Q_PAGE_SIZE > startAddr + ENTRY_SCAN_BUFFER_SIZE)
+    {
+      break;
+    }
+
+    endAddr = entryAddr + MT25Q_PAGE_SIZE;
+  }
+
+  flashMemory->readBurst(startAddr, scanBuffer, endAddr - startAddr);
+  scanBufferAddr = startAddr;
+  scanBufferSize = endAddr - startAddr;
+}
+
+/*
+  bool readPackedEntry(uint16_t, uint8_t, EntryView*) reads packed entry into view, unpacking its fields to the
+  layout of an entry page. Only the unencrypted fields are read unless a secret field is requested.
+
+  Returns true if entry could be unpacked.
+*/
+bool EntryManager::readPackedEntry(uint16_t id, uint8_t fieldMask, EntryView* view)
+{
+  bool needsSecret = (fieldMask & ENTRY_FIELDS_SECRET) != 0;
+
+  uint8_t data[ENTRY_PACKED_MAX_SIZE];
+  uint8_t size = entryLog->readPacked(id, data, needsSecret ? ENTRY_PACKED_MAX_SIZE : ENTRY_PACKED_PLAIN_MAX_SIZE);
+
+  return unpackEntry(id, data, size, needsSecret, view);
+}
+
+/*
+  bool unpackEntry(uint16_t, uint8_t*, uint8_t, bool, EntryView*) unpacks fields of packed entry data to the layout
+  of an entry page in view. Secret fields are only decrypted if needed.
+
+  Returns true if entry could be unpacked.
+*/
+bool EntryManager::unpackEntry(uint16_t id, uint8_t* data, uint8_t size, bool needsSecret, EntryView* view)
+{
+  view->clear();
+  fill_n(view->page, ENTRY_PLAIN_SIZE, 0xFF);
+  view->page[0] = (id & 0xFF00) >> 8;
+  view->page[1] = id & 0xFF;
+
+  uint8_t pos = 0;
+  uint8_t titleLength = size > pos ? data[pos++] : 0xFF;
+  bool isValid = titleLength <= ENTRY_TITLE_SIZE && pos + titleLength < size;
+
+  if(isValid)
+  {
+    copy_n(&data[pos], titleLength, &view->page[ENTRY_TITLE_OFFSET]);
+    pos += titleLength;
+
+    uint8_t urlLength = data[pos++];
+    isValid = urlLength <= ENTRY_URL_SIZE && pos + urlLength <= size;
+
+    if(isValid)
+    {
+      copy_n(&data[pos], urlLength, &view->page[ENTRY_URL_OFFSET]);
+      pos += urlLength;
+    }
+  }
+
+  if(isValid && needsSecret)
+  {
+    uint8_t secretSize = pos < size ? data[pos++] : 0xFF;
+    isValid = secretSize <= ENTRY_PACKED_SECRET_MAX_SIZE && secretSize % 16 == 0 && pos + secretSize <= size;
+
+    if(isValid)
+    {
+      uint8_t secret[ENTRY_PACKED_SECRET_MAX_SIZE];
+      cryptoEngine->cryptWithAesCBC(&data[pos], secret, MBEDTLS_AES_DECRYPT, secretSize);
+
+      // [USERNAME LEN] [USERNAME] [EMAIL LEN] [EMAIL] [PASSWORD LEN] [PASSWORD]
+      const uint8_t fieldOffsets[3] = {ENTRY_USERNAME_OFFSET, ENTRY_EMAIL_OFFSET, ENTRY_PASSWORD_OFFSET};
+      const uint8_t fieldSizes[3] = {ENTRY_USERNAME_SIZE, ENTRY_EMAIL_SIZE, ENTRY_PASSWORD_SIZE};
+      uint8_t secretPos = 0;
+
+      for(uint8_t i = 0; i < 3 && isValid; i++)
+      {
+        uint8_t fieldLength = secretPos < secretSize ? secret[secretPos++] : 0xFF;
+        isValid = fieldLength <= fieldSizes[i] && secretPos + fieldLength <= secretSize;
+
+        if(isValid)
+        {
+          copy_n(&secret[secretPos], fieldLength, &view->page[fieldOffsets[i]]);
+          secretPos += fieldLength;
+        }
+      }
+
+      fill_n(secret, ENTRY_PACKED_SECRET_MAX_SIZE, 0x00);
+    }
+  }
+
+  if(!isValid)
+  {
+    printf("[Error] Packed entry of id %d is damaged!\n", id);
+    view->clear();
+    return false;
+  }
+
+  view->loadedFields = ENTRY_FIELDS_PLAIN | (needsSecret ? ENTRY_FIELDS_SECRET : 0);
+
+  return true;
+}
+
+/*
+  bool editEntry(uint16_t, const char*, const char*, const char*, const char*, const char*) edits entry at given id.
+*/
+bool EntryManager::editEntry(uint16_t id, const char* title, const char* usr, const char* email, const char* pwd, const char* url)
+{
+  WriteLock writeLock(&accessLock);
+
+  if(!beginTransaction())
+  {
+    return false;
+  }
+
+  if(!queueEditEntry(id, title, usr, email, pwd, url))
+  {
+    abortTransaction();
+    return false;
+  }
+
+  return commitTransaction();
+}
+
+/*
+  bool removeEntry(uint16_t) removes entry by deleting id in address table.
+*/
+bool EntryManager::removeEntry(uint16_t id)
+{
+  WriteLock writeLock(&accessLock);
+
+  if(!beginTransaction())
+  {
+    return false;
+  }
+
+  if(!queueRemoveEntry(id))
+  {
+    abortTransaction();
+    return false;
+  }
+
+  return commitTransaction();
+}
+
+/*
+  bool beginTransaction(void) starts a transaction. Add, edit and remove operations queued until
+  commitTransaction() are written together and become durable at once.
+
+  Returns false if a transaction is already open.
+*/
+bool EntryManager::beginTransaction(void)
+{
+  WriteLock writeLock(&accessLock);
+
+  if(transactionOpen)
+  {
+    printf("[Error] Transaction already open!\n");
+    return false;
+  }
+
+  transactionOpen = true;
+  transactionSize = 0;
+
+  return true;
+}
+
+/*
+  int16_t findQueuedOperation(uint16_t) returns index of queued operation on given id, -1 if there is none.
+*/
+int16_t EntryManager::findQueuedOperation(uint16_t id)
+{
+  for(uint8_t i = 0; i < transactionSize; i++)
+  {
+    if(transactionIds[i] == id)
+    {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+/*
+  bool queueAddEntry(const char*, const char*, const char*, const char*, const char*) queues new entry in open
+  transaction. Entry gets the id getUniqueId() returned before, its id and slot stay reserved until commit or abort.
+
+  Returns true if entry was queued.
+*/
+bool EntryManager::queueAddEntry(const char* title, const char* usr, const char* email, const char* pwd, const char* url)
+{
+  WriteLock writeLock(&accessLock);
+
+  if(!transactionOpen || transactionSize == ENTRY_TRANSACTION_MAX_OPERATIONS)
+  {
+    printf("[Error] No open transaction or transaction is full!\n");
+    return false;
+  }
+
+  uint16_t slot = freeSlots.findFirstFree();
+  uint16_t entryId = getUniqueId();
+
+  // Fixed store has a page for the slots of the first address table segment only
+  if(slot == FREE_BITMAP_NONE || entryId == FREE_BITMAP_NONE || (!usesEntryLog() && slot >= FIXED_STORE_MAX_SLOTS))
+  {
+    printf("[Error] Already reached limit of max entries!\n");
+    return false;
+  }
+
+  freeSlots.markUsed(slot);
+  freeIds.markUsed(entryId);
+
+  transactionTypes[transactionSize] = ENTRY_OPERATION_ADD;
+  transactionIds[transactionSize] = entryId;
+  transactionSlots[transactionSize] = slot;
+  buildTransactionEntry(transactionSize, entryId, title, usr, email, pwd, url);
+  transactionSize++;
+
+  return true;
+}
+
+/*
+  bool queueEditEntry(uint16_t, const char*, const char*, const char*, const char*, const char*) queues edit of
+  entry with given id in open transaction. Entries added in the same transaction can be edited as well.
+
+  Returns true if edit was queued.
+*/
+bool EntryManager::queueEditEntry(uint16_t id, const char* title, const char* usr, const char* email, const char* pwd, const char* url)
+{
+  WriteLock writeLock(&accessLock);
+
+  if(!transactionOpen)
+  {
+    printf("[Error] No open transaction!\n");
+    return false;
+  }
+
+  int16_t queued = findQueuedOperation(id);
+
+  if(queued >= 0 && transactionTypes[queued] != ENTRY_OPERATION_REMOVE)
+  {
+    buildTransactionEntry(queued, id, title, usr, email, pwd, url);
+    return true;
+  }
+
+  uint16_t slot = slotIndex.getSlotOfId(id);
+
+  if(slot == ENTRY_SLOT_UNUSED || queued >= 0)
+  {
+    printf("[Error] Entry with given id does not exist!\n");
+    return false;
+  }
+
+  if(transactionSize == ENTRY_TRANSACTION_MAX_OPERATIONS)
+  {
+    printf("[Error] Transaction is full!\n");
+    return false;
+  }
+
+  transactionTypes[transactionSize] = ENTRY_OPERATION_EDIT;
+  transactionIds[transactionSize] = id;
+  transactionSlots[transactionSize] = slot;
+  buildTransactionEntry(transactionSize, id, title, usr, email, pwd, url);
+  transactionSize++;
+
+  return true;
+}
+
+/*
+  bool queueRemoveEntry(uint16_t) queues removal of entry with given id in open transaction.
+
+  Returns true if removal was queued.
+*/
+bool EntryManager::queueRemoveEntry(uint16_t id)
+{
+  WriteLock writeLock(&accessLock);
+
+  if(!transactionOpen)
+  {
+    printf("[Error] No open transaction!\n");
+    return false;
+  }
+
+  int16_t queued = findQueuedOperation(id);
+
+  if(queued >= 0 && transactionTypes[queued] == ENTRY_OPERATION_ADD)
+  {
+    // Entry never reached flash, just give back its id and slot
+    freeIds.markFree(id);
+    freeSlots.markFree(transactionSlots[queued]);
+
+    for(uint8_t i = queued; i + 1 < transactionSize; i++)
+    {
+      transactionTypes[i] = transactionTypes[i + 1];
+      transactionIds[i] = transactionIds[i + 1];
+      transactionSlots[i] = transactionSlots[i + 1];
+      transactionSizes[i] = transactionSizes[i + 1];
+      copy_n(transactionPages[i + 1], MT25Q_PAGE_SIZE, transactionPages[i]);
+    }
+    transactionSize--;
+
+    return true;
+  }
+
+  if(queued >= 0 && transactionTypes[queued] == ENTRY_OPERATION_EDIT)
+  {
+    transactionTypes[queued] = ENTRY_OPERATION_REMOVE;
+    return true;
+  }
+
+  uint16_t slot = slotIndex.getSlotOfId(id);
+
+  if(slot == ENTRY_SLOT_UNUSED || queued >= 0)
+  {
+    printf("[Error] Entry with given id does not exist!\n");
+    return false;
+  }
+
+  if(transactionSize == ENTRY_TRANSACTION_MAX_OPERATIONS)
+  {
+    printf("[Error] Transaction is full!\n");
+    return false;
+  }
+
+  transactionTypes[transactionSize] = ENTRY_OPERATION_REMOVE;
+  transactionIds[transactionSize] = id;
+  transactionSlots[transactionSize] = slot;
+  transactionSize++;
+
+  return true;
+}
+
+/*
+  void abortTransaction(void) drops all queued operations and gives back reserved ids and slots. An open bulk
+  import gets closed as well.
+*/
+void EntryManager::abortTransaction(void)
+{
+  WriteLock writeLock(&accessLock);
 
-  reloadSettings();
+  for(uint8_t i = 0; i < transactionSize; i++)
+  {
+    if(transactionTypes[i] == ENTRY_OPERATION_ADD)
+    {
+      freeIds.markFree(transactionIds[i]);
+      freeSlots.markFree(transactionSlots[i]);
+    }
+  }
+
+  transactionOpen = false;
+  transactionSize = 0;
+  importOpen = false;
 }
 
 /*
-  void reloadSettings(void) reads settings from memory.
+  bool commitToEntryLog(void) appends entry pages (or packed entries) of transaction to EntryLog and makes them
+  durable with one commit record, which also holds the address table changes.
 */
-void EntryManager::reloadSettings(void)
+bool EntryManager::commitToEntryLog(void)
 {
-  flashMemory->readBytes(DEVICE_SETTINGS_START_ADDRESS, deviceSettings, MT25Q_PAGE_SIZE);
-  flashMemory->readBytes(ADDRESS_TABLE_START_ADDRESS, addressTable, MT25Q_SUBSECTOR_SIZE);
-
-  usedIds.clear();
+  uint16_t slots[ENTRY_TRANSACTION_MAX_OPERATIONS];
+  uint16_t ids[ENTRY_TRANSACTION_MAX_OPERATIONS];
+  uint8_t tableChanges = 0;
+  uint16_t pageCount = 1;
 
-  for(auto i = 0; i < MAX_ENTRY_COUNT; i++)
+  for(uint8_t i = 0; i < transactionSize; i++)
   {
-    uint16_t foundId = (addressTable[i * 2] << 8) | addressTable[(i * 2) + 1];
+    pageCount += transactionTypes[i] != ENTRY_OPERATION_REMOVE ? 1 : 0;
 
-    if(foundId != 0xFFFF)
+    if(transactionTypes[i] != ENTRY_OPERATION_EDIT)
     {
-      usedIds.push_back(foundId);
+      slots[tableChanges] = transactionSlots[i];
+      ids[tableChanges] = transactionTypes[i] == ENTRY_OPERATION_ADD ? transactionIds[i] : ENTRY_SLOT_UNUSED;
+      tableChanges++;
     }
   }
-  
-  if(getEntryCount() == 0xFFFF)
+
+  if(!entryLog->reserve(pageCount))
   {
-    setEntryCount(0x00);
+    return false;
   }
-}
 
-/*
-  uint16_t getEntryCount(void) returns current entry count from device settings.
-*/
-uint16_t EntryManager::getEntryCount(void)
-{
-  return (deviceSettings[1] << 8) | deviceSettings[2];
-}
+  for(uint8_t i = 0; i < transactionSize; i++)
+  {
+    if(transactionTypes[i] == ENTRY_OPERATION_REMOVE)
+    {
+      continue;
+    }
 
-/*
-  void setEntryCount(uint16_t) sets new entry count.
-*/
-void EntryManager::setEntryCount(uint16_t entryCount)
-{
-  deviceSettings[1] = (entryCount & 0xFF00) >> 8;
-  deviceSettings[2] = entryCount & 0xFF;
-}
+    bool isAppended = usesPackedEntries() ?
+      entryLog->appendPacked(transactionIds[i], transactionPages[i], transactionSizes[i]) :
+      entryLog->appendPage(transactionIds[i], transactionPages[i]);
 
-/*
-  uint8_t getStringLength(const char*, uint8_t) returns length of a string (ending with '\0').
-  If string is longer than maxLength, value of maxLength will be returned.
-*/
-uint8_t EntryManager::getStringLength(const char* str, uint8_t maxLength)
-{
-  int length = 0;
-  while((str[length] != '\0' || str[length] != 0xFF) && length < maxLength)
+    if(!isAppended)
+    {
+      entryLog->abortBatch();
+      return false;
+    }
+  }
+
+  if(!entryLog->commitBatch(slots, ids, tableChanges))
   {
-    length++;
+    entryLog->abortBatch();
+    return false;
   }
 
-  return length;
+  return true;
 }
 
 /*
-  void saveSettings(void) writes Device Settings and Address Table to memory.
+  bool commitToFixedSlots(void) writes entry pages of transaction to their slot pages, grouped by subsector,
+  followed by address table. Only address table is written atomically, edited pages are overwritten in place.
 */
-void EntryManager::saveSettings(void)
+bool EntryManager::commitToFixedSlots(void)
 {
-  flashMemory->updateBytes(DEVICE_SETTINGS_START_ADDRESS, deviceSettings);
-
-  for(auto i = 0; i < MT25Q_SUBSECTOR_SIZE / MT25Q_PAGE_SIZE; i++)
+  for(uint8_t i = 0; i < transactionSize; i++)
   {
-    flashMemory->updateBytes(ADDRESS_TABLE_START_ADDRESS + (i << 8), &addressTable[i << 8]);
+    if(transactionTypes[i] != ENTRY_OPERATION_REMOVE)
+    {
+      flashMemory->updateBytes(ENTRY_START_ADDRESS + (transactionSlots[i] << 8), transactionPages[i]);
+    }
   }
+
+  flashMemory->commit();
+
+  return true;
 }
 
 /*
-  bool addEntry(const char*, const char*, const char*, const char*, const char*) adds entry to next free slot in
-  address table and stores it in the corresponding address on the flash.
+  bool commitTransaction(void) writes all queued operations of open transaction and closes it.
+  If writing fails, transaction is aborted and no operation takes effect.
 
-  Returns true if entry has been added.
+  Returns true if transaction was committed.
 */
-bool EntryManager::addEntry(const char* title, const char* usr, const char* email, const char* pwd, const char* url)
+bool EntryManager::commitTransaction(void)
 {
-  if(getEntryCount() == MAX_ENTRY_COUNT)
+  WriteLock writeLock(&accessLock);
+
+  if(!transactionOpen)
   {
-    printf("[Error] Already reached limit of max entries!\n");
+    printf("[Error] No open transaction!\n");
     return false;
   }
 
-  uint8_t tmpPage[MT25Q_PAGE_SIZE];
-  memset(tmpPage, 0xFF, MT25Q_PAGE_SIZE);
+  scanBufferSize = 0;
 
-  uint32_t entryAddress = ENTRY_START_ADDRESS;
-  uint32_t addrTablePage = 0;
+  for(uint8_t i = 0; i < transactionSize; i++)
+  {
+    if(transactionTypes[i] != ENTRY_OPERATION_ADD)
+    {
+      entryCache->remove(transactionIds[i]);
+    }
+  }
 
-  for(auto i = 0; i < MAX_ENTRY_COUNT; i++)
+  if(!(usesEntryLog() ? commitToEntryLog() : commitToFixedSlots()))
   {
-    uint16_t foundId = (addressTable[i * 2] << 8) | addressTable[(i * 2) + 1];
+    printf("[Error] Transaction could not be committed!\n");
+    abortTransaction();
+    return false;
+  }
 
-    if(foundId == 0xFFFF)
+  for(uint8_t i = 0; i < transactionSize; i++)
+  {
+    if(transactionTypes[i] == ENTRY_OPERATION_ADD)
     {
-      uint16_t entryId = getUniqueId();
-      usedIds.push_back(entryId);
-      addressTable[i * 2] = tmpPage[0] = (entryId & 0xFF00) >> 8;
-      addressTable[(i * 2) + 1] = tmpPage[1] = entryId & 0xFF;
-      entryAddress = ENTRY_START_ADDRESS + MT25Q_PAGE_SIZE * i;
-      addrTablePage = i / (MT25Q_PAGE_SIZE / 2);
+      setIdAtSlot(transactionSlots[i], transactionIds[i]);
       setEntryCount(getEntryCount() + 1);
-      break;
+    }
+    else if(transactionTypes[i] == ENTRY_OPERATION_REMOVE)
+    {
+      setIdAtSlot(transactionSlots[i], ENTRY_SLOT_UNUSED);
+      setEntryCount(getEntryCount() - 1);
+
+      if(usesEntryLog())
+      {
+        entryLog->tombstone(transactionIds[i]);
+      }
+
+      // Id may be taken by a new entry
+      usageLog->reset(transactionIds[i]);
     }
   }
 
-  /*
-    Entries are saved in 256 byte pages in following format:
+  // EntryLog commit records hold address table changes until next saveSettings()
+  if(!usesEntryLog())
+  {
+    writeAddressTable();
+  }
 
-    [ID 2 bytes] [TITLE 16 bytes] [URL 24 bytes] [Not Defined 86 bytes] (First 128 bytes - unencrypted)
-    [USERNAME 32 bytes] [EMAIL 64 bytes] [PASSWORD 32 bytes]            (Last 128 bytes - encrypted with AES)
-  */
+  tombstoneMetadataRecords();
+  writeMetadataRecords();
 
-  // [TITLE 16 bytes]
-  copy_n(title, getStringLength(title, ENTRY_TITLE_SIZE), &tmpPage[2]);
+  if(searchIndexValid)
+  {
+    for(uint8_t i = 0; i < transactionSize; i++)
+    {
+      if(transactionTypes[i] != ENTRY_OPERATION_ADD)
+      {
+        searchIndex->remove(transactionIds[i]);
+      }
+
+      if(transactionTypes[i] != ENTRY_OPERATION_REMOVE)
+      {
+        uint8_t record[METADATA_RECORD_SIZE];
+        buildMetadataRecord(i, record);
+        insertSearchKeys(transactionIds[i], record);
+      }
+    }
+  }
 
-  // [URL 24 bytes]
-  copy_n(url, getStringLength(url, ENTRY_URL_SIZE), &tmpPage[2 + ENTRY_TITLE_SIZE]);
+  // Readers keep their snapshot of the list, the changed copy replaces it at once
+  vector<uint16_t> nextCredentialInfo(*credentialInfo.read());
 
-  // [USERNAME 32 bytes]
-  copy_n(usr, getStringLength(usr, ENTRY_USERNAME_SIZE), &tmpPage[128]);
+  for(uint8_t i = 0; i < transactionSize; i++)
+  {
+    updateCredentialInfo(i, nextCredentialInfo);
+  }
 
-  // [EMAIL 64 bytes]
-  copy_n(email, getStringLength(email, ENTRY_EMAIL_SIZE), &tmpPage[128 + ENTRY_USERNAME_SIZE]);
+  credentialInfo.publish(move(nextCredentialInfo));
 
-  // [PASSWORD 32 bytes]
-  copy_n(pwd, getStringLength(pwd, ENTRY_PASSWORD_SIZE), &tmpPage[128 + ENTRY_USERNAME_SIZE + ENTRY_EMAIL_SIZE]);
+  transactionOpen = false;
+  transactionSize = 0;
 
-  uint8_t encData[128];
-  cryptoEngine->cryptWithAesCBC(&tmpPage[128], encData, MBEDTLS_AES_ENCRYPT);
+  return true;
+}
+
+/*
+  bool beginImport(void) starts a bulk import. Entries passed to importEntry() are queued in RAM and written
+  in transactions of ENTRY_TRANSACTION_MAX_OPERATIONS entries. Added entries take the lowest free slots, so a
+  full transaction fills one subsector of slot pages (or appends one run of log records) at once.
+
+  Returns false if a transaction or import is already open.
+*/
+bool EntryManager::beginImport(void)
+{
+  WriteLock writeLock(&accessLock);
 
-  // Write encrypted Data (128 bytes) back to tmpPage
-  copy_n(encData, 128, &tmpPage[128]);
+  if(!beginTransaction())
+  {
+    return false;
+  }
 
-  flashMemory->updateBytes(entryAddress, tmpPage);
-  flashMemory->updateBytes(ADDRESS_TABLE_START_ADDRESS + addrTablePage, &addressTable[addrTablePage]);
+  importOpen = true;
 
   return true;
 }
 
 /*
-  bool getEntry(uint16_t, char*, char*, char*, char*, char*) gets information of entry via its id.
+  bool importEntry(const char*, const char*, const char*, const char*, const char*) queues entry of open bulk
+  import. Once the current transaction is full it gets committed before the entry is queued in a new one.
+  If committing fails the import is closed, entries of earlier transactions stay stored.
 
-  Returns true if entry was found.
+  Returns true if entry was queued.
 */
-bool EntryManager::getEntry(uint16_t id, uint8_t *title, uint8_t *usr, uint8_t *email, uint8_t *pwd, uint8_t *url)
+bool EntryManager::importEntry(const char* title, const char* usr, const char* email, const char* pwd, const char* url)
 {
-  if(getEntryCount() == 0)
+  WriteLock writeLock(&accessLock);
+
+  if(!importOpen)
   {
-    printf("[Error] No entry found!\n");
+    printf("[Error] No open import!\n");
     return false;
   }
 
-  bool entryFound = false;
-  uint32_t entryAddr = ENTRY_START_ADDRESS;
-  for(auto i = 0; i < MAX_ENTRY_COUNT; i++)
+  if(transactionSize == ENTRY_TRANSACTION_MAX_OPERATIONS)
   {
-    uint16_t foundId = (addressTable[i * 2] << 8) | addressTable[(i * 2) + 1];
+    if(!commitTransaction())
+    {
+      return false;
+    }
 
-    if(foundId == id)
+    // Do not let commit records pile up, maintenance thread is locked out while import is open
+    if(usesEntryLog() && entryLog->getPendingCommitCount() >= ENTRY_LOG_CHECKPOINT_INTERVAL)
     {
-      entryAddr = ENTRY_START_ADDRESS + (i << 8);
-      entryFound = true;
-      break;
+      saveSettings();
     }
-  }
 
-  if(!entryFound)
-  {
-    printf("[Error] Entry with given id does not exist!\n");
-    return false;
+    beginTransaction();
   }
 
-  uint8_t tmpPage[256];
-  flashMemory->readBytes(entryAddr, tmpPage, MT25Q_PAGE_SIZE);
+  return queueAddEntry(title, usr, email, pwd, url);
+}
+
+/*
+  bool finishImport(void) commits remaining entries of open bulk import, closes it and saves settings.
+
+  Returns false if there was no open import or remaining entries could not be committed.
+*/
+bool EntryManager::finishImport(void)
+{
+  WriteLock writeLock(&accessLock);
 
-  if(((tmpPage[0] << 8) | tmpPage[1]) != id)
+  if(!importOpen)
   {
-    printf("[Error] Found entry was saved with the wrong id! Id was: %d\n", (tmpPage[0] << 8) | tmpPage[1]);
+    printf("[Error] No open import!\n");
     return false;
   }
 
-  if(title != NULL)
-  {
-    // [TITLE 16 bytes]
-    copy_n(&tmpPage[2], getStringLength((char*)&tmpPage[2], ENTRY_TITLE_SIZE), title);
-  }
+  importOpen = false;
+  bool isCommitted = commitTransaction();
+  saveSettings();
 
-  if(url != NULL)
-  {
-    // [URL 24 bytes]
-    copy_n(&tmpPage[2 + ENTRY_TITLE_SIZE], getStringLength((char*)&tmpPage[2 + ENTRY_TITLE_SIZE], ENTRY_URL_SIZE), url);
-  }
+  return isCommitted;
+}
 
-  uint8_t encData[128];
+/*
+  bool isImportOpen(void) returns true while a bulk import is open.
+*/
+bool EntryManager::isImportOpen(void)
+{
+  ReadLock readLock(&accessLock);
+  return importOpen;
+}
+
+/*
+  uint16_t getUniqueId(void) returns lowest unused id. This is the id the next added entry will get.
 
-  // Get encrypted data from entry page
-  copy_n(&tmpPage[128], 128, encData);
+  Returns FREE_BITMAP_NONE if all ids are in use.
+*/
+uint16_t EntryManager::getUniqueId(void)
+{
+  ReadLock readLock(&accessLock);
+  return freeIds.findFirstFree();
+}
 
-  // Decrypt data and write it back to tmpPage
-  cryptoEngine->cryptWithAesCBC(encData, &tmpPage[128], MBEDTLS_AES_DECRYPT);
+/*
+  void loadCredentialInfo(void) publishes ids of all saved entries as credentialInfo, most used entries first
+  (see isRankedBefore()). Afterwards it is kept up to date by commitTransaction(), one item per added or removed
+  entry, and by recordUse().
 
-  if(usr != NULL)
+  Titles are not kept in RAM, the credential list reads the few it draws with readEntry(). So the list costs
+  2 bytes per entry and is built from the id index without reading flash.
+*/
+void EntryManager::loadCredentialInfo(void)
+{
+  vector<uint16_t> info;
+
+  if(!needsToBeInitialized())
   {
-    // [USERNAME 32 bytes]
-    copy_n(&tmpPage[128], getStringLength((char*)&tmpPage[128], ENTRY_USERNAME_SIZE), usr);
+    info.reserve(getEntryCount());
+
+    for(uint16_t id = 0; id < MAX_ENTRY_COUNT; id++)
+    {
+      if(slotIndex.getSlotOfId(id) != ENTRY_SLOT_UNUSED)
+      {
+        info.push_back(id);
+      }
+    }
+
+    sort(info.begin(), info.end(), [this](uint16_t listed, uint16_t other) { return isRankedBefore(listed, other); });
   }
 
-  if(email != NULL)
+  fill_n(credentialRanks, MAX_ENTRY_COUNT, ENTRY_SLOT_UNUSED);
+  setCredentialRanks(info, 0, info.size());
+  credentialInfo.publish(move(info));
+}
+
+/*
+  void updateCredentialInfo(uint8_t, vector<uint16_t>&) applies operation at given index of committed
+  transaction to credential list. Only the changed item is inserted at its rank or erased, edited entries keep
+  their place. Items are found through credentialRanks instead of a search.
+*/
+void EntryManager::updateCredentialInfo(uint8_t index, vector<uint16_t>& info)
+{
+  uint16_t id = transactionIds[index];
+  uint16_t rank = credentialRanks[id];
+
+  if(transactionTypes[index] == ENTRY_OPERATION_REMOVE)
   {
-    // [EMAIL 64 bytes]
-    copy_n(
-      &tmpPage[128 + ENTRY_USERNAME_SIZE], 
-      getStringLength((const char*)&tmpPage[128 + ENTRY_USERNAME_SIZE], ENTRY_EMAIL_SIZE), 
-      email);
+    if(rank != ENTRY_SLOT_UNUSED)
+    {
+      info.erase(info.begin() + rank);
+      credentialRanks[id] = ENTRY_SLOT_UNUSED;
+      setCredentialRanks(info, rank, info.size());
+    }
+    return;
   }
 
-  if(pwd != NULL)
+  if(rank == ENTRY_SLOT_UNUSED)
   {
-    // [PASSWORD 32 bytes]
-    copy_n(
-      &tmpPage[128 + ENTRY_USERNAME_SIZE + ENTRY_EMAIL_SIZE], 
-      getStringLength((char*)&tmpPage[128 + ENTRY_USERNAME_SIZE + ENTRY_EMAIL_SIZE], 
-      ENTRY_PASSWORD_SIZE), pwd);
+    auto item = lower_bound(info.begin(), info.end(), id,
+      [this](uint16_t listed, uint16_t id) { return isRankedBefore(listed, id); });
+    rank = item - info.begin();
+    info.insert(item, id);
+    setCredentialRanks(info, rank, info.size());
   }
-  return true;
 }
 
 /*
-  bool editEntry(uint16_t, const char*, const char*, const char*, const char*, const char*) edits entry at given id.
+  void setCredentialRanks(const vector<uint16_t>&, uint16_t, uint16_t) updates credentialRanks of items in
+  given range of credential list after they moved.
 */
-bool EntryManager::editEntry(uint16_t id, const char* title, const char* usr, const char* email, const char* pwd, const char* url)
+void EntryManager::setCredentialRanks(const vector<uint16_t>& info, uint16_t first, uint16_t last)
 {
-  if(getEntryCount() == 0)
+  for(uint16_t rank = first; rank < last; rank++)
   {
-    printf("[Error] No entry found!\n");
-    return false;
+    credentialRanks[info[rank]] = rank;
   }
+}
 
-  uint8_t tmpPage[MT25Q_PAGE_SIZE];
-  memset(tmpPage, 0xFF, MT25Q_PAGE_SIZE);
-
-  uint32_t entryAddress = ENTRY_START_ADDRESS;
-  bool entryFound = false;
-  for(auto i = 0; i < MAX_ENTRY_COUNT; i++)
-  {
-    uint16_t foundId = (addressTable[i * 2] << 8) | addressTable[(i * 2) + 1];
+/*
+  bool isRankedBefore(uint16_t, uint16_t) returns true if entry with given id is listed in front of the other
+  one: more used entries come first, entries used equally often are ordered by id.
+*/
+bool EntryManager::isRankedBefore(uint16_t id, uint16_t otherId)
+{
+  uint16_t useCount = usageLog->getCount(id);
+  uint16_t otherUseCount = usageLog->getCount(otherId);
 
-    if(foundId == id)
-    {
-      entryAddress = ENTRY_START_ADDRESS + MT25Q_PAGE_SIZE * i;
-      tmpPage[0] = (id & 0xFF00) >> 8;
-      tmpPage[1] = id & 0xFF;
-      entryFound = true;
-      break;
-    }
-  }
+  return useCount > otherUseCount || (useCount == otherUseCount && id < otherId);
+}
 
-  if(!entryFound)
-  {
-    printf("[Error] Entry with given id does not exist!\n");
-    return false;
-  }
+/*
+  void forEachEntryRecord(function<void(uint16_t, const uint8_t*)>) passes id and title/URL record
+  ([ID] [TITLE] [URL]) of every saved entry to visit.
 
-  /*
-    Entries are saved in 256 byte pages in following format:
+  Records are read in bursts from the title/URL index instead of the entry pages, so no entry gets decrypted.
+  Index records which do not match the address table (e.g. vault written by older firmware) are rebuilt from
+  the plaintext half of the entry page.
+*/
+void EntryManager::forEachEntryRecord(function<void(uint16_t, const uint8_t*)> visit)
+{
+  const uint16_t recordsPerChunk = METADATA_READ_CHUNK_SIZE / METADATA_RECORD_SIZE;
+  const uint16_t slotRange = getUsedSlotRange();
 
-    [ID 2 bytes] [TITLE 16 bytes] [URL 24 bytes] [Not Defined 86 bytes] (First 128 bytes - unencrypted)
-    [USERNAME 32 bytes] [EMAIL 64 bytes] [PASSWORD 32 bytes]            (Last 128 bytes - encrypted with AES)
-  */
+  // Chunks never cross the end of a segment's index, which holds a whole number of chunks
+  for(uint16_t chunkStart = 0; chunkStart < slotRange; chunkStart += recordsPerChunk)
+  {
+    uint16_t chunkRecords = min<uint16_t>(recordsPerChunk, slotRange - chunkStart);
+    uint32_t chunkAddr = getMetadataAddress(chunkStart);
 
-  // [TITLE 16 bytes]
-  copy_n(title, getStringLength(title, ENTRY_TITLE_SIZE), &tmpPage[2]);
+    // Always read whole pages, so repaired pages can be written back from buffer
+    uint16_t chunkSize = (chunkRecords * METADATA_RECORD_SIZE + MT25Q_PAGE_SIZE - 1) & 0xFF00;
+    systemStorage->readBytes(chunkAddr, metadataBuffer, chunkSize);
 
-  // [URL 24 bytes]
-  copy_n(url, getStringLength(url, ENTRY_URL_SIZE), &tmpPage[2 + ENTRY_TITLE_SIZE]);
+    uint8_t dirtyPages = 0;
 
-  // [USERNAME 32 bytes]
-  copy_n(usr, getStringLength(usr, ENTRY_USERNAME_SIZE), &tmpPage[128]);
+    for(uint16_t i = 0; i < chunkRecords; i++)
+    {
+      uint16_t slot = chunkStart + i;
+      uint16_t foundId = slotIndex.getIdAtSlot(slot);
 
-  // [EMAIL 64 bytes]
-  copy_n(email, getStringLength(email, ENTRY_EMAIL_SIZE), &tmpPage[128 + ENTRY_USERNAME_SIZE]);
+      if(foundId == ENTRY_SLOT_UNUSED)
+      {
+        continue;
+      }
 
-  // [PASSWORD 32 bytes]
-  copy_n(pwd, getStringLength(pwd, ENTRY_PASSWORD_SIZE), &tmpPage[128 + ENTRY_USERNAME_SIZE + ENTRY_EMAIL_SIZE]);
+      uint8_t* record = &metadataBuffer[i * METADATA_RECORD_SIZE];
 
-  uint8_t encData[128];
-  cryptoEngine->cryptWithAesCBC(&tmpPage[128], encData, MBEDTLS_AES_ENCRYPT);
+      if(((record[0] << 8) | record[1]) != foundId)
+      {
+        EntryView entry;
+        if(!readEntry(foundId, ENTRY_FIELDS_PLAIN, &entry))
+        {
+          continue;
+        }
 
-  // Write encrypted Data (128 bytes) back to tmpPage
-  copy_n(encData, 128, &tmpPage[128]);
+        copy_n(entry.page, METADATA_RECORD_SIZE, record);
+        dirtyPages |= 1 << ((i * METADATA_RECORD_SIZE) >> 8);
+      }
 
-  flashMemory->updateBytes(entryAddress, tmpPage);
+      visit(foundId, record);
+    }
 
-  return true;
+    for(uint16_t page = 0; page < chunkSize / MT25Q_PAGE_SIZE; page++)
+    {
+      if(dirtyPages & (1 << page))
+      {
+        systemStorage->updateBytes(chunkAddr + (page << 8), &metadataBuffer[page << 8]);
+      }
+    }
+  }
 }
 
 /*
-  bool removeEntry(uint16_t) removes entry by deleting id in address table.
+  vector<uint16_t> findEntries(uint8_t, const char*, uint8_t) returns ids of entries whose title starts with query
+  (field ENTRY_FIELD_TITLE, case insensitive) or whose URL has the same domain as query (field ENTRY_FIELD_URL,
+  see SearchIndex::normalizeDomain()).
+
+  Lookup uses the RAM search index, which is built on first use and kept up to date by commitTransaction().
+  Only the plaintext part of candidate entries is read, nothing gets decrypted.
 */
-bool EntryManager::removeEntry(uint16_t id)
+vector<uint16_t> EntryManager::findEntries(uint8_t field, const char* query, uint8_t queryLength)
 {
-  if(getEntryCount() == 0)
+  if(field != ENTRY_FIELD_TITLE && field != ENTRY_FIELD_URL)
   {
-    printf("[Error] No entry found!\n");
-    return false;
+    return vector<uint16_t>();
   }
 
-  bool idFound = false;
-  for(auto i = 0; i < MAX_ENTRY_COUNT; i++)
   {
-    uint16_t foundId = (addressTable[i * 2] << 8) | addressTable[(i * 2) + 1];
+    ReadLock readLock(&accessLock);
 
-    if(foundId == id)
+    if(searchIndexValid)
     {
-      addressTable[i * 2] = 0xFF;
-      addressTable[(i * 2) + 1] = 0xFF;
-      usedIds.erase(find(usedIds.begin(), usedIds.end(), foundId));
-      idFound = true;
-      break;
+      return searchEntries(field, query, queryLength);
     }
   }
 
-  if(!idFound)
+  // Index is built once under exclusive lock, searched under the same lock so no writer can drop it in between
+  WriteLock writeLock(&accessLock);
+
+  if(!searchIndexValid)
   {
-    printf("[Error] Entry with given id does not exist!\n");
-    return false;
+    rebuildSearchIndex();
   }
 
-  setEntryCount(getEntryCount() - 1);
-
-  return true;
+  return searchEntries(field, query, queryLength);
 }
 
 /*
-  uint16_t getUniqueId(void) returns an unused id.
+  vector<uint16_t> searchEntries(uint8_t, const char*, uint8_t) looks query up in the valid search index, see
+  findEntries(). Access lock must be held.
 */
-uint16_t EntryManager::getUniqueId(void)
+vector<uint16_t> EntryManager::searchEntries(uint8_t field, const char* query, uint8_t queryLength)
 {
-  uint16_t id = 0;
-  while(find(usedIds.begin(), usedIds.end(), id) != usedIds.end())
+  vector<uint16_t> foundIds;
+  char domain[UINT8_MAX];
+  vector<uint16_t> candidates;
+  bool isExact = false;
+
+  if(field == ENTRY_FIELD_TITLE)
+  {
+    queryLength = min<uint8_t>(queryLength, ENTRY_TITLE_SIZE);
+    isExact = searchIndex->findTitlePrefix(query, queryLength, candidates);
+  }
+  else
+  {
+    queryLength = SearchIndex::normalizeDomain(query, queryLength, domain);
+    if(queryLength == 0)
+    {
+      return foundIds;
+    }
+
+    searchIndex->findDomain(domain, queryLength, candidates);
+  }
+
+  for(auto id : candidates)
   {
-    id++;
+    if(isExact)
+    {
+      foundIds.push_back(id);
+      continue;
+    }
+
+    EntryView entry;
+    if(!readEntry(id, ENTRY_FIELDS_PLAIN, &entry))
+    {
+      continue;
+    }
+
+    bool isMatch;
+    if(field == ENTRY_FIELD_TITLE)
+    {
+      isMatch = SearchIndex::matchesTitlePrefix(entry.getField(field), entry.getFieldLength(field), query, queryLength);
+    }
+    else
+    {
+      char entryDomain[UINT8_MAX];
+      uint8_t entryDomainLength = SearchIndex::normalizeDomain(entry.getField(field), entry.getFieldLength(field), entryDomain);
+      isMatch = entryDomainLength == queryLength && equal(domain, domain + queryLength, entryDomain);
+    }
+
+    if(isMatch)
+    {
+      foundIds.push_back(id);
+    }
   }
 
-  return id;
+  return foundIds;
 }
 
 /*
-  vector<string> getEntriesTitleInfo(void) returns all saved entry titles.
+  void rebuildSearchIndex(void) builds search index from title/URL records of all entries.
 */
-vector<tuple<uint16_t, string>> EntryManager::getEntriesTitleInfo(void)
+void EntryManager::rebuildSearchIndex(void)
 {
-  vector<tuple<uint16_t, string>> entriesTitleInfo;
-  
-  for(auto i = 0; i < MAX_ENTRY_COUNT; i++)
+  searchIndex->clear();
+
+  forEachEntryRecord([this](uint16_t id, const uint8_t* record)
   {
-    uint16_t foundId = (addressTable[i * 2] << 8) | addressTable[(i * 2) + 1];
+    insertSearchKeys(id, record);
+  });
 
-    if(foundId != 0xFFFF)
-    {
-      uint8_t title[ENTRY_TITLE_SIZE];
-      getEntry(foundId, title, NULL, NULL, NULL, NULL);
+  searchIndexValid = true;
+}
 
-      entriesTitleInfo.push_back(tuple<uint16_t, string>(foundId, string((char*)title)));
-    }
-  }
+/*
+  void insertSearchKeys(uint16_t, const uint8_t*) adds title and URL of given title/URL record to search index.
+*/
+void EntryManager::insertSearchKeys(uint16_t id, const uint8_t* record)
+{
+  const char* title = (const char*)&record[ENTRY_TITLE_OFFSET];
+  const char* url = (const char*)&record[ENTRY_URL_OFFSET];
 
-  return entriesTitleInfo;
+  searchIndex->insert(id, title, getFieldLength(&record[ENTRY_TITLE_OFFSET], ENTRY_TITLE_SIZE),
+    url, getFieldLength(&record[ENTRY_URL_OFFSET], ENTRY_URL_SIZE));
 }
 
 /*
@@ -394,6 +2425,8 @@ vector<tuple<uint16_t, string>> EntryManager::getEntriesTitleInfo(void)
 */
 void EntryManager::saveSalt(uint8_t *salt)
 {
+  WriteLock writeLock(&accessLock);
+
   // Copy salt to device settings
   copy_n(salt, MAX_SALT_LENGTH, &deviceSettings[SALT_START_ADDRESS]);
 }
@@ -403,6 +2436,8 @@ void EntryManager::saveSalt(uint8_t *salt)
 */
 void EntryManager::loadSalt(void)
 {
+  WriteLock writeLock(&accessLock);
+
   uint8_t salt[MAX_SALT_LENGTH];
   copy_n(&deviceSettings[SALT_START_ADDRESS], MAX_SALT_LENGTH, salt);
   cryptoEngine->setSalt(salt);
@@ -413,6 +2448,7 @@ void EntryManager::loadSalt(void)
 */
 bool EntryManager::needsToBeInitialized(void)
 {
+  ReadLock readLock(&accessLock);
   return deviceSettings[0] != 0x01 ? true : false;
 }
 
@@ -421,6 +2457,8 @@ bool EntryManager::needsToBeInitialized(void)
 */
 void EntryManager::savePassword(uint8_t *pwd)
 {
+  WriteLock writeLock(&accessLock);
+
   uint8_t hashedPwd[32];
   cryptoEngine->hashWithSha256(pwd, hashedPwd);
 
@@ -436,6 +2474,8 @@ void EntryManager::savePassword(uint8_t *pwd)
 */
 bool EntryManager::comparePassword(uint8_t *pwd)
 {
+  ReadLock readLock(&accessLock);
+
   uint8_t hashedPwd[32];
   cryptoEngine->hashWithSha256(pwd, hashedPwd);
 
@@ -451,9 +2491,17 @@ bool EntryManager::comparePassword(uint8_t *pwd)
 
 /*
   void setAsInitialized(void) sets first byte of device settings page to 0x01 which means that device
-  was initialized.
+  was initialized. Newly initialized devices use ENTRY_STORE_DEFAULT as entry store format.
 */
 void EntryManager::setAsInitialized(void)
 {
+  WriteLock writeLock(&accessLock);
+
   deviceSettings[0] = 0x01;
+  deviceSettings[STORE_FORMAT_ADDRESS] = ENTRY_STORE_DEFAULT;
+
+  if(usesEntryLog())
+  {
+    mountEntryLog();
+  }
 }
\ No newline at end of file
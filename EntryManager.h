@@ -1,5 +1,11 @@
 #include "MT25Q.h"
 #include "CryptoEngine.h"
+#include "FreeBitmap.h"
+#include "SlotIndex.h"
+#include "EntryView.h"
+#include "EntryScan.h"
+#include "Snapshot.h"
+#include "ReadWriteLock.h"
 #include <cstdint>
 #include <vector>
 #include <string>
@@ -13,9 +19,67 @@
 #define DEVICE_SETTINGS_START_ADDRESS 0x00    // Start address where device settings are stored
 #define ADDRESS_TABLE_START_ADDRESS   0x1000  // Second subsector stores entry address table
 #define ENTRY_START_ADDRESS           0x2000  // Entries are stored starting at address of third subsector
+#define ADDRESS_TABLE_SEGMENT_START_ADDRESS 0x0C0000  // Home addresses of address table segments after the first one
+#define METADATA_START_ADDRESS        0x100000  // Title/URL index with one record per slot of first address table segment (32 subsectors)
+#define USAGE_LOG_START_ADDRESS       0x120000  // Usage counters of entries (2 halves), see UsageLog
+#define INTEGRITY_JOURNAL_START_ADDRESS 0x130000  // Digests of EntryLog subsectors (2 halves), see IntegrityIndex
+#define METADATA_SEGMENT_START_ADDRESS 0x140000  // Title/URL index of address table segments after the first one (32 subsectors each)
+#define ENTRY_LOG_START_ADDRESS       0x200000  // Log-structured entry store, see EntryLog
+#define WEAR_JOURNAL_START_ADDRESS    0x180000  // Wear leveling journal (2 subsectors), see WearLeveler
+#define WEAR_POOL_START_ADDRESS       0x190000  // Physical subsectors holding device settings, address table and title/URL index
+#define STORE_FORMAT_ADDRESS          0x03    // Entry store format is stored in device settings page
 #define SALT_START_ADDRESS            0x04    // Salt is stored in device settings page
 #define HASHED_PWD_START_ADDRESS      0x14    // Hashed master password (32 bytes) is stored in device settings page
-#define MAX_ENTRY_COUNT               0x07FF  // Max count of stored entries is 2047
+#define ENTRY_LOG_APPLIED_ADDRESS     0x34    // Newest EntryLog commit record contained in address table (4 bytes)
+#define TABLE_SEGMENT_COUNT_ADDRESS   0x38    // Count of address table segments in use (0xFF = first segment only)
+#define TABLE_SEGMENT_ROOT_ADDRESS    0x39    // Home address (4 bytes) of every address table segment in use
+#define WIPE_CURSOR_ADDRESS           0x59    // Next subsector of old data to erase after formatStorage() (2 bytes)
+#define SETTINGS_SEQUENCE_ADDRESS     0xF8    // Sequence number (4 bytes) of device settings record
+#define SETTINGS_CHECKSUM_ADDRESS     0xFC    // FNV-1a checksum (4 bytes) over device settings record in front of it
+#define SETTINGS_RECORD_COUNT         (MT25Q_SUBSECTOR_SIZE / MT25Q_PAGE_SIZE)  // Device settings records appended per subsector
+#define ENTRY_TABLE_SEGMENT_SLOTS     2048    // Address table slots per segment (one subsector)
+#define ENTRY_RAM_BUDGET              (128 * 1024)  // SRAM for tables growing with entry count, rest of 320KB holds Mbed OS, stacks and fixed buffers (~64KB)
+#define ENTRY_RAM_PER_ENTRY           32      // Id index 2, address table 2, log maps 4, search index 8, usage counter 8, credential list and rank 6, bitmaps
+#define ENTRY_TABLE_SEGMENT_COUNT     (ENTRY_RAM_BUDGET / ENTRY_RAM_PER_ENTRY / ENTRY_TABLE_SEGMENT_SLOTS)  // Max count of address table segments (2)
+#define MAX_ENTRY_COUNT               (ENTRY_TABLE_SEGMENT_COUNT * ENTRY_TABLE_SEGMENT_SLOTS - 1)  // Max count of stored entries is 4095
+#define FIXED_STORE_MAX_SLOTS         ENTRY_TABLE_SEGMENT_SLOTS  // Slot pages of fixed store end in front of title/URL index
+#define ENTRY_SLOT_UNUSED             0xFFFF  // Marks an unused slot in address table and id index
+#define ENTRY_NO_ADDRESS              0xFFFFFFFF  // Entry page has no address in flash
+
+#define ENTRY_STORE_FIXED             0xFF    // Entry pages at fixed address of their slot, re-written in place
+#define ENTRY_STORE_LOG               0x01    // Entry pages appended to EntryLog
+#define ENTRY_STORE_PACKED            0x02    // Variable-length entries packed into EntryLog records
+#define ENTRY_STORE_DEFAULT           ENTRY_STORE_PACKED  // Store format of newly initialized devices
+
+#define ENTRY_LOG_SUBSECTOR_COUNT     1024    // 4MB log, four times the size needed for MAX_ENTRY_COUNT whole page entries
+#define ENTRY_LOG_FLAGS_OFFSET        123     // Record flags in front of sequence number
+#define ENTRY_LOG_SEQUENCE_OFFSET     124     // Record sequence number (4 bytes) at end of plaintext half
+#define ENTRY_LOG_RESERVED_SUBSECTORS 1       // Erased subsectors kept back for garbage collection
+#define ENTRY_LOG_GC_THRESHOLD        8       // Live records are moved only when fewer erased subsectors are left
+#define ENTRY_PREPARED_SLOT_COUNT     16      // Lowest free slots whose title/URL record is kept erased, so adding an entry only programs pages
+#define ENTRY_LOG_CHECKPOINT_INTERVAL 16      // Address table gets written once this many commit records are pending
+
+#define ENTRY_WIPE_DONE               0xFFFF  // Wipe cursor once no old data is left
+#define ENTRY_WIPE_FIXED_SUBSECTORS   (FIXED_STORE_MAX_SLOTS * MT25Q_PAGE_SIZE / MT25Q_SUBSECTOR_SIZE)
+#define ENTRY_WIPE_METADATA_SUBSECTORS (ENTRY_TABLE_SEGMENT_COUNT * WEAR_METADATA_SUBSECTOR_COUNT)
+#define ENTRY_WIPE_SUBSECTOR_COUNT    (ENTRY_LOG_SUBSECTOR_COUNT + ENTRY_WIPE_FIXED_SUBSECTORS + ENTRY_WIPE_METADATA_SUBSECTORS + \
+  WEAR_LOGICAL_SUBSECTOR_COUNT + WEAR_POOL_SUBSECTOR_COUNT + 2 * USAGE_LOG_HALF_SUBSECTORS)  // Log, fixed slot pages, title/URL index, home addresses, pool, usage log
+#define ENTRY_WIPE_ERASES_PER_RUN     2       // Subsectors of old data erased per maintenance run
+#define ENTRY_WIPE_CHECKS_PER_RUN     32      // Subsectors of old data checked per maintenance run
+
+#define ENTRY_TRANSACTION_MAX_OPERATIONS 16   // Operations queued in one transaction
+#define ENTRY_OPERATION_ADD           0x01
+#define ENTRY_OPERATION_EDIT          0x02
+#define ENTRY_OPERATION_REMOVE        0x03
+
+#define WEAR_METADATA_SUBSECTOR_COUNT 32      // Subsectors of title/URL index per address table segment
+#define WEAR_LOGICAL_SUBSECTOR_COUNT  (1 + ENTRY_TABLE_SEGMENT_COUNT * (1 + WEAR_METADATA_SUBSECTOR_COUNT))  // Device settings, address table segments and their title/URL index
+#define WEAR_POOL_SUBSECTOR_COUNT     96      // Physical subsectors the system subsectors are spread over (ends in front of EntryLog)
+#define WEAR_BALANCE_THRESHOLD        64      // Erase count spread after which cold data gets moved
+#define WEAR_ERASED_POOL_SIZE         4       // Free physical subsectors kept erased, so relocations only program pages
+
+#define USAGE_LOG_HALF_SUBSECTORS     8       // Subsectors per half of usage log (4096 records)
+#define INTEGRITY_JOURNAL_HALF_SUBSECTORS 8   // Subsectors per half of integrity journal (2048 records)
 
 #define ENTRY_TITLE_SIZE              16      // Entry title size in bytes
 #define ENTRY_USERNAME_SIZE           32      // Entry username size in bytes
@@ -23,6 +87,45 @@
 #define ENTRY_PASSWORD_SIZE           32      // Entry password size in bytes
 #define ENTRY_URL_SIZE                24      // Entry url size in bytes
 
+#define ENTRY_PLAIN_SIZE              128     // Unencrypted first half of entry page
+#define ENTRY_SECRET_SIZE             128     // AES encrypted second half of entry page
+#define ENTRY_TITLE_OFFSET            2
+#define ENTRY_URL_OFFSET              (ENTRY_TITLE_OFFSET + ENTRY_TITLE_SIZE)
+#define ENTRY_USERNAME_OFFSET         ENTRY_PLAIN_SIZE
+#define ENTRY_EMAIL_OFFSET            (ENTRY_USERNAME_OFFSET + ENTRY_USERNAME_SIZE)
+#define ENTRY_PASSWORD_OFFSET         (ENTRY_EMAIL_OFFSET + ENTRY_EMAIL_SIZE)
+
+#define ENTRY_PACKED_PLAIN_MAX_SIZE   (2 + ENTRY_TITLE_SIZE + ENTRY_URL_SIZE)  // [TITLE LEN] [TITLE] [URL LEN] [URL]
+#define ENTRY_PACKED_SECRET_MAX_SIZE  144     // Length-prefixed username, email and password padded to AES block size
+#define ENTRY_PACKED_MAX_SIZE         (ENTRY_PACKED_PLAIN_MAX_SIZE + 1 + ENTRY_PACKED_SECRET_MAX_SIZE)
+
+#define METADATA_RECORD_SIZE          64      // Copy of first 64 bytes of entry page ([ID] [TITLE] [URL] [Not Defined])
+#define METADATA_READ_CHUNK_SIZE      1024    // Bytes of title/URL index read per burst while listing
+#define ENTRY_SCAN_BUFFER_SIZE        2048    // Bytes of consecutive entry pages read per burst while scanning
+
+#define STATS_FLASH_CACHE_HITS        0       // Pages read by MT25Q::readBytes() found in page cache
+#define STATS_FLASH_CACHE_MISSES      1       // Pages read by MT25Q::readBytes() from flash
+#define STATS_FLASH_UPDATES_SKIPPED   2       // Page updates of MT25Q::writeBytes() matching flash content
+#define STATS_FLASH_UPDATES_PROGRAMMED 3      // Page updates of MT25Q::writeBytes() only clearing bits, programmed without erase
+#define STATS_FLASH_UPDATES_ERASED    4       // Page updates of MT25Q::writeBytes() erasing their subsector
+#define STATS_WEAR_UPDATES_SKIPPED    5       // Page updates of WearLeveler matching flash content
+#define STATS_WEAR_UPDATES_PROGRAMMED 6       // Page updates of WearLeveler programmed in place
+#define STATS_WEAR_UPDATES_RELOCATED  7       // Page updates of WearLeveler written by relocating their subsector
+#define STATS_ENTRY_CACHE_HITS        8       // Entry reads served from EntryCache
+#define STATS_ENTRY_CACHE_MISSES      9       // Entry reads missing EntryCache
+#define STATS_WEAR_MIN_ERASES         10      // Lowest erase count of WearLeveler pool
+#define STATS_WEAR_MAX_ERASES         11      // Highest erase count of WearLeveler pool
+#define STATS_WEAR_TOTAL_ERASES       12      // Summed erase count of WearLeveler pool
+#define STATS_WEAR_REMAINING_ERASES   13      // Subsector updates WearLeveler pool can take until MT25Q_ERASE_ENDURANCE
+#define STATS_COUNT                   14      // Counters returned by getStats()
+
+class EntryLog;
+class WearLeveler;
+class SearchIndex;
+class EntryCache;
+class UsageLog;
+class IntegrityIndex;
+
 class EntryManager
 {
   public:
@@ -36,23 +139,121 @@ class EntryManager
     bool addEntry(const char* title, const char* usr, const char* email, const char* pwd, const char* url);
     bool editEntry(uint16_t id, const char* title, const char* usr, const char* email, const char* pwd, const char* url);
     bool getEntry(uint16_t id, uint8_t* title, uint8_t* usr, uint8_t* email, uint8_t* pwd, uint8_t* url);
+    bool readEntry(uint16_t id, uint8_t fieldMask, EntryView* view);
+    void beginScan(EntryScan* scan, uint16_t firstSlot);
+    bool readNextEntry(EntryScan* scan, uint8_t fieldMask, EntryView* view);
+    void recordUse(uint16_t id);
     bool removeEntry(uint16_t id);
+    bool beginTransaction(void);
+    bool queueAddEntry(const char* title, const char* usr, const char* email, const char* pwd, const char* url);
+    bool queueEditEntry(uint16_t id, const char* title, const char* usr, const char* email, const char* pwd, const char* url);
+    bool queueRemoveEntry(uint16_t id);
+    bool commitTransaction(void);
+    void abortTransaction(void);
+    bool beginImport(void);
+    bool importEntry(const char* title, const char* usr, const char* email, const char* pwd, const char* url);
+    bool finishImport(void);
+    bool isImportOpen(void);
     bool needsToBeInitialized(void);
     bool comparePassword(uint8_t* pwd);
     uint16_t getEntryCount(void);
     uint16_t getUniqueId(void);
-    vector<tuple<uint16_t, string>> getEntriesTitleInfo(void);
+    vector<uint16_t> findEntries(uint8_t field, const char* query, uint8_t queryLength);
+    void runMaintenance(void);
+    void formatStorage(void);
+    uint8_t getWipeProgress(void);
+    ReadWriteLock* getAccessLock(void);
+    void clearEntryCache(void);
+    uint8_t getIntegrityStatus(uint8_t* progress, uint32_t* rootDigest, vector<uint16_t>* damagedSubsectors);
+    void getStats(uint32_t* stats);
+    static uint8_t getFieldLength(const uint8_t* field, uint8_t maxLength);
 
-    static vector<tuple<uint16_t, string>> credentialInfo;
+    static SnapshotPublisher<vector<uint16_t>> credentialInfo;   // Ids of all entries, most used first, titles are read when drawn
     
   private:
     MT25Q* flashMemory;
     CryptoEngine* cryptoEngine;
-    vector<uint16_t> usedIds;
-    static uint8_t addressTable[MT25Q_SUBSECTOR_SIZE];
+    ReadWriteLock accessLock;     // Shared by reading methods, exclusive for methods changing entries or settings
+    Mutex scanMutex;              // Guards scan buffer, which is filled by readers
+    EntryLog* entryLog;
+    WearLeveler* systemStorage;
+    SearchIndex* searchIndex;
+    EntryCache* entryCache;
+    UsageLog* usageLog;
+    IntegrityIndex* integrityIndex;
+    static SlotIndex<ENTRY_TABLE_SEGMENT_COUNT * ENTRY_TABLE_SEGMENT_SLOTS, MAX_ENTRY_COUNT> slotIndex;  // Address table and id index
+    static uint16_t credentialRanks[MAX_ENTRY_COUNT];  // Index of every id in newest credentialInfo, ENTRY_SLOT_UNUSED if not listed
+    static FreeBitmap<MAX_ENTRY_COUNT> freeIds;
+    static FreeBitmap<MAX_ENTRY_COUNT> freeSlots;
+    static uint8_t metadataBuffer[METADATA_READ_CHUNK_SIZE];
+    static uint8_t scanBuffer[ENTRY_SCAN_BUFFER_SIZE];
+    static uint8_t subsectorBuffer[MT25Q_SUBSECTOR_SIZE];
     uint8_t deviceSettings[MT25Q_PAGE_SIZE];
+    uint32_t settingsSequence;    // Sequence number of newest device settings record
+    uint8_t settingsRecord;       // Page of newest device settings record in its subsector
+    uint8_t nextSettingsRecord;   // First erased page behind it, SETTINGS_RECORD_COUNT if subsector is full
+    uint8_t tableSegmentCount;
+    uint8_t dirtyTableSegments;   // Bit per segment changed since last write to flash
+    uint32_t scanBufferAddr;      // Flash address of first page in scan buffer
+    uint16_t scanBufferSize;      // Bytes in scan buffer, 0 if it has to be read again
+
+    bool transactionOpen;
+    bool importOpen;
+    bool searchIndexValid;
+    uint16_t migrationCursor;
+    uint8_t transactionSize;
+    uint8_t transactionTypes[ENTRY_TRANSACTION_MAX_OPERATIONS];
+    uint16_t transactionIds[ENTRY_TRANSACTION_MAX_OPERATIONS];
+    uint16_t transactionSlots[ENTRY_TRANSACTION_MAX_OPERATIONS];
+    uint8_t transactionSizes[ENTRY_TRANSACTION_MAX_OPERATIONS];   // Size of packed entries
+    static uint8_t transactionPages[ENTRY_TRANSACTION_MAX_OPERATIONS][MT25Q_PAGE_SIZE];
     
     uint8_t getStringLength(const char* str, uint8_t maxLength);
+    void readSettingsRecord(void);
+    void writeSettingsRecord(bool isFresh);
+    static uint32_t getSettingsChecksum(const uint8_t* record);
+    void setIdAtSlot(uint16_t slot, uint16_t id);
+    void useTableSegment(uint16_t slot);
+    uint32_t getTableSegmentAddress(uint8_t segment);
+    void loadAddressTable(void);
+    void writeAddressTable(void);
+    uint16_t getUsedSlotRange(void);
+    void tombstoneMetadataRecords(void);
+    void writeMetadataRecords(void);
+    void forEachEntryRecord(function<void(uint16_t, const uint8_t*)> visit);
+    void rebuildSearchIndex(void);
+    vector<uint16_t> searchEntries(uint8_t field, const char* query, uint8_t queryLength);
+    void insertSearchKeys(uint16_t id, const uint8_t* record);
+    void loadCredentialInfo(void);
+    void updateCredentialInfo(uint8_t index, vector<uint16_t>& info);
+    void setCredentialRanks(const vector<uint16_t>& info, uint16_t first, uint16_t last);
+    bool isRankedBefore(uint16_t id, uint16_t otherId);
+    void buildMetadataRecord(uint8_t index, uint8_t* record);
+    uint32_t getMetadataAddress(uint16_t slot);
+    bool usesEntryLog(void);
+    bool usesPackedEntries(void);
+    bool migrateToPackedEntries(void);
+    bool prepareFreeSlots(void);
+    bool wipeOldData(void);
+    bool wipeSubsector(uint16_t index);
+    bool wipeFixedSubsector(uint16_t subsector);
+    bool wipeMetadataSubsector(uint8_t subsector);
+    uint16_t getWipeCursor(void);
+    void setWipeCursor(uint16_t cursor);
+    void mountEntryLog(void);
+    void rebuildIdIndex(void);
+    uint32_t getAppliedSequence(void);
+    uint32_t getEntryPageAddress(uint16_t slot);
+    void buildEntryPage(uint16_t id, const char* title, const char* usr, const char* email, const char* pwd, const char* url, uint8_t* page);
+    uint8_t buildPackedEntry(const char* title, const char* usr, const char* email, const char* pwd, const char* url, uint8_t* data);
+    void buildTransactionEntry(uint8_t index, uint16_t id, const char* title, const char* usr, const char* email, const char* pwd, const char* url);
+    bool readPackedEntry(uint16_t id, uint8_t fieldMask, EntryView* view);
+    bool openEntryPage(uint16_t id, bool needsSecret, EntryView* view);
+    bool unpackEntry(uint16_t id, uint8_t* data, uint8_t size, bool needsSecret, EntryView* view);
+    void loadScanBuffer(EntryScan* scan);
+    int16_t findQueuedOperation(uint16_t id);
+    bool commitToEntryLog(void);
+    bool commitToFixedSlots(void);
     void setEntryCount(uint16_t entryCount);
 };
 
@@ -0,0 +1,17 @@
+#include "EntryScan.h"
+
+/*
+  EntryScan(void) initializes an empty scan, EntryManager::beginScan() fills it.
+*/
+EntryScan::EntryScan(void)
+{
+  nextPosition = 0;
+}
+
+/*
+  uint16_t getRemainingCount(void) returns number of entries not handed out yet.
+*/
+uint16_t EntryScan::getRemainingCount(void)
+{
+  return positions.size() - nextPosition;
+}
@@ -0,0 +1,30 @@
+#include "mbed.h"
+#include <cstdint>
+#include <vector>
+#include <tuple>
+
+#ifndef ENTRY_SCAN_H
+#define ENTRY_SCAN_H
+
+/*
+  EntryScan walks all saved entries in the order of their pages in flash, see EntryManager::beginScan() and
+  EntryManager::readNextEntry().
+
+  The scan only keeps the page address and id of every entry. Pages are read by EntryManager in bursts of
+  several consecutive pages into one shared buffer, so walking the vault costs a few long reads instead of a
+  read command per entry.
+*/
+class EntryScan
+{
+  public:
+    EntryScan(void);
+    uint16_t getRemainingCount(void);
+
+  private:
+    friend class EntryManager;
+
+    vector<tuple<uint32_t, uint16_t>> positions;  // Page address and id of every entry, sorted by address
+    uint16_t nextPosition;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "EntryView.h"
+#include "EntryManager.h"
+
+/*
+  EntryView(void) initializes an empty view.
+*/
+EntryView::EntryView(void)
+{
+  loadedFields = 0;
+}
+
+/*
+  ~EntryView(void) wipes page buffer so no decrypted data stays on the stack.
+*/
+EntryView::~EntryView(void)
+{
+  clear();
+}
+
+/*
+  void clear(void) wipes page buffer and marks all fields as not loaded.
+*/
+void EntryView::clear(void)
+{
+  volatile uint8_t* pageData = page;
+  for(auto i = 0; i < MT25Q_PAGE_SIZE; i++)
+  {
+    pageData[i] = 0x00;
+  }
+
+  loadedFields = 0;
+}
+
+/*
+  uint16_t getId(void) returns id of the entry held by this view.
+*/
+uint16_t EntryView::getId(void)
+{
+  return (page[0] << 8) | page[1];
+}
+
+/*
+  bool hasFields(uint8_t) returns true if all fields of fieldMask are loaded.
+*/
+bool EntryView::hasFields(uint8_t fieldMask)
+{
+  return (loadedFields & fieldMask) == fieldMask;
+}
+
+/*
+  const char* getField(uint8_t) returns pointer to a field (ENTRY_FIELD_*) inside the page buffer.
+
+  Returns NULL if field was not loaded.
+*/
+const char* EntryView::getField(uint8_t field)
+{
+  if(!hasFields(field))
+  {
+    return NULL;
+  }
+
+  return (const char*)&page[getFieldOffset(field)];
+}
+
+/*
+  uint8_t getFieldLength(uint8_t) returns length of a field (ENTRY_FIELD_*) without padding.
+
+  Returns 0 if field was not loaded.
+*/
+uint8_t EntryView::getFieldLength(uint8_t field)
+{
+  if(!hasFields(field))
+  {
+    return 0;
+  }
+
+  return EntryManager::getFieldLength(&page[getFieldOffset(field)], getFieldSize(field));
+}
+
+/*
+  uint8_t getFieldOffset(uint8_t) returns offset of a field inside entry page.
+*/
+uint8_t EntryView::getFieldOffset(uint8_t field)
+{
+  switch(field)
+  {
+    case ENTRY_FIELD_TITLE:
+      return ENTRY_TITLE_OFFSET;
+    case ENTRY_FIELD_URL:
+      return ENTRY_URL_OFFSET;
+    case ENTRY_FIELD_USERNAME:
+      return ENTRY_USERNAME_OFFSET;
+    case ENTRY_FIELD_EMAIL:
+      return ENTRY_EMAIL_OFFSET;
+    default:
+      return ENTRY_PASSWORD_OFFSET;
+  }
+}
+
+/*
+  uint8_t getFieldSize(uint8_t) returns max size of a field.
+*/
+uint8_t EntryView::getFieldSize(uint8_t field)
+{
+  switch(field)
+  {
+    case ENTRY_FIELD_TITLE:
+      return ENTRY_TITLE_SIZE;
+    case ENTRY_FIELD_URL:
+      return ENTRY_URL_SIZE;
+    case ENTRY_FIELD_USERNAME:
+      return ENTRY_USERNAME_SIZE;
+    case ENTRY_FIELD_EMAIL:
+      return ENTRY_EMAIL_SIZE;
+    default:
+      return ENTRY_PASSWORD_SIZE;
+  }
+}
@@ -0,0 +1,44 @@
+#include "MT25Q.h"
+#include <cstdint>
+
+#ifndef ENTRY_VIEW_H
+#define ENTRY_VIEW_H
+
+// Field masks for EntryManager::readEntry()
+#define ENTRY_FIELD_TITLE             0x01
+#define ENTRY_FIELD_URL               0x02
+#define ENTRY_FIELD_USERNAME          0x04
+#define ENTRY_FIELD_EMAIL             0x08
+#define ENTRY_FIELD_PASSWORD          0x10
+
+#define ENTRY_FIELDS_PLAIN            (ENTRY_FIELD_TITLE | ENTRY_FIELD_URL)                                   // Unencrypted half
+#define ENTRY_FIELDS_SECRET           (ENTRY_FIELD_USERNAME | ENTRY_FIELD_EMAIL | ENTRY_FIELD_PASSWORD)       // Encrypted half
+#define ENTRY_FIELDS_ALL              (ENTRY_FIELDS_PLAIN | ENTRY_FIELDS_SECRET)
+
+/*
+  EntryView holds one entry page read by EntryManager::readEntry() and hands out its fields in place.
+  Fields are not null terminated, use getFieldLength() to get their length.
+  Decrypted data is wiped when the view is cleared or destroyed.
+*/
+class EntryView
+{
+  public:
+    EntryView(void);
+    ~EntryView(void);
+    uint16_t getId(void);
+    bool hasFields(uint8_t fieldMask);
+    const char* getField(uint8_t field);
+    uint8_t getFieldLength(uint8_t field);
+    void clear(void);
+
+  private:
+    friend class EntryManager;
+
+    uint8_t page[MT25Q_PAGE_SIZE];
+    uint8_t loadedFields;
+
+    uint8_t getFieldOffset(uint8_t field);
+    uint8_t getFieldSize(uint8_t field);
+};
+
+#endif
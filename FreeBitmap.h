@@ -0,0 +1,184 @@
+#include "mbed.h"
+#include <cstdint>
+
+#ifndef FREE_BITMAP_H
+#define FREE_BITMAP_H
+
+#define FREE_BITMAP_NONE 0xFFFF  // Returned by findFirstFree() when no bit is free
+
+/*
+  FreeBitmap keeps track of free/used indices with one bit per index (1 = free).
+  Bits are stored MSB first so the first free index of a word is found with a single CLZ instruction.
+  A summary level with one bit per word (1 = word has a free index) keeps findFirstFree() at a few CLZ
+  instructions for large bitmaps.
+*/
+template<uint16_t BitCount>
+class FreeBitmap
+{
+  public:
+    FreeBitmap(void)
+    {
+      markAllFree();
+    }
+
+    /*
+      void markAllFree(void) marks every index as free.
+    */
+    void markAllFree(void)
+    {
+      for(auto i = 0; i < SUMMARY_COUNT; i++)
+      {
+        summary[i] = 0;
+      }
+
+      for(auto i = 0; i < WORD_COUNT; i++)
+      {
+        words[i] = 0xFFFFFFFF;
+        summary[i >> 5] |= 0x80000000 >> (i & 0x1F);
+      }
+
+      // Bits past BitCount must never be handed out
+      if(BitCount % 32 != 0)
+      {
+        words[WORD_COUNT - 1] = ~(0xFFFFFFFF >> (BitCount % 32));
+      }
+    }
+
+    /*
+      void markAllUsed(void) marks every index as used.
+    */
+    void markAllUsed(void)
+    {
+      for(auto i = 0; i < WORD_COUNT; i++)
+      {
+        words[i] = 0;
+      }
+
+      for(auto i = 0; i < SUMMARY_COUNT; i++)
+      {
+        summary[i] = 0;
+      }
+    }
+
+    void markUsed(uint16_t idx)
+    {
+      uint16_t wordIdx = idx >> 5;
+      words[wordIdx] &= ~(0x80000000 >> (idx & 0x1F));
+
+      if(words[wordIdx] == 0)
+      {
+        summary[wordIdx >> 5] &= ~(0x80000000 >> (wordIdx & 0x1F));
+      }
+    }
+
+    void markFree(uint16_t idx)
+    {
+      uint16_t wordIdx = idx >> 5;
+      words[wordIdx] |= 0x80000000 >> (idx & 0x1F);
+      summary[wordIdx >> 5] |= 0x80000000 >> (wordIdx & 0x1F);
+    }
+
+    bool isFree(uint16_t idx)
+    {
+      return (words[idx >> 5] & (0x80000000 >> (idx & 0x1F))) != 0;
+    }
+
+    /*
+      uint16_t findFirstFree(void) returns lowest free index.
+      Scans the summary level (1024 indices per word) and then the word it points to.
+
+      Returns FREE_BITMAP_NONE if every index is used.
+    */
+    uint16_t findFirstFree(void)
+    {
+      for(auto i = 0; i < SUMMARY_COUNT; i++)
+      {
+        if(summary[i] != 0)
+        {
+          uint16_t wordIdx = (i << 5) + __CLZ(summary[i]);
+          return (wordIdx << 5) + __CLZ(words[wordIdx]);
+        }
+      }
+
+      return FREE_BITMAP_NONE;
+    }
+
+    /*
+      uint16_t findLastUsed(void) returns highest used index.
+      Scans a word (32 indices) at a time, starting at the end.
+
+      Returns FREE_BITMAP_NONE if every index is free.
+    */
+    uint16_t findLastUsed(void)
+    {
+      for(auto i = WORD_COUNT - 1; i >= 0; i--)
+      {
+        uint32_t used = ~words[i];
+
+        // Bits past BitCount are never used
+        if(i == WORD_COUNT - 1 && BitCount % 32 != 0)
+        {
+          used &= ~(0xFFFFFFFF >> (BitCount % 32));
+        }
+
+        if(used != 0)
+        {
+          return (i << 5) + 31 - __builtin_ctz(used);
+        }
+      }
+
+      return FREE_BITMAP_NONE;
+    }
+
+    /*
+      uint16_t findNextFree(uint16_t) returns first free index at or after startIdx, wrapping around at the end.
+
+      Returns FREE_BITMAP_NONE if every index is used.
+    */
+    uint16_t findNextFree(uint16_t startIdx)
+    {
+      if(startIdx >= BitCount)
+      {
+        startIdx = 0;
+      }
+
+      uint16_t wordIdx = startIdx >> 5;
+      uint32_t word = words[wordIdx] & (0xFFFFFFFF >> (startIdx & 0x1F));
+
+      // One extra iteration to check bits below startIdx in its own word after wrapping around
+      for(auto i = 0; i <= WORD_COUNT; i++)
+      {
+        if(word != 0)
+        {
+          return (wordIdx << 5) + __CLZ(word);
+        }
+
+        wordIdx = (wordIdx + 1) % WORD_COUNT;
+        word = words[wordIdx];
+      }
+
+      return FREE_BITMAP_NONE;
+    }
+
+    /*
+      uint16_t countFree(void) returns number of free indices.
+    */
+    uint16_t countFree(void)
+    {
+      uint16_t count = 0;
+      for(auto i = 0; i < WORD_COUNT; i++)
+      {
+        count += __builtin_popcount(words[i]);
+      }
+
+      return count;
+    }
+
+  private:
+    static const uint16_t WORD_COUNT = (BitCount + 31) / 32;
+    static const uint16_t SUMMARY_COUNT = (WORD_COUNT + 31) / 32;
+    uint32_t words[WORD_COUNT];
+    uint32_t summary[SUMMARY_COUNT];
+};
+
+#endif
@@ -0,0 +1,443 @@
+#include "IntegrityIndex.h"
+#include <algorithm>
+
+#define PAGES_PER_LEAF                (MT25Q_SUBSECTOR_SIZE / MT25Q_PAGE_SIZE)
+#define LOG_PAGE_ADDRESS(page)        (ENTRY_LOG_START_ADDRESS + ((uint32_t)(page) << 8))
+
+uint8_t IntegrityIndex::readBuffer[];
+
+/*
+  IntegrityIndex(MT25Q*) initializes class, mount() loads the digests.
+*/
+IntegrityIndex::IntegrityIndex(MT25Q* flashMemory) :
+  Journal(flashMemory, INTEGRITY_JOURNAL_START_ADDRESS, INTEGRITY_JOURNAL_HALF_SUBSECTORS, INTEGRITY_RECORD_SIZE)
+{
+  fill_n(digests, 2 * INTEGRITY_LEAF_COUNT, 0);
+  fill_n(checkedDigests, 2 * INTEGRITY_LEAF_COUNT, 0);
+  isBuilt = false;
+  checkCursor = 0;
+  hasNewestRecord = false;
+}
+
+/*
+  void mount(void) loads leaf digests from the journal half with the newest valid header and restarts the check.
+  Without a valid half the tree is built by the next check.
+*/
+void IntegrityIndex::mount(void)
+{
+  fill_n(digests, 2 * INTEGRITY_LEAF_COUNT, 0);
+  damagedSubsectors.clear();
+  isBuilt = false;
+  checkCursor = 0;
+  hasNewestRecord = false;
+
+  if(!mountJournal())
+  {
+    return;
+  }
+
+  updateAllNodes(digests);
+  isBuilt = true;
+
+  if(hasNewestRecord)
+  {
+    resync(newestRecord);
+  }
+}
+
+/*
+  void resync(const uint8_t*) makes leaf of newest journal record match flash, as its page program or erase may
+  have been interrupted by power loss. Only the page of a program record is taken from flash, so damage in other
+  pages of its subsector is still found by the check.
+*/
+void IntegrityIndex::resync(const uint8_t* record)
+{
+  uint16_t page = (record[1] << 8) | record[2];
+  uint16_t leaf = page / PAGES_PER_LEAF;
+
+  if(record[0] == INTEGRITY_RECORD_PROGRAM)
+  {
+    uint32_t programmedDigest = (record[7] << 24) | (record[8] << 16) | (record[9] << 8) | record[10];
+
+    flashMemory->readBurst(LOG_PAGE_ADDRESS(page), readBuffer, MT25Q_PAGE_SIZE);
+    uint32_t pageDigest = getPageDigest(page, readBuffer);
+
+    setLeafDigest(INTEGRITY_RECORD_LEAF, page, digests[INTEGRITY_LEAF_COUNT + leaf] ^ programmedDigest ^ pageDigest, pageDigest);
+  }
+  else if(record[0] == INTEGRITY_RECORD_ERASE)
+  {
+    setLeafDigest(INTEGRITY_RECORD_LEAF, page, readLeafDigest(leaf), 0);
+  }
+}
+
+/*
+  void programPage(uint16_t, const uint8_t*) programs given EntryLog page like MT25Q::writeBytes() and updates
+  its leaf. Digest of the programmed page is taken from the current page content, as 0xFF bytes keep it.
+*/
+void IntegrityIndex::programPage(uint16_t page, const uint8_t* data)
+{
+  uint16_t leaf = page / PAGES_PER_LEAF;
+  uint8_t content[MT25Q_PAGE_SIZE];
+  flashMemory->readBytes(LOG_PAGE_ADDRESS(page), content, MT25Q_PAGE_SIZE);
+
+  uint32_t oldDigest = getPageDigest(page, content);
+  for(uint16_t i = 0; i < MT25Q_PAGE_SIZE; i++)
+  {
+    content[i] &= data[i];
+  }
+  uint32_t newDigest = getPageDigest(page, content);
+  uint32_t change = oldDigest ^ newDigest;
+
+  if(isBuilt)
+  {
+    setLeafDigest(INTEGRITY_RECORD_PROGRAM, page, digests[INTEGRITY_LEAF_COUNT + leaf] ^ change, newDigest);
+  }
+
+  // Subsectors checked already are not read again by current check
+  if(leaf < checkCursor)
+  {
+    checkedDigests[INTEGRITY_LEAF_COUNT + leaf] ^= change;
+  }
+
+  flashMemory->writeBytes(LOG_PAGE_ADDRESS(page), data);
+}
+
+/*
+  void eraseSubsector(uint16_t) erases given EntryLog subsector and clears its leaf. An erased subsector holds no
+  damaged data anymore.
+*/
+void IntegrityIndex::eraseSubsector(uint16_t subsector)
+{
+  if(isBuilt)
+  {
+    setLeafDigest(INTEGRITY_RECORD_ERASE, subsector * PAGES_PER_LEAF, 0, 0);
+  }
+
+  if(subsector < checkCursor)
+  {
+    checkedDigests[INTEGRITY_LEAF_COUNT + subsector] = 0;
+  }
+
+  flashMemory->eraseBytes(LOG_PAGE_ADDRESS(subsector * PAGES_PER_LEAF));
+
+  damagedSubsectors.erase(remove(damagedSubsectors.begin(), damagedSubsectors.end(), subsector), damagedSubsectors.end());
+}
+
+/*
+  bool checkNextSubsectors(void) reads up to INTEGRITY_CHECKS_PER_RUN subsectors of current check. Subsectors
+  with a leaf of 0 are taken as erased and not read. Should be called from maintenance.
+
+  Returns true if check was not done yet.
+*/
+bool IntegrityIndex::checkNextSubsectors(void)
+{
+  if(checkCursor >= INTEGRITY_LEAF_COUNT)
+  {
+    return false;
+  }
+
+  uint8_t checked = 0;
+  while(checkCursor < INTEGRITY_LEAF_COUNT && checked < INTEGRITY_CHECKS_PER_RUN)
+  {
+    uint16_t leaf = checkCursor++;
+
+    if(isBuilt && digests[INTEGRITY_LEAF_COUNT + leaf] == 0)
+    {
+      checkedDigests[INTEGRITY_LEAF_COUNT + leaf] = 0;
+      continue;
+    }
+
+    checkedDigests[INTEGRITY_LEAF_COUNT + leaf] = readLeafDigest(leaf);
+    checked++;
+  }
+
+  if(checkCursor == INTEGRITY_LEAF_COUNT)
+  {
+    finishCheck();
+  }
+
+  return true;
+}
+
+/*
+  void finishCheck(void) compares tree read by check with the kept one and lists damaged subsectors. A check
+  without kept tree takes the read one and writes it to the journal.
+*/
+void IntegrityIndex::finishCheck(void)
+{
+  updateAllNodes(checkedDigests);
+  damagedSubsectors.clear();
+
+  if(!isBuilt)
+  {
+    copy_n(checkedDigests, 2 * INTEGRITY_LEAF_COUNT, digests);
+    isBuilt = true;
+    compact();
+    return;
+  }
+
+  findDamaged(1);
+
+  if(!damagedSubsectors.empty())
+  {
+    printf("[Error] Integrity check found %u damaged subsectors in entry log!\n", (unsigned int)damagedSubsectors.size());
+  }
+}
+
+/*
+  void findDamaged(uint16_t) adds leaves below given node whose digest differs from flash content to the list of
+  damaged subsectors. Subtrees with matching digests are skipped.
+*/
+void IntegrityIndex::findDamaged(uint16_t node)
+{
+  if(digests[node] == checkedDigests[node])
+  {
+    return;
+  }
+
+  if(node >= INTEGRITY_LEAF_COUNT)
+  {
+    damagedSubsectors.push_back(node - INTEGRITY_LEAF_COUNT);
+    return;
+  }
+
+  findDamaged(2 * node);
+  findDamaged(2 * node + 1);
+}
+
+/*
+  uint8_t getStatus(void) returns INTEGRITY_STATUS_CHECKING until check is done, INTEGRITY_STATUS_DAMAGED if
+  any subsector did not match its digest.
+*/
+uint8_t IntegrityIndex::getStatus(void)
+{
+  if(checkCursor < INTEGRITY_LEAF_COUNT)
+  {
+    return INTEGRITY_STATUS_CHECKING;
+  }
+
+  return damagedSubsectors.empty() ? INTEGRITY_STATUS_OK : INTEGRITY_STATUS_DAMAGED;
+}
+
+/*
+  uint8_t getCheckProgress(void) returns progress of current check in percent.
+*/
+uint8_t IntegrityIndex::getCheckProgress(void)
+{
+  return (uint32_t)checkCursor * 100 / INTEGRITY_LEAF_COUNT;
+}
+
+/*
+  uint32_t getRootDigest(void) returns root digest of kept tree, 0 if tree is not built yet.
+*/
+uint32_t IntegrityIndex::getRootDigest(void)
+{
+  return isBuilt ? digests[1] : 0;
+}
+
+/*
+  vector<uint16_t> getDamagedSubsectors(void) returns EntryLog subsectors found damaged by last check, which are
+  not erased since.
+*/
+vector<uint16_t> IntegrityIndex::getDamagedSubsectors(void)
+{
+  return damagedSubsectors;
+}
+
+/*
+  uint32_t getPageDigest(uint16_t, const uint8_t*) returns FNV-1a hash of page number and page content, 0 for an
+  erased page.
+*/
+uint32_t IntegrityIndex::getPageDigest(uint16_t page, const uint8_t* data)
+{
+  if(all_of(data, data + MT25Q_PAGE_SIZE, [](uint8_t value) { return value == 0xFF; }))
+  {
+    return 0;
+  }
+
+  uint32_t hash = 2166136261;
+  hash = (hash ^ (page >> 8)) * 16777619;
+  hash = (hash ^ (page & 0xFF)) * 16777619;
+
+  for(uint16_t i = 0; i < MT25Q_PAGE_SIZE; i++)
+  {
+    hash = (hash ^ data[i]) * 16777619;
+  }
+
+  return hash;
+}
+
+/*
+  uint32_t getNodeDigest(uint32_t, uint32_t) returns FNV-1a hash of the digests of both children of a node.
+*/
+uint32_t IntegrityIndex::getNodeDigest(uint32_t left, uint32_t right)
+{
+  uint32_t hash = 2166136261;
+
+  for(int8_t shift = 24; shift >= 0; shift -= 8)
+  {
+    hash = (hash ^ ((left >> shift) & 0xFF)) * 16777619;
+  }
+
+  for(int8_t shift = 24; shift >= 0; shift -= 8)
+  {
+    hash = (hash ^ ((right >> shift) & 0xFF)) * 16777619;
+  }
+
+  return hash;
+}
+
+/*
+  void updateNodes(uint32_t*, uint16_t) recomputes nodes of given tree from given leaf up to the root.
+*/
+void IntegrityIndex::updateNodes(uint32_t* tree, uint16_t leaf)
+{
+  for(uint16_t node = (INTEGRITY_LEAF_COUNT + leaf) / 2; node > 0; node /= 2)
+  {
+    tree[node] = getNodeDigest(tree[2 * node], tree[2 * node + 1]);
+  }
+}
+
+/*
+  void updateAllNodes(uint32_t*) recomputes every inner node of given tree from its leaves.
+*/
+void IntegrityIndex::updateAllNodes(uint32_t* tree)
+{
+  for(uint16_t node = INTEGRITY_LEAF_COUNT - 1; node > 0; node--)
+  {
+    tree[node] = getNodeDigest(tree[2 * node], tree[2 * node + 1]);
+  }
+}
+
+/*
+  uint32_t readLeafDigest(uint16_t) reads given EntryLog subsector from flash and returns its leaf digest.
+*/
+uint32_t IntegrityIndex::readLeafDigest(uint16_t leaf)
+{
+  uint32_t digest = 0;
+  const uint16_t pagesPerChunk = INTEGRITY_READ_CHUNK_SIZE / MT25Q_PAGE_SIZE;
+
+  for(uint16_t page = leaf * PAGES_PER_LEAF; page < (leaf + 1) * PAGES_PER_LEAF; page += pagesPerChunk)
+  {
+    flashMemory->readBurst(LOG_PAGE_ADDRESS(page), readBuffer, INTEGRITY_READ_CHUNK_SIZE);
+
+    for(uint16_t i = 0; i < pagesPerChunk; i++)
+    {
+      digest ^= getPageDigest(page + i, &readBuffer[i * MT25Q_PAGE_SIZE]);
+    }
+  }
+
+  return digest;
+}
+
+/*
+  void setLeafDigest(uint8_t, uint16_t, uint32_t, uint32_t) appends record of given type to journal, then sets
+  digest of the leaf holding given page. Unchanged digests are not written.
+*/
+void IntegrityIndex::setLeafDigest(uint8_t type, uint16_t page, uint32_t leafDigest, uint32_t pageDigest)
+{
+  uint16_t leaf = page / PAGES_PER_LEAF;
+
+  if(digests[INTEGRITY_LEAF_COUNT + leaf] == leafDigest)
+  {
+    return;
+  }
+
+  appendRecord(type, page, leafDigest, pageDigest);
+  digests[INTEGRITY_LEAF_COUNT + leaf] = leafDigest;
+  updateNodes(digests, leaf);
+}
+
+/*
+  void encodeRecord(uint8_t*, uint8_t, uint16_t, uint32_t, uint32_t) builds journal record with check byte.
+*/
+void IntegrityIndex::encodeRecord(uint8_t* record, uint8_t type, uint16_t page, uint32_t leafDigest, uint32_t pageDigest)
+{
+  record[0] = type;
+  record[1] = (page >> 8) & 0xFF;
+  record[2] = page & 0xFF;
+  record[3] = (leafDigest >> 24) & 0xFF;
+  record[4] = (leafDigest >> 16) & 0xFF;
+  record[5] = (leafDigest >> 8) & 0xFF;
+  record[6] = leafDigest & 0xFF;
+  record[7] = (pageDigest >> 24) & 0xFF;
+  record[8] = (pageDigest >> 16) & 0xFF;
+  record[9] = (pageDigest >> 8) & 0xFF;
+  record[10] = pageDigest & 0xFF;
+  record[11] = getRecordCheck(record, 11);
+  fill_n(&record[12], INTEGRITY_RECORD_SIZE - 12, 0xFF);
+}
+
+/*
+  void encodeHeader(uint8_t*, uint32_t) builds header record of a journal half with given generation.
+*/
+void IntegrityIndex::encodeHeader(uint8_t* record, uint32_t headerGeneration)
+{
+  encodeRecord(record, INTEGRITY_RECORD_HEADER, 0, headerGeneration, 0);
+}
+
+/*
+  uint32_t getHeaderGeneration(const uint8_t*) returns generation stored in given header record.
+*/
+uint32_t IntegrityIndex::getHeaderGeneration(const uint8_t* record)
+{
+  return (record[3] << 24) | (record[4] << 16) | (record[5] << 8) | record[6];
+}
+
+/*
+  void replayRecord(uint16_t, const uint8_t*) loads leaf digest of given record while mounting, newer records
+  replace older ones. Newest valid record is kept for resync().
+*/
+void IntegrityIndex::replayRecord(uint16_t, const uint8_t* record)
+{
+  uint16_t page = (record[1] << 8) | record[2];
+  uint32_t leafDigest = (record[3] << 24) | (record[4] << 16) | (record[5] << 8) | record[6];
+  bool isKnownType = record[0] == INTEGRITY_RECORD_PROGRAM || record[0] == INTEGRITY_RECORD_ERASE ||
+    record[0] == INTEGRITY_RECORD_LEAF;
+
+  // Skip records torn by power loss, their page program or erase was not started
+  if(getRecordCheck(record, 11) != record[11] || !isKnownType || page >= INTEGRITY_LEAF_COUNT * PAGES_PER_LEAF)
+  {
+    return;
+  }
+
+  digests[INTEGRITY_LEAF_COUNT + page / PAGES_PER_LEAF] = leafDigest;
+  copy_n(record, INTEGRITY_RECORD_SIZE, newestRecord);
+  hasNewestRecord = true;
+}
+
+/*
+  void appendRecord(uint8_t, uint16_t, uint32_t, uint32_t) programs record at journal head. A full or missing
+  journal is compacted first.
+*/
+void IntegrityIndex::appendRecord(uint8_t type, uint16_t page, uint32_t leafDigest, uint32_t pageDigest)
+{
+  uint8_t record[INTEGRITY_RECORD_SIZE];
+  encodeRecord(record, type, page, leafDigest, pageDigest);
+
+  // Compaction writes digests from before this change, the record still has to precede its page program or erase
+  if(!appendJournalRecord(record))
+  {
+    appendJournalRecord(record);
+  }
+}
+
+/*
+  void compact(void) writes one record per leaf which is not 0 into the other half and makes it the active half.
+*/
+void IntegrityIndex::compact(void)
+{
+  beginCompaction();
+
+  for(uint16_t leaf = 0; leaf < INTEGRITY_LEAF_COUNT; leaf++)
+  {
+    if(digests[INTEGRITY_LEAF_COUNT + leaf] != 0)
+    {
+      uint8_t record[INTEGRITY_RECORD_SIZE];
+      encodeRecord(record, INTEGRITY_RECORD_LEAF, leaf * PAGES_PER_LEAF, digests[INTEGRITY_LEAF_COUNT + leaf], 0);
+      addCompactedRecord(record);
+    }
+  }
+
+  finishCompaction();
+}
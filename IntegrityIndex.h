@@ -0,0 +1,81 @@
+#include "MT25Q.h"
+#include "EntryManager.h"
+#include "Journal.h"
+#include <cstdint>
+#include <vector>
+
+#ifndef INTEGRITY_INDEX_H
+#define INTEGRITY_INDEX_H
+
+#define INTEGRITY_LEAF_COUNT          ENTRY_LOG_SUBSECTOR_COUNT  // One leaf per EntryLog subsector
+#define INTEGRITY_RECORD_SIZE         16      // [TYPE] [PAGE 2 bytes] [LEAF DIGEST 4 bytes] [PAGE DIGEST 4 bytes] [CHECK] [4 bytes unused]
+#define INTEGRITY_RECORD_PROGRAM      0x50    // Written before a page program, with digests once it is done
+#define INTEGRITY_RECORD_ERASE        0x45    // Written before a subsector erase
+#define INTEGRITY_RECORD_LEAF         0x4C    // Sets digest of a leaf, e.g. on compaction
+#define INTEGRITY_RECORD_HEADER       0xA5    // First record of a journal half, its generation in place of the leaf digest
+#define INTEGRITY_READ_CHUNK_SIZE     1024    // Bytes of flash read per burst while computing digests
+#define INTEGRITY_CHECKS_PER_RUN      8       // Subsectors of EntryLog read per maintenance run while checking
+
+#define INTEGRITY_STATUS_OK           0x00    // Every subsector matches its digest
+#define INTEGRITY_STATUS_DAMAGED      0x01    // Some subsectors do not match their digest, see getDamagedSubsectors()
+#define INTEGRITY_STATUS_CHECKING     0x02    // Check started on mount is not done yet
+
+/*
+  IntegrityIndex keeps a Merkle tree over the pages of EntryLog, so corrupted flash is found without decrypting
+  any entry.
+
+  Every page has a digest (FNV-1a over page number and content, 0 for an erased page). Leaves hold the XOR of the
+  page digests of one EntryLog subsector, so a page program or erase updates its leaf from the old and new page
+  content alone, followed by the log2(INTEGRITY_LEAF_COUNT) nodes up to the root. EntryLog writes pages through
+  programPage() and eraseSubsector() for this.
+
+  Leaf digests are kept in a Journal alternating between two halves, like the counts of UsageLog. Every record
+  is programmed before its page program or erase, so after power loss only the page or subsector of the newest
+  record can differ from its digest, which mount() reads again. Inner nodes are computed in RAM on mount.
+
+  The check started on mount reads the subsectors of EntryLog from maintenance, a few per run, and compares root
+  digests. A mismatch is narrowed down by descending into the subtrees whose digests differ, so each damaged
+  subsector is found with log2(INTEGRITY_LEAF_COUNT) node compares. Without a valid journal (first start), the
+  first check builds the tree instead.
+*/
+class IntegrityIndex : public Journal
+{
+  public:
+    IntegrityIndex(MT25Q* flashMemory);
+    void mount(void);
+    void programPage(uint16_t page, const uint8_t* data);
+    void eraseSubsector(uint16_t subsector);
+    bool checkNextSubsectors(void);
+    uint8_t getStatus(void);
+    uint8_t getCheckProgress(void);
+    uint32_t getRootDigest(void);
+    vector<uint16_t> getDamagedSubsectors(void);
+
+  private:
+    uint32_t digests[2 * INTEGRITY_LEAF_COUNT];         // Tree as kept in journal, root at 1 and leaves behind INTEGRITY_LEAF_COUNT
+    uint32_t checkedDigests[2 * INTEGRITY_LEAF_COUNT];  // Tree of flash content read by current check
+    bool isBuilt;                       // Digests are known, false until first check is done
+    uint16_t checkCursor;               // Next leaf to read, INTEGRITY_LEAF_COUNT once check is done
+    vector<uint16_t> damagedSubsectors;
+    uint8_t newestRecord[INTEGRITY_RECORD_SIZE];  // Newest valid journal record found by mount
+    bool hasNewestRecord;
+    static uint8_t readBuffer[INTEGRITY_READ_CHUNK_SIZE];
+
+    static uint32_t getPageDigest(uint16_t page, const uint8_t* data);
+    static uint32_t getNodeDigest(uint32_t left, uint32_t right);
+    static void updateNodes(uint32_t* tree, uint16_t leaf);
+    static void updateAllNodes(uint32_t* tree);
+    uint32_t readLeafDigest(uint16_t leaf);
+    void setLeafDigest(uint8_t type, uint16_t page, uint32_t leafDigest, uint32_t pageDigest);
+    void resync(const uint8_t* record);
+    void findDamaged(uint16_t node);
+    void finishCheck(void);
+    void encodeRecord(uint8_t* record, uint8_t type, uint16_t page, uint32_t leafDigest, uint32_t pageDigest);
+    void appendRecord(uint8_t type, uint16_t page, uint32_t leafDigest, uint32_t pageDigest);
+    void encodeHeader(uint8_t* record, uint32_t headerGeneration) override;
+    uint32_t getHeaderGeneration(const uint8_t* record) override;
+    void replayRecord(uint16_t index, const uint8_t* record) override;
+    void compact(void) override;
+};
+
+#endif
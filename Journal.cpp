@@ -0,0 +1,341 @@
+#include "Journal.h"
+#include <algorithm>
+
+uint8_t Journal::readBuffer[];
+uint8_t Journal::pageBuffer[];
+
+/*
+  Journal(MT25Q*, uint32_t, uint8_t, uint8_t) initializes journal of two halves with given count of subsectors
+  each, starting at given address. mountJournal() loads it.
+*/
+Journal::Journal(MT25Q* flashMemory, uint32_t startAddress, uint8_t halfSubsectors, uint8_t recordSize)
+{
+  this->flashMemory = flashMemory;
+  this->startAddress = startAddress;
+  this->halfSubsectors = halfSubsectors;
+  this->recordSize = recordSize;
+  activeHalf = JOURNAL_NO_HALF;
+  generation = 0;
+  nextRecord = 0;
+  erasedSubsectors = 0;
+  compactionHalf = JOURNAL_NO_HALF;
+  compactionRecord = 0;
+}
+
+/*
+  uint8_t getRecordCheck(const uint8_t*, uint8_t) returns check byte over given count of record bytes.
+*/
+uint8_t Journal::getRecordCheck(const uint8_t* record, uint8_t size)
+{
+  uint8_t check = 0x5A;
+
+  for(uint8_t i = 0; i < size; i++)
+  {
+    check ^= record[i];
+  }
+
+  return check;
+}
+
+/*
+  bool mountJournal(void) replays records of the half with the newest valid header through replayRecord().
+
+  Returns false if neither half is valid, the first appended record compacts then.
+*/
+bool Journal::mountJournal(void)
+{
+  activeHalf = JOURNAL_NO_HALF;
+  generation = 0;
+  nextRecord = 0;
+  erasedSubsectors = 0;
+
+  uint32_t headerGeneration[2];
+  bool valid[2] = {readHeader(0, &headerGeneration[0]), readHeader(1, &headerGeneration[1])};
+
+  if(!valid[0] && !valid[1])
+  {
+    return false;
+  }
+
+  uint8_t half = (valid[0] && (!valid[1] || headerGeneration[0] > headerGeneration[1])) ? 0 : 1;
+  generation = headerGeneration[half];
+  replay(half);
+
+  return true;
+}
+
+/*
+  void formatJournal(void) drops journal. Headers of both halves are erased, so no old record is replayed again.
+  Old records left in the other subsectors are erased by eraseStaleJournalSubsector() or before the half is used
+  again.
+*/
+void Journal::formatJournal(void)
+{
+  activeHalf = JOURNAL_NO_HALF;
+  generation = 0;
+  nextRecord = 0;
+  erasedSubsectors = 0;
+
+  eraseSubsector(0);
+  eraseSubsector(halfSubsectors);
+}
+
+/*
+  bool readHeader(uint8_t, uint32_t*) reads header record of given half.
+
+  Returns true if header is valid.
+*/
+bool Journal::readHeader(uint8_t half, uint32_t* headerGeneration)
+{
+  uint8_t header[JOURNAL_MAX_RECORD_SIZE];
+  flashMemory->readBytes(getRecordAddress(half, 0), header, recordSize);
+
+  *headerGeneration = getHeaderGeneration(header);
+
+  uint8_t expected[JOURNAL_MAX_RECORD_SIZE];
+  encodeHeader(expected, *headerGeneration);
+
+  return equal(expected, expected + recordSize, header);
+}
+
+/*
+  void replay(uint8_t) passes every record of given half behind its header to replayRecord(), up to the first
+  erased record.
+*/
+void Journal::replay(uint8_t half)
+{
+  activeHalf = half;
+  nextRecord = getHalfRecords();
+
+  const uint16_t recordsPerChunk = JOURNAL_READ_CHUNK_SIZE / recordSize;
+
+  for(uint16_t chunkStart = 0; chunkStart < getHalfRecords() && nextRecord == getHalfRecords(); chunkStart += recordsPerChunk)
+  {
+    flashMemory->readBurst(getRecordAddress(half, chunkStart), readBuffer, JOURNAL_READ_CHUNK_SIZE);
+
+    for(uint16_t i = 0; i < recordsPerChunk; i++)
+    {
+      uint16_t index = chunkStart + i;
+      const uint8_t* record = &readBuffer[i * recordSize];
+
+      if(index == 0)
+      {
+        continue;
+      }
+
+      if(all_of(record, record + recordSize, [](uint8_t value) { return value == 0xFF; }))
+      {
+        nextRecord = index;
+        break;
+      }
+
+      replayRecord(index, record);
+    }
+  }
+
+  // Subsectors behind the last record were never written since this half was erased
+  for(uint8_t subsector = getSubsectorOfRecord(0, nextRecord - 1) + 1; subsector < halfSubsectors; subsector++)
+  {
+    erasedSubsectors |= 1UL << (half * halfSubsectors + subsector);
+  }
+}
+
+/*
+  bool appendJournalRecord(const uint8_t*) programs given record at head of active half. A full or missing
+  journal is compacted instead, which writes the state kept in RAM.
+
+  Returns false if journal was compacted and record was not programmed.
+*/
+bool Journal::appendJournalRecord(const uint8_t* record)
+{
+  if(activeHalf == JOURNAL_NO_HALF || nextRecord >= getHalfRecords())
+  {
+    compact();
+    return false;
+  }
+
+  uint32_t recordAddr = getRecordAddress(activeHalf, nextRecord);
+  uint8_t page[MT25Q_PAGE_SIZE];
+  fill_n(page, MT25Q_PAGE_SIZE, 0xFF);
+  copy_n(record, recordSize, &page[recordAddr % MT25Q_PAGE_SIZE]);
+
+  erasedSubsectors &= ~(1UL << getSubsectorOfRecord(activeHalf, nextRecord));
+  flashMemory->writeBytes(recordAddr & ~(MT25Q_PAGE_SIZE - 1), page);
+
+  nextRecord++;
+  return true;
+}
+
+/*
+  uint8_t beginCompaction(void) starts writing the inactive half, subsectors of it not erased in advance are
+  checked and erased here. Records are added by addCompactedRecord() from index 1 on.
+
+  Returns the half written.
+*/
+uint8_t Journal::beginCompaction(void)
+{
+  compactionHalf = activeHalf == JOURNAL_NO_HALF ? 0 : 1 - activeHalf;
+  compactionRecord = 1;
+  fill_n(pageBuffer, MT25Q_PAGE_SIZE, 0xFF);
+
+  for(uint8_t subsector = compactionHalf * halfSubsectors; subsector < (compactionHalf + 1) * halfSubsectors; subsector++)
+  {
+    eraseStaleJournalSubsector(subsector);
+  }
+
+  return compactionHalf;
+}
+
+/*
+  uint16_t addCompactedRecord(const uint8_t*) adds given record to the half written by current compaction.
+  Records are programmed a page at a time.
+
+  Returns index of the record in its half.
+*/
+uint16_t Journal::addCompactedRecord(const uint8_t* record)
+{
+  const uint16_t recordsPerPage = MT25Q_PAGE_SIZE / recordSize;
+  uint16_t index = compactionRecord++;
+
+  copy_n(record, recordSize, &pageBuffer[(index % recordsPerPage) * recordSize]);
+
+  if(compactionRecord % recordsPerPage == 0)
+  {
+    programPage(compactionHalf, index - index % recordsPerPage, pageBuffer);
+    fill_n(pageBuffer, MT25Q_PAGE_SIZE, 0xFF);
+  }
+
+  return index;
+}
+
+/*
+  void finishCompaction(void) programs the last records of current compaction, then its header with the next
+  generation, and makes the written half the active one.
+*/
+void Journal::finishCompaction(void)
+{
+  const uint16_t recordsPerPage = MT25Q_PAGE_SIZE / recordSize;
+  uint16_t pageStart = compactionRecord - compactionRecord % recordsPerPage;
+
+  // Page is left out if it holds no record, the first page only has room for records behind the header
+  if(compactionRecord > max<uint16_t>(pageStart, 1))
+  {
+    programPage(compactionHalf, pageStart, pageBuffer);
+  }
+
+  fill_n(pageBuffer, MT25Q_PAGE_SIZE, 0xFF);
+  encodeHeader(pageBuffer, ++generation);
+  programPage(compactionHalf, 0, pageBuffer);
+
+  activeHalf = compactionHalf;
+  nextRecord = compactionRecord;
+  compactionHalf = JOURNAL_NO_HALF;
+}
+
+/*
+  void programPage(uint8_t, uint16_t, const uint8_t*) programs journal page starting with given record.
+*/
+void Journal::programPage(uint8_t half, uint16_t firstRecord, const uint8_t* page)
+{
+  erasedSubsectors &= ~(1UL << getSubsectorOfRecord(half, firstRecord));
+  flashMemory->writeBytes(getRecordAddress(half, firstRecord), page);
+}
+
+/*
+  bool prepareErasedJournalSubsector(void) erases one subsector of the inactive half once the active half is
+  filled by half, so the next compaction does not wait for erases. Should be called from maintenance.
+
+  Returns true if a subsector was erased.
+*/
+bool Journal::prepareErasedJournalSubsector(void)
+{
+  if(activeHalf == JOURNAL_NO_HALF || nextRecord < getHalfRecords() / 2)
+  {
+    return false;
+  }
+
+  for(uint8_t subsector = 0; subsector < halfSubsectors; subsector++)
+  {
+    if(eraseStaleJournalSubsector((1 - activeHalf) * halfSubsectors + subsector))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*
+  bool eraseStaleJournalSubsector(uint8_t) erases given journal subsector unless it belongs to the active half or
+  is erased already.
+
+  Returns true if subsector was erased.
+*/
+bool Journal::eraseStaleJournalSubsector(uint8_t subsector)
+{
+  if((activeHalf != JOURNAL_NO_HALF && subsector / halfSubsectors == activeHalf) ||
+    (erasedSubsectors & (1UL << subsector)))
+  {
+    return false;
+  }
+
+  if(isSubsectorErased(subsector))
+  {
+    erasedSubsectors |= 1UL << subsector;
+    return false;
+  }
+
+  eraseSubsector(subsector);
+  return true;
+}
+
+/*
+  void eraseSubsector(uint8_t) erases given journal subsector.
+*/
+void Journal::eraseSubsector(uint8_t subsector)
+{
+  flashMemory->eraseBytes(startAddress + subsector * MT25Q_SUBSECTOR_SIZE);
+  erasedSubsectors |= 1UL << subsector;
+}
+
+/*
+  bool isSubsectorErased(uint8_t) returns true if every byte of given journal subsector is 0xFF.
+*/
+bool Journal::isSubsectorErased(uint8_t subsector)
+{
+  for(uint16_t offset = 0; offset < MT25Q_SUBSECTOR_SIZE; offset += JOURNAL_READ_CHUNK_SIZE)
+  {
+    flashMemory->readBurst(startAddress + subsector * MT25Q_SUBSECTOR_SIZE + offset, readBuffer, JOURNAL_READ_CHUNK_SIZE);
+
+    if(!all_of(readBuffer, readBuffer + JOURNAL_READ_CHUNK_SIZE, [](uint8_t value) { return value == 0xFF; }))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/*
+  uint32_t getRecordAddress(uint8_t, uint16_t) returns flash address of record in given half.
+*/
+uint32_t Journal::getRecordAddress(uint8_t half, uint16_t record)
+{
+  return startAddress + half * halfSubsectors * MT25Q_SUBSECTOR_SIZE + record * recordSize;
+}
+
+/*
+  uint16_t getHalfRecords(void) returns count of records per half, header included.
+*/
+uint16_t Journal::getHalfRecords(void)
+{
+  return halfSubsectors * MT25Q_SUBSECTOR_SIZE / recordSize;
+}
+
+/*
+  uint8_t getSubsectorOfRecord(uint8_t, uint16_t) returns journal subsector holding record in given half.
+*/
+uint8_t Journal::getSubsectorOfRecord(uint8_t half, uint16_t record)
+{
+  return half * halfSubsectors + record * recordSize / MT25Q_SUBSECTOR_SIZE;
+}
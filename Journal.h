@@ -0,0 +1,71 @@
+#include "MT25Q.h"
+#include <cstdint>
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#define JOURNAL_NO_HALF               0xFF
+#define JOURNAL_MAX_RECORD_SIZE       16      // Largest record of an owning class
+#define JOURNAL_READ_CHUNK_SIZE       1024    // Bytes of journal read per burst on mount and while checking erased subsectors
+
+/*
+  Journal is an append-only log of fixed-size records alternating between two halves of flash, used by
+  WearLeveler, UsageLog and IntegrityIndex to keep their state without an erase per change.
+
+  Every half starts with a header record holding its generation, the half with the newest valid header is active.
+  Records are appended behind it, each with a single page program. When the active half is full, the owning class
+  writes its current state into the other half (compact()) and the header is programmed last with the next
+  generation, so an interrupted compaction keeps the old half valid. prepareErasedJournalSubsector() erases the
+  other half in advance, so compaction only programs pages.
+
+  Owners define the layout of their records: encodeHeader() and getHeaderGeneration() for header records,
+  replayRecord() to load every other record on mount and compact() to write a new half through
+  beginCompaction(), addCompactedRecord() and finishCompaction().
+*/
+class Journal
+{
+  public:
+    Journal(MT25Q* flashMemory, uint32_t startAddress, uint8_t halfSubsectors, uint8_t recordSize);
+    bool prepareErasedJournalSubsector(void);
+    bool eraseStaleJournalSubsector(uint8_t subsector);
+    static uint8_t getRecordCheck(const uint8_t* record, uint8_t size);
+
+  protected:
+    MT25Q* flashMemory;
+    uint8_t activeHalf;
+    uint32_t generation;
+    uint16_t nextRecord;
+
+    bool mountJournal(void);
+    void formatJournal(void);
+    bool appendJournalRecord(const uint8_t* record);
+    uint8_t beginCompaction(void);
+    uint16_t addCompactedRecord(const uint8_t* record);
+    void finishCompaction(void);
+    uint32_t getRecordAddress(uint8_t half, uint16_t record);
+    uint16_t getHalfRecords(void);
+
+    virtual void encodeHeader(uint8_t* record, uint32_t headerGeneration) = 0;
+    virtual uint32_t getHeaderGeneration(const uint8_t* record) = 0;
+    virtual void replayRecord(uint16_t index, const uint8_t* record) = 0;
+    virtual void compact(void) = 0;
+
+  private:
+    uint32_t startAddress;
+    uint8_t halfSubsectors;
+    uint8_t recordSize;
+    uint32_t erasedSubsectors;          // Bit per journal subsector known to be erased
+    uint8_t compactionHalf;             // Half written by current compaction
+    uint16_t compactionRecord;          // Next record of current compaction
+    static uint8_t readBuffer[JOURNAL_READ_CHUNK_SIZE];
+    static uint8_t pageBuffer[MT25Q_PAGE_SIZE];
+
+    bool readHeader(uint8_t half, uint32_t* headerGeneration);
+    void replay(uint8_t half);
+    void programPage(uint8_t half, uint16_t firstRecord, const uint8_t* page);
+    void eraseSubsector(uint8_t subsector);
+    bool isSubsectorErased(uint8_t subsector);
+    uint8_t getSubsectorOfRecord(uint8_t half, uint16_t record);
+};
+
+#endif
@@ -73,6 +73,13 @@ void KeylessCom::copyArray(char* arrA, char* arrB, uint8_t& arrAIdx, uint8_t max
   }
 }
 
+void KeylessCom::copyField(char* buffer, uint8_t& bufferIdx, EntryView* entry, uint8_t field)
+{
+  uint8_t fieldLength = entry->getFieldLength(field);
+  copy_n(entry->getField(field), fieldLength, &buffer[bufferIdx]);
+  bufferIdx += fieldLength;
+}
+
 void KeylessCom::parseEntryData(char* title, char* usr, char* email, char* pwd, char* url, uint8_t startFromIndex)
 {
   memset(title, 0, MAX_TITLE_LEN);
@@ -169,6 +176,13 @@ void KeylessCom::process()
 void KeylessCom::processCommand()
 {
   char response = NACK;
+
+  // Any other command ends a bulk import the PC did not finish
+  if(commandBuffer[0] != COMM_BULK_ADD && entryManager->isImportOpen())
+  {
+    entryManager->finishImport();
+  }
+
   if(commandBuffer[0] == COMM_GET_ACC_NUM)
   {
     uint16_t accountNumber = entryManager->getEntryCount();
@@ -193,20 +207,17 @@ void KeylessCom::processCommand()
   }
   else if(commandBuffer[0] == COMM_GET_ACC)
   {
-    uint8_t title[MAX_TITLE_LEN];
-    uint8_t usr[MAX_UNAME_LEN];
-    uint8_t email[MAX_EMAIL_LEN];
-    uint8_t pwd[MAX_PASSWORD_LEN];
-    uint8_t url[MAX_URL_LEN];
+    EntryView entry;
 
     uint16_t id = (commandBuffer[1] << 8) | commandBuffer[2];
-    serialComMutex.lock();
-    bool retVal = entryManager->getEntry(id, title, usr, email, pwd, url);
-    serialComMutex.unlock();
+    bool retVal = entryManager->readEntry(id, ENTRY_FIELDS_ALL, &entry);
 
     if(retVal)
     {
-      sendAccount(id, (char*)title, (char*)usr, (char*)email, (char*)pwd, (char*)url);    
+      if(sendAccount(&entry) == STATUS_OK)
+      {
+        entryManager->recordUse(id);
+      }
       return;  
     }
   }
@@ -220,19 +231,35 @@ void KeylessCom::processCommand()
 
     parseEntryData(title, usr, email, pwd, url, 1);
 
-    serialComMutex.lock();
     response = entryManager->addEntry(title, usr, email, pwd, url) ? ACK : NACK;
-    EntryManager::credentialInfo = entryManager->getEntriesTitleInfo();
-    serialComMutex.unlock();
+  }
+  else if(commandBuffer[0] == COMM_BULK_ADD)
+  {
+    if(commandBufferIdx == 1)
+    {
+      response = entryManager->finishImport() ? ACK : NACK;
+    }
+    else
+    {
+      char title[MAX_TITLE_LEN];
+      char usr[MAX_UNAME_LEN];
+      char email[MAX_EMAIL_LEN];
+      char pwd[MAX_PASSWORD_LEN];
+      char url[MAX_URL_LEN];
+
+      parseEntryData(title, usr, email, pwd, url, 1);
+
+      if(entryManager->isImportOpen() || entryManager->beginImport())
+      {
+        response = entryManager->importEntry(title, usr, email, pwd, url) ? ACK : NACK;
+      }
+    }
   }
   else if(commandBuffer[0] == COMM_REM_ACC)
   {
     uint16_t id = (commandBuffer[1] << 8) | commandBuffer[2];
 
-    serialComMutex.lock();
     response = entryManager->removeEntry(id) ? ACK : NACK;
-    EntryManager::credentialInfo = entryManager->getEntriesTitleInfo();
-    serialComMutex.unlock();
   }
   else if(commandBuffer[0] == COMM_EDIT_ACC)
   {
@@ -246,10 +273,37 @@ void KeylessCom::processCommand()
 
     uint16_t id = (commandBuffer[1] << 8) | commandBuffer[2];
 
-    serialComMutex.lock();
     response = entryManager->editEntry(id, title, usr, email, pwd, url) ? ACK : NACK;
-    EntryManager::credentialInfo = entryManager->getEntriesTitleInfo();
-    serialComMutex.unlock();
+  }
+  else if(commandBuffer[0] == COMM_FIND && commandBufferIdx >= 2)
+  {
+    uint8_t field = commandBuffer[1] == FIND_BY_TITLE ? ENTRY_FIELD_TITLE : ENTRY_FIELD_URL;
+
+    if(commandBuffer[1] == FIND_BY_TITLE || commandBuffer[1] == FIND_BY_DOMAIN)
+    {
+      vector<uint16_t> foundIds = entryManager->findEntries(field, &commandBuffer[2], commandBufferIdx - 2);
+
+      sendFoundIds(foundIds);
+      return;
+    }
+  }
+  else if(commandBuffer[0] == COMM_CHECK_INTEGRITY)
+  {
+    uint8_t progress;
+    uint32_t rootDigest;
+    vector<uint16_t> damagedSubsectors;
+    uint8_t status = entryManager->getIntegrityStatus(&progress, &rootDigest, &damagedSubsectors);
+
+    sendIntegrityStatus(status, progress, rootDigest, damagedSubsectors);
+    return;
+  }
+  else if(commandBuffer[0] == COMM_GET_STATS)
+  {
+    uint32_t stats[STATS_COUNT];
+    entryManager->getStats(stats);
+
+    sendStats(stats);
+    return;
   }
   else if(commandBuffer[0] == COMM_GET_UNIQUE_ID)
   {
@@ -270,23 +324,15 @@ void KeylessCom::processCommand()
   }
   else if(commandBuffer[0] == COMM_GET_ALL_ENTRIES)
   {
-    for(auto entry : entryManager->credentialInfo)
+    EntryView entry;
+    EntryScan scan;
+
+    entryManager->beginScan(&scan, 0);
+
+    // Entries come in flash order, pages of neighbouring entries are read with one burst
+    while(entryManager->readNextEntry(&scan, ENTRY_FIELDS_ALL, &entry))
     {
-      uint8_t title[MAX_TITLE_LEN];
-      uint8_t usr[MAX_UNAME_LEN];
-      uint8_t email[MAX_EMAIL_LEN];
-      uint8_t pwd[MAX_PASSWORD_LEN];
-      uint8_t url[MAX_URL_LEN];
-
-      uint16_t id = get<0>(entry);
-      serialComMutex.lock();
-      bool retVal = entryManager->getEntry(id, title, usr, email, pwd, url);
-      serialComMutex.unlock();
-
-      if(retVal)
-      {
-        sendAccount(id, (char*)title, (char*)usr, (char*)email, (char*)pwd, (char*)url);
-      }
+      sendAccount(&entry);
     }
     return;
   }
@@ -317,6 +363,96 @@ STATUS KeylessCom::sendAccountNumber(uint16_t accountNumber)
   return getResponse();
 }
 
+STATUS KeylessCom::sendFoundIds(const vector<uint16_t>& ids)
+{
+  uint8_t idCount = min<size_t>(ids.size(), MAX_FOUND_IDS);
+  char buffer[5 + MAX_FOUND_IDS * 2] =
+  {
+    COMM_BEGIN,
+    COMM_SEND_FOUND_IDS,
+    char((ids.size() & 0xFF00) >> 8),
+    char(ids.size() & 0xFF)
+  };
+
+  uint8_t bufferIdx = 4;
+
+  for(auto i = 0; i < idCount; i++)
+  {
+    buffer[bufferIdx++] = char((ids[i] & 0xFF00) >> 8);
+    buffer[bufferIdx++] = char(ids[i] & 0xFF);
+  }
+
+  buffer[bufferIdx++] = COMM_END;
+
+  serialComMutex.lock();
+  Serial.write(buffer, bufferIdx);
+  serialComMutex.unlock();
+
+  return STATUS_OK;
+}
+
+STATUS KeylessCom::sendIntegrityStatus(uint8_t status, uint8_t progress, uint32_t rootDigest, const vector<uint16_t>& damagedSubsectors)
+{
+  uint8_t subsectorCount = min<size_t>(damagedSubsectors.size(), MAX_DAMAGED_SUBSECTORS);
+  char buffer[11 + MAX_DAMAGED_SUBSECTORS * 2] =
+  {
+    COMM_BEGIN,
+    COMM_SEND_INTEGRITY,
+    char(status),
+    char(progress),
+    char((rootDigest >> 24) & 0xFF),
+    char((rootDigest >> 16) & 0xFF),
+    char((rootDigest >> 8) & 0xFF),
+    char(rootDigest & 0xFF),
+    char((damagedSubsectors.size() & 0xFF00) >> 8),
+    char(damagedSubsectors.size() & 0xFF)
+  };
+
+  uint8_t bufferIdx = 10;
+
+  for(auto i = 0; i < subsectorCount; i++)
+  {
+    buffer[bufferIdx++] = char((damagedSubsectors[i] & 0xFF00) >> 8);
+    buffer[bufferIdx++] = char(damagedSubsectors[i] & 0xFF);
+  }
+
+  buffer[bufferIdx++] = COMM_END;
+
+  serialComMutex.lock();
+  Serial.write(buffer, bufferIdx);
+  serialComMutex.unlock();
+
+  return STATUS_OK;
+}
+
+STATUS KeylessCom::sendStats(const uint32_t* stats)
+{
+  char buffer[4 + STATS_COUNT * 4] =
+  {
+    COMM_BEGIN,
+    COMM_SEND_STATS,
+    char(STATS_COUNT)
+  };
+
+  uint8_t bufferIdx = 3;
+
+  for(auto i = 0; i < STATS_COUNT; i++)
+  {
+    buffer[bufferIdx++] = char((stats[i] >> 24) & 0xFF);
+    buffer[bufferIdx++] = char((stats[i] >> 16) & 0xFF);
+    buffer[bufferIdx++] = char((stats[i] >> 8) & 0xFF);
+    buffer[bufferIdx++] = char(stats[i] & 0xFF);
+  }
+
+  buffer[bufferIdx++] = COMM_END;
+
+  serialComMutex.lock();
+  Serial.write(buffer, bufferIdx);
+  serialComMutex.unlock();
+
+  return STATUS_OK;
+}
+
 STATUS KeylessCom::sendAccount(uint16_t id, char title[MAX_TITLE_LEN], char usr[MAX_UNAME_LEN], char email[MAX_EMAIL_LEN], char pwd[MAX_PASSWORD_LEN], char url[MAX_URL_LEN])
 {
   char buffer[MAX_COMM_LEN] =
@@ -352,6 +488,47 @@ STATUS KeylessCom::sendAccount(uint16_t id, char title[MAX_TITLE_LEN], char usr[
   return getResponse();
 }
 
+STATUS KeylessCom::sendAccount(EntryView* entry)
+{
+  if(!entry->hasFields(ENTRY_FIELDS_ALL))
+  {
+    return STATUS_WRONG_PARAMETER;
+  }
+
+  uint16_t id = entry->getId();
+  char buffer[MAX_COMM_LEN] =
+  {
+    COMM_BEGIN,
+    COMM_SEND_ACC,
+    char((id & 0xFF00) >> 8),
+    char(id & 0x00FF)
+  };
+
+  uint8_t bufferIdx = 4;
+
+  copyField(buffer, bufferIdx, entry, ENTRY_FIELD_TITLE);
+  buffer[bufferIdx++] = US;
+  copyField(buffer, bufferIdx, entry, ENTRY_FIELD_USERNAME);
+  buffer[bufferIdx++] = US;
+  copyField(buffer, bufferIdx, entry, ENTRY_FIELD_EMAIL);
+  buffer[bufferIdx++] = US;
+  copyField(buffer, bufferIdx, entry, ENTRY_FIELD_PASSWORD);
+  buffer[bufferIdx++] = US;
+  copyField(buffer, bufferIdx, entry, ENTRY_FIELD_URL);
+  buffer[bufferIdx++] = COMM_END;
+
+  serialComMutex.lock();
+  Serial.write(buffer, bufferIdx);
+  serialComMutex.unlock();
+
+  if(checkForTimeout() == STATUS_TIMEOUT)
+  {
+    return STATUS_TIMEOUT;
+  }
+
+  return getResponse();
+}
+
 STATUS KeylessCom::typeKeyboard(char keys[128], uint8_t size)
 {
   if(size > 128)
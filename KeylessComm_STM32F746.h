@@ -73,6 +73,59 @@ class KeylessCom
 		 */
 		STATUS sendAccount(uint16_t id, char title[MAX_TITLE_LEN], char usr[MAX_UNAME_LEN], char email[MAX_EMAIL_LEN], char pwd[MAX_PASSWORD_LEN], char url[MAX_URL_LEN]);
 
+		/*+
+		 * sendAccount sends an account information dataset read with EntryManager::readEntry() to the PC.
+		 * Fields are taken from the view in place, so the entry must be read with ENTRY_FIELDS_ALL.
+		 *
+		 * Inputs:
+		 * 	entry - The view holding the account.
+		 *
+		 * returns:
+		 *	STATUS - The status of the transmission as enum.
+		 */
+		STATUS sendAccount(EntryView* entry);
+
+		/*+
+		 * sendFoundIds sends the ids found by a COMM_FIND query to the PC.
+		 * Only the first MAX_FOUND_IDS ids are sent, the total count tells the PC if the query should be narrowed.
+		 * No acknowledge is expected, so a lookup takes a single round trip.
+		 *
+		 * Inputs:
+		 *	ids - The ids of all matching entries.
+		 *
+		 * returns:
+		 *	STATUS - The status of the transmission as enum.
+		 */
+		STATUS sendFoundIds(const vector<uint16_t>& ids);
+
+		/*+
+		 * sendIntegrityStatus sends the result of the integrity check of the entry log to the PC.
+		 * Only the first MAX_DAMAGED_SUBSECTORS damaged subsectors are sent along with their total count.
+		 * No acknowledge is expected.
+		 *
+		 * Inputs:
+		 *	status - INTEGRITY_STATUS_OK, INTEGRITY_STATUS_DAMAGED or INTEGRITY_STATUS_CHECKING.
+		 *	progress - Progress of a running check in percent.
+		 *	rootDigest - Root digest of the integrity index.
+		 *	damagedSubsectors - The entry log subsectors not matching their digest.
+		 *
+		 * returns:
+		 *	STATUS - The status of the transmission as enum.
+		 */
+		STATUS sendIntegrityStatus(uint8_t status, uint8_t progress, uint32_t rootDigest, const vector<uint16_t>& damagedSubsectors);
+
+		/*+
+		 * sendStats sends counters of flash and cache use to the PC, e.g. to check cache hit rates on a device.
+		 * No acknowledge is expected.
+		 *
+		 * Inputs:
+		 *	stats - STATS_COUNT counters read with EntryManager::getStats().
+		 *
+		 * returns:
+		 *	STATUS - The status of the transmission as enum.
+		 */
+		STATUS sendStats(const uint32_t* stats);
+
 		/*+
 		 * typeKeyboard makes the ATMEGA32U4 type something on the PC via USB HID Keyboard emulation.
 		 * It accepts any combination of standard ASCII keys with a maximum of 128 sequential keystrokes.
@@ -87,13 +140,14 @@ class KeylessCom
 		STATUS typeKeyboard(char keys[128], uint8_t size = 0);
 
     static BufferedSerial Serial;
-    static Mutex serialComMutex;
+    static Mutex serialComMutex;   // Guards UART only, EntryManager does its own locking
     
 	private:
     char getByte();
     void writeResponse(const char response);
     void processCommand();
     void copyArray(char* arrA, char* arrB, uint8_t& arrAIdx, uint8_t maxLength);
+    void copyField(char* buffer, uint8_t& bufferIdx, EntryView* entry, uint8_t field);
     void parseEntryData(char* title, char* usr, char* email, char* pwd, char* url, uint8_t startFromIndex);
     STATUS checkForTimeout();
     STATUS getResponse();
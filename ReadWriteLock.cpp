@@ -0,0 +1,138 @@
+#include "ReadWriteLock.h"
+
+/*
+  ReadWriteLock(void) initializes an unlocked lock.
+*/
+ReadWriteLock::ReadWriteLock(void) : released(stateMutex)
+{
+  readerCount = 0;
+  writer = NULL;
+  writerDepth = 0;
+}
+
+/*
+  void lockShared(void) waits until no other thread holds the lock exclusively and takes it shared.
+*/
+void ReadWriteLock::lockShared(void)
+{
+  stateMutex.lock();
+
+  if(writer == ThisThread::get_id())
+  {
+    writerDepth++;
+    stateMutex.unlock();
+    return;
+  }
+
+  while(writer != NULL)
+  {
+    released.wait();
+  }
+
+  readerCount++;
+
+  stateMutex.unlock();
+}
+
+/*
+  void unlockShared(void) releases lock taken by lockShared().
+*/
+void ReadWriteLock::unlockShared(void)
+{
+  stateMutex.lock();
+
+  if(writer == ThisThread::get_id())
+  {
+    writerDepth--;
+    stateMutex.unlock();
+    return;
+  }
+
+  readerCount--;
+
+  if(readerCount == 0)
+  {
+    released.notify_all();
+  }
+
+  stateMutex.unlock();
+}
+
+/*
+  void lock(void) waits until no other thread holds the lock and takes it exclusively.
+*/
+void ReadWriteLock::lock(void)
+{
+  stateMutex.lock();
+
+  osThreadId_t current = ThisThread::get_id();
+
+  if(writer == current)
+  {
+    writerDepth++;
+    stateMutex.unlock();
+    return;
+  }
+
+  while(writer != NULL || readerCount > 0)
+  {
+    released.wait();
+  }
+
+  writer = current;
+  writerDepth = 1;
+
+  stateMutex.unlock();
+}
+
+/*
+  void unlock(void) releases lock taken by lock().
+*/
+void ReadWriteLock::unlock(void)
+{
+  stateMutex.lock();
+
+  writerDepth--;
+
+  if(writerDepth == 0)
+  {
+    writer = NULL;
+    released.notify_all();
+  }
+
+  stateMutex.unlock();
+}
+
+/*
+  ReadLock(ReadWriteLock*) takes given lock shared.
+*/
+ReadLock::ReadLock(ReadWriteLock* lock)
+{
+  this->lock = lock;
+  lock->lockShared();
+}
+
+/*
+  ~ReadLock(void) releases lock.
+*/
+ReadLock::~ReadLock(void)
+{
+  lock->unlockShared();
+}
+
+/*
+  WriteLock(ReadWriteLock*) takes given lock exclusively.
+*/
+WriteLock::WriteLock(ReadWriteLock* lock)
+{
+  this->lock = lock;
+  lock->lock();
+}
+
+/*
+  ~WriteLock(void) releases lock.
+*/
+WriteLock::~WriteLock(void)
+{
+  lock->unlock();
+}
@@ -0,0 +1,58 @@
+#include "mbed.h"
+#include <cstdint>
+
+#ifndef READ_WRITE_LOCK_H
+#define READ_WRITE_LOCK_H
+
+/*
+  ReadWriteLock lets any number of threads hold it shared (readers) or one thread hold it exclusively (writer).
+
+  Readers are preferred: a new reader only waits for an active writer, not for a waiting one. So a thread
+  already holding the lock shared may take it shared again. The writer may take the lock again, both shared and
+  exclusive, which is then counted as nested ownership. Upgrading a shared lock to an exclusive one deadlocks,
+  the exclusive lock has to be taken first.
+*/
+class ReadWriteLock
+{
+  public:
+    ReadWriteLock(void);
+    void lockShared(void);
+    void unlockShared(void);
+    void lock(void);
+    void unlock(void);
+
+  private:
+    Mutex stateMutex;
+    ConditionVariable released;
+    uint16_t readerCount;
+    osThreadId_t writer;      // Thread holding lock exclusively, NULL if none
+    uint16_t writerDepth;     // Nested lock calls of writer
+};
+
+/*
+  ReadLock holds given ReadWriteLock shared until the end of its scope.
+*/
+class ReadLock
+{
+  public:
+    ReadLock(ReadWriteLock* lock);
+    ~ReadLock(void);
+
+  private:
+    ReadWriteLock* lock;
+};
+
+/*
+  WriteLock holds given ReadWriteLock exclusively until the end of its scope.
+*/
+class WriteLock
+{
+  public:
+    WriteLock(ReadWriteLock* lock);
+    ~WriteLock(void);
+
+  private:
+    ReadWriteLock* lock;
+};
+
+#endif
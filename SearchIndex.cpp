@@ -0,0 +1,239 @@
+#include "SearchIndex.h"
+#include <algorithm>
+#include <cctype>
+
+#define SEARCH_KEY(key, id)           (((uint32_t)(key) << SEARCH_ID_BITS) | ((id) & SEARCH_ID_MASK))
+
+/*
+  void clear(void) drops all keys and frees their memory.
+*/
+void SearchIndex::clear(void)
+{
+  vector<uint32_t>().swap(titleKeys);
+  vector<uint32_t>().swap(domainKeys);
+}
+
+/*
+  void insert(uint16_t, const char*, uint8_t, const char*, uint8_t) adds keys of an entry. Entry must not be
+  in the index already, edited entries are removed first.
+*/
+void SearchIndex::insert(uint16_t id, const char* title, uint8_t titleLength, const char* url, uint8_t urlLength)
+{
+  char domain[UINT8_MAX];
+  uint8_t domainLength = normalizeDomain(url, urlLength, domain);
+
+  insertKey(titleKeys, getTitleKey(title, titleLength), id);
+  insertKey(domainKeys, getDomainKey(domain, domainLength), id);
+}
+
+/*
+  void remove(uint16_t) drops keys of an entry. Keys are searched by id, so the old fields are not needed.
+*/
+void SearchIndex::remove(uint16_t id)
+{
+  removeId(titleKeys, id);
+  removeId(domainKeys, id);
+}
+
+/*
+  bool findTitlePrefix(const char*, uint8_t, vector<uint16_t>&) appends ids of entries whose title may start
+  with given prefix (case insensitive).
+
+  Returns true if every candidate is a match, which is the case for prefixes of up to SEARCH_TITLE_KEY_CHARS
+  letters and digits.
+*/
+bool SearchIndex::findTitlePrefix(const char* prefix, uint8_t prefixLength, vector<uint16_t>& candidates)
+{
+  uint8_t keyChars = min<uint8_t>(prefixLength, SEARCH_TITLE_KEY_CHARS);
+  uint8_t freeBits = (SEARCH_TITLE_KEY_CHARS - keyChars) * 6;
+  bool isExact = prefixLength <= SEARCH_TITLE_KEY_CHARS;
+
+  uint32_t firstKey = 0;
+  for(uint8_t i = 0; i < keyChars; i++)
+  {
+    uint8_t folded = foldTitleChar(prefix[i]);
+    firstKey = (firstKey << 6) | folded;
+
+    // Other characters share their folded value
+    isExact &= folded <= 36;
+  }
+
+  firstKey <<= freeBits;
+  findKeys(titleKeys, firstKey, firstKey | ((1 << freeBits) - 1), candidates);
+
+  return isExact;
+}
+
+/*
+  void findDomain(const char*, uint8_t, vector<uint16_t>&) appends ids of entries whose URL may have given
+  normalized domain (see normalizeDomain()). Candidates always have to be checked, domains share hash values.
+*/
+void SearchIndex::findDomain(const char* domain, uint8_t domainLength, vector<uint16_t>& candidates)
+{
+  uint32_t key = getDomainKey(domain, domainLength);
+  findKeys(domainKeys, key, key, candidates);
+}
+
+/*
+  bool matchesTitlePrefix(const char*, uint8_t, const char*, uint8_t) returns true if title starts with prefix,
+  ignoring case of ASCII letters.
+*/
+bool SearchIndex::matchesTitlePrefix(const char* title, uint8_t titleLength, const char* prefix, uint8_t prefixLength)
+{
+  if(prefixLength > titleLength)
+  {
+    return false;
+  }
+
+  for(uint8_t i = 0; i < prefixLength; i++)
+  {
+    if(tolower((uint8_t)title[i]) != tolower((uint8_t)prefix[i]))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/*
+  uint8_t normalizeDomain(const char*, uint8_t, char*) writes lower case host of given URL to domain buffer
+  (at least urlLength bytes), e.g. "https://www.Example.com/login" becomes "example.com". Scheme, user info,
+  leading "www.", port and path are dropped. Plain domains are passed through the same way.
+
+  Returns length of domain.
+*/
+uint8_t SearchIndex::normalizeDomain(const char* url, uint8_t urlLength, char* domain)
+{
+  uint8_t start = 0;
+
+  for(uint8_t i = 0; i + 2 < urlLength && url[i] != '/'; i++)
+  {
+    if(url[i] == ':' && url[i + 1] == '/' && url[i + 2] == '/')
+    {
+      start = i + 3;
+      break;
+    }
+  }
+
+  uint8_t end = start;
+  while(end < urlLength && url[end] != '\0' && url[end] != '/' && url[end] != '?' && url[end] != '#')
+  {
+    if(url[end] == '@')
+    {
+      start = end + 1;
+    }
+
+    end++;
+  }
+
+  if(end - start > 4 && tolower((uint8_t)url[start]) == 'w' && tolower((uint8_t)url[start + 1]) == 'w' &&
+    tolower((uint8_t)url[start + 2]) == 'w' && url[start + 3] == '.')
+  {
+    start += 4;
+  }
+
+  uint8_t domainLength = 0;
+  for(uint8_t i = start; i < end && url[i] != ':'; i++)
+  {
+    domain[domainLength++] = tolower((uint8_t)url[i]);
+  }
+
+  while(domainLength > 0 && domain[domainLength - 1] == '.')
+  {
+    domainLength--;
+  }
+
+  return domainLength;
+}
+
+/*
+  uint8_t foldTitleChar(char) maps title character to 6 bits: 0 for end of title, 1..36 for digits and
+  letters (case insensitive), 37..63 shared by all other characters.
+*/
+uint8_t SearchIndex::foldTitleChar(char c)
+{
+  if(c >= '0' && c <= '9')
+  {
+    return 1 + (c - '0');
+  }
+
+  if(c >= 'a' && c <= 'z')
+  {
+    return 11 + (c - 'a');
+  }
+
+  if(c >= 'A' && c <= 'Z')
+  {
+    return 11 + (c - 'A');
+  }
+
+  return 37 + ((uint8_t)c % 27);
+}
+
+/*
+  uint32_t getTitleKey(const char*, uint8_t) returns folded first SEARCH_TITLE_KEY_CHARS characters of title.
+*/
+uint32_t SearchIndex::getTitleKey(const char* title, uint8_t titleLength)
+{
+  uint32_t key = 0;
+
+  for(uint8_t i = 0; i < SEARCH_TITLE_KEY_CHARS; i++)
+  {
+    key = (key << 6) | (i < titleLength ? foldTitleChar(title[i]) : 0);
+  }
+
+  return key;
+}
+
+/*
+  uint32_t getDomainKey(const char*, uint8_t) returns FNV-1a hash of normalized domain, folded to
+  SEARCH_KEY_BITS bits.
+*/
+uint32_t SearchIndex::getDomainKey(const char* domain, uint8_t domainLength)
+{
+  uint32_t hash = 2166136261;
+
+  for(uint8_t i = 0; i < domainLength; i++)
+  {
+    hash = (hash ^ (uint8_t)domain[i]) * 16777619;
+  }
+
+  return (hash ^ (hash >> SEARCH_KEY_BITS)) & ((1 << SEARCH_KEY_BITS) - 1);
+}
+
+/*
+  void insertKey(vector<uint32_t>&, uint32_t, uint16_t) inserts key of id at its sorted position.
+*/
+void SearchIndex::insertKey(vector<uint32_t>& keys, uint32_t key, uint16_t id)
+{
+  uint32_t value = SEARCH_KEY(key, id);
+  keys.insert(lower_bound(keys.begin(), keys.end(), value), value);
+}
+
+/*
+  void removeId(vector<uint32_t>&, uint16_t) erases key of given id.
+*/
+void SearchIndex::removeId(vector<uint32_t>& keys, uint16_t id)
+{
+  auto it = find_if(keys.begin(), keys.end(), [id](uint32_t value) { return (value & SEARCH_ID_MASK) == id; });
+
+  if(it != keys.end())
+  {
+    keys.erase(it);
+  }
+}
+
+/*
+  void findKeys(vector<uint32_t>&, uint32_t, uint32_t, vector<uint16_t>&) appends ids of all keys in given range.
+*/
+void SearchIndex::findKeys(vector<uint32_t>& keys, uint32_t firstKey, uint32_t lastKey, vector<uint16_t>& candidates)
+{
+  auto it = lower_bound(keys.begin(), keys.end(), SEARCH_KEY(firstKey, 0));
+  auto end = upper_bound(it, keys.end(), SEARCH_KEY(lastKey, SEARCH_ID_MASK));
+
+  for(; it != end; it++)
+  {
+    candidates.push_back(*it & SEARCH_ID_MASK);
+  }
+}
@@ -0,0 +1,47 @@
+#include "mbed.h"
+#include <cstdint>
+#include <vector>
+
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#define SEARCH_ID_BITS                14      // Ids below MAX_ENTRY_COUNT (4095) fit into 14 bits
+#define SEARCH_ID_MASK                0x3FFF
+#define SEARCH_KEY_BITS               18      // Title key (3 folded characters) or domain hash in front of id
+#define SEARCH_TITLE_KEY_CHARS        3       // Leading title characters in title key (6 bits each)
+
+/*
+  SearchIndex is a RAM index over the plaintext fields of all entries, used to look up entries by title prefix
+  or URL domain without reading every entry.
+
+  Every entry has one key in each of two sorted arrays: its first title characters folded to 6 bits each and a
+  hash of its normalized URL domain. Key and id are packed into a single word ([KEY 18 bits] [ID 14 bits]), so
+  an entry costs 8 bytes of RAM and a lookup is a binary search.
+
+  Keys are not unique, so found ids are only candidates. Callers have to compare the actual field unless
+  findTitlePrefix() reports the match as exact.
+*/
+class SearchIndex
+{
+  public:
+    void clear(void);
+    void insert(uint16_t id, const char* title, uint8_t titleLength, const char* url, uint8_t urlLength);
+    void remove(uint16_t id);
+    bool findTitlePrefix(const char* prefix, uint8_t prefixLength, vector<uint16_t>& candidates);
+    void findDomain(const char* domain, uint8_t domainLength, vector<uint16_t>& candidates);
+    static bool matchesTitlePrefix(const char* title, uint8_t titleLength, const char* prefix, uint8_t prefixLength);
+    static uint8_t normalizeDomain(const char* url, uint8_t urlLength, char* domain);
+
+  private:
+    vector<uint32_t> titleKeys;
+    vector<uint32_t> domainKeys;
+
+    static uint8_t foldTitleChar(char c);
+    static uint32_t getTitleKey(const char* title, uint8_t titleLength);
+    static uint32_t getDomainKey(const char* domain, uint8_t domainLength);
+    static void insertKey(vector<uint32_t>& keys, uint32_t key, uint16_t id);
+    static void removeId(vector<uint32_t>& keys, uint16_t id);
+    static void findKeys(vector<uint32_t>& keys, uint32_t firstKey, uint32_t lastKey, vector<uint16_t>& candidates);
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "mbed.h"
+#include <cstdint>
+#include <algorithm>
+
+#ifndef SLOT_INDEX_H
+#define SLOT_INDEX_H
+
+#define SLOT_INDEX_UNUSED 0xFFFF  // Id of an unused slot, slot of an id not stored
+
+/*
+  SlotIndex keeps the address table in RAM, the id stored in every slot as 2 big-endian bytes like in flash, and
+  an index from id to slot beside it. So the slot of an id is found with a single array access instead of
+  walking all slots of the table. setIdAtSlot() keeps both in sync.
+
+  The table is written to flash as it is, see getTable(). Ids of IdCount or above may be read from a damaged
+  table, they are kept in their slot but not indexed.
+*/
+template<uint16_t SlotCount, uint16_t IdCount>
+class SlotIndex
+{
+  public:
+    SlotIndex(void)
+    {
+      clear();
+    }
+
+    /*
+      void clear(void) marks every slot as unused.
+    */
+    void clear(void)
+    {
+      fill_n(table, SlotCount * 2, 0xFF);
+      fill_n(slotOfId, IdCount, SLOT_INDEX_UNUSED);
+    }
+
+    /*
+      uint8_t* getTable(void) returns table of 2 bytes per slot. After it was changed directly, e.g. loaded from
+      flash, rebuild() has to be called.
+    */
+    uint8_t* getTable(void)
+    {
+      return table;
+    }
+
+    /*
+      void rebuild(uint16_t) rebuilds index from given count of first slots, later slots are not indexed.
+    */
+    void rebuild(uint16_t slotCount)
+    {
+      fill_n(slotOfId, IdCount, SLOT_INDEX_UNUSED);
+
+      for(uint16_t slot = 0; slot < min(slotCount, SlotCount); slot++)
+      {
+        uint16_t id = getIdAtSlot(slot);
+
+        if(id < IdCount)
+        {
+          slotOfId[id] = slot;
+        }
+      }
+    }
+
+    uint16_t getIdAtSlot(uint16_t slot)
+    {
+      return (table[slot * 2] << 8) | table[(slot * 2) + 1];
+    }
+
+    /*
+      uint16_t getSlotOfId(uint16_t) returns slot holding given id.
+
+      Returns SLOT_INDEX_UNUSED if id is not stored.
+    */
+    uint16_t getSlotOfId(uint16_t id)
+    {
+      return id < IdCount ? slotOfId[id] : SLOT_INDEX_UNUSED;
+    }
+
+    /*
+      uint16_t setIdAtSlot(uint16_t, uint16_t) writes id to given slot and moves it in the index. Passing
+      SLOT_INDEX_UNUSED as id frees the slot.
+
+      Returns id held by the slot before.
+    */
+    uint16_t setIdAtSlot(uint16_t slot, uint16_t id)
+    {
+      uint16_t oldId = getIdAtSlot(slot);
+
+      if(oldId < IdCount)
+      {
+        slotOfId[oldId] = SLOT_INDEX_UNUSED;
+      }
+
+      table[slot * 2] = (id & 0xFF00) >> 8;
+      table[(slot * 2) + 1] = id & 0xFF;
+
+      if(id < IdCount)
+      {
+        slotOfId[id] = slot;
+      }
+
+      return oldId;
+    }
+
+  private:
+    uint8_t table[SlotCount * 2];
+    uint16_t slotOfId[IdCount];
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include "mbed.h"
+#include <cstdint>
+#include <utility>
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+template<typename T>
+class SnapshotPublisher;
+
+/*
+  SnapshotVersion holds one published value of a SnapshotPublisher and counts the Snapshot handles (and the
+  publisher itself) still referring to it. The last one to let go deletes it.
+*/
+template<typename T>
+struct SnapshotVersion
+{
+  T value;
+  uint32_t version;
+  uint32_t references;
+};
+
+/*
+  Snapshot is a read handle on one immutable version of a published value. The value stays valid and unchanged
+  as long as the handle exists, even if a newer version gets published meanwhile.
+*/
+template<typename T>
+class Snapshot
+{
+  public:
+    Snapshot(const Snapshot& other)
+    {
+      current = other.current;
+      core_util_atomic_incr_u32(&current->references, 1);
+    }
+
+    ~Snapshot(void)
+    {
+      release(current);
+    }
+
+    Snapshot& operator=(Snapshot other)
+    {
+      swap(current, other.current);
+      return *this;
+    }
+
+    const T& operator*(void) const
+    {
+      return current->value;
+    }
+
+    const T* operator->(void) const
+    {
+      return &current->value;
+    }
+
+    /*
+      uint32_t getVersion(void) returns number of this version, see SnapshotPublisher::getVersion().
+    */
+    uint32_t getVersion(void) const
+    {
+      return current->version;
+    }
+
+    /*
+      static void release(SnapshotVersion<T>*) drops one reference to given version and deletes it if it was
+      the last one.
+    */
+    static void release(SnapshotVersion<T>* version)
+    {
+      if(core_util_atomic_decr_u32(&version->references, 1) == 0)
+      {
+        delete version;
+      }
+    }
+
+  private:
+    friend class SnapshotPublisher<T>;
+
+    SnapshotVersion<T>* current;
+
+    Snapshot(SnapshotVersion<T>* current)
+    {
+      this->current = current;
+    }
+};
+
+/*
+  SnapshotPublisher shares a value between one writer and any number of reader threads in RCU style.
+
+  Readers take a Snapshot of the current version without a mutex and without copying the value. The writer
+  builds the next version on the side and swaps it in with publish(). Readers still holding an older version
+  keep using it undisturbed, it is deleted when the last of them lets go.
+
+  Only the pointer swap and the reference count increment of read() run in a critical section of a few
+  instructions, so a reader never picks up a version which is deleted at the same time.
+*/
+template<typename T>
+class SnapshotPublisher
+{
+  public:
+    SnapshotPublisher(void)
+    {
+      current = new SnapshotVersion<T>{T(), 0, 1};
+      version = 0;
+    }
+
+    ~SnapshotPublisher(void)
+    {
+      Snapshot<T>::release(current);
+    }
+
+    /*
+      Snapshot<T> read(void) returns handle on current version.
+    */
+    Snapshot<T> read(void)
+    {
+      core_util_critical_section_enter();
+      SnapshotVersion<T>* version = current;
+      core_util_atomic_incr_u32(&version->references, 1);
+      core_util_critical_section_exit();
+
+      return Snapshot<T>(version);
+    }
+
+    /*
+      void publish(T&&) makes given value the current version. Readers taking a snapshot afterwards see the new
+      value, older snapshots stay as they are.
+    */
+    void publish(T&& value)
+    {
+      SnapshotVersion<T>* next = new SnapshotVersion<T>{move(value), version + 1, 1};
+
+      core_util_critical_section_enter();
+      SnapshotVersion<T>* previous = current;
+      current = next;
+      version = next->version;
+      core_util_critical_section_exit();
+
+      // Outside critical section, deleting the value may take a while
+      Snapshot<T>::release(previous);
+    }
+
+    /*
+      uint32_t getVersion(void) returns number of current version, which is incremented by every publish().
+    */
+    uint32_t getVersion(void)
+    {
+      return version;
+    }
+
+  private:
+    SnapshotVersion<T>* volatile current;
+    volatile uint32_t version;
+};
+
+#endif
@@ -0,0 +1,245 @@
+#include "UsageLog.h"
+#include <algorithm>
+
+/*
+  UsageLog(MT25Q*) initializes class, mount() loads the counts.
+*/
+UsageLog::UsageLog(MT25Q* flashMemory) : Journal(flashMemory, USAGE_LOG_START_ADDRESS, USAGE_LOG_HALF_SUBSECTORS, USAGE_LOG_RECORD_SIZE)
+{
+}
+
+/*
+  void encodeRecord(uint8_t*, uint32_t) builds record of given value ([ID] [BASE] or [HEADER] [GENERATION]) with
+  check byte and unused tally.
+*/
+void UsageLog::encodeRecord(uint8_t* record, uint32_t value)
+{
+  record[0] = (value >> 24) & 0xFF;
+  record[1] = (value >> 16) & 0xFF;
+  record[2] = (value >> 8) & 0xFF;
+  record[3] = value & 0xFF;
+  record[4] = getRecordCheck(record, 4);
+  fill_n(&record[5], USAGE_LOG_TALLY_BITS / 8, 0xFF);
+}
+
+/*
+  void encodeHeader(uint8_t*, uint32_t) builds header record of a log half with given generation.
+*/
+void UsageLog::encodeHeader(uint8_t* record, uint32_t headerGeneration)
+{
+  encodeRecord(record, (USAGE_LOG_HEADER << 24) | (headerGeneration & 0xFFFFFF));
+}
+
+/*
+  uint32_t getHeaderGeneration(const uint8_t*) returns generation stored in given header record.
+*/
+uint32_t UsageLog::getHeaderGeneration(const uint8_t* record)
+{
+  return (record[1] << 16) | (record[2] << 8) | record[3];
+}
+
+/*
+  void mount(void) loads counts from the half with the newest valid header. Without a valid half every count
+  is 0 and the first use starts the log.
+*/
+void UsageLog::mount(void)
+{
+  counters.clear();
+  mountJournal();
+}
+
+/*
+  void replayRecord(uint16_t, const uint8_t*) applies given record while mounting. Newer records of an entry
+  replace older ones, records with base 0 and unused tally reset the count of their entry.
+*/
+void UsageLog::replayRecord(uint16_t index, const uint8_t* record)
+{
+  uint16_t id = (record[0] << 8) | record[1];
+  uint16_t base = (record[2] << 8) | record[3];
+
+  // Skip records torn by power loss
+  if(getRecordCheck(record, 4) != record[4] || id >= MAX_ENTRY_COUNT)
+  {
+    return;
+  }
+
+  uint8_t usedTally = 0;
+  for(uint8_t j = 0; j < USAGE_LOG_TALLY_BITS / 8; j++)
+  {
+    usedTally += 8 - __builtin_popcount(record[5 + j]);
+  }
+
+  auto counter = findCounter(id);
+  bool isCounted = counter != counters.end() && get<0>(*counter) == id;
+  uint16_t count = min<uint32_t>(base + usedTally, USAGE_LOG_MAX_COUNT);
+
+  if(count == 0)
+  {
+    if(isCounted)
+    {
+      counters.erase(counter);
+    }
+  }
+  else if(isCounted)
+  {
+    *counter = make_tuple(id, count, index, usedTally);
+  }
+  else
+  {
+    counters.insert(counter, make_tuple(id, count, index, usedTally));
+  }
+}
+
+/*
+  void format(void) drops all counts. Headers of both halves are erased, so no old count is loaded again.
+*/
+void UsageLog::format(void)
+{
+  counters.clear();
+  formatJournal();
+}
+
+/*
+  bool increment(uint16_t) counts one use of given entry. Usually a single tally bit is cleared, every
+  USAGE_LOG_TALLY_BITS uses a record is appended.
+
+  Returns false if count is already at USAGE_LOG_MAX_COUNT.
+*/
+bool UsageLog::increment(uint16_t id)
+{
+  auto counter = findCounter(id);
+  bool isCounted = counter != counters.end() && get<0>(*counter) == id;
+
+  if(isCounted && get<1>(*counter) == USAGE_LOG_MAX_COUNT)
+  {
+    return false;
+  }
+
+  if(isCounted && get<3>(*counter) < USAGE_LOG_TALLY_BITS)
+  {
+    programTallyBit(get<2>(*counter), get<3>(*counter));
+    get<1>(*counter)++;
+    get<3>(*counter)++;
+    return true;
+  }
+
+  if(!isCounted)
+  {
+    counter = counters.insert(counter, make_tuple(id, 0, USAGE_LOG_NO_RECORD, 0));
+  }
+
+  get<1>(*counter)++;
+
+  uint16_t count = get<1>(*counter);
+  uint16_t record = appendRecord(id, count);
+
+  // Compaction has written the count (or dropped it) and updated every record index already
+  if(record != USAGE_LOG_NO_RECORD)
+  {
+    counter = findCounter(id);
+    get<2>(*counter) = record;
+    get<3>(*counter) = 0;
+  }
+
+  return true;
+}
+
+/*
+  void reset(uint16_t) sets count of given entry back to 0, e.g. after it was removed and its id may be taken
+  by a new entry.
+*/
+void UsageLog::reset(uint16_t id)
+{
+  auto counter = findCounter(id);
+
+  if(counter == counters.end() || get<0>(*counter) != id)
+  {
+    return;
+  }
+
+  counters.erase(counter);
+  appendRecord(id, 0);
+}
+
+/*
+  uint16_t getCount(uint16_t) returns count of uses of given entry.
+*/
+uint16_t UsageLog::getCount(uint16_t id)
+{
+  auto counter = findCounter(id);
+  return (counter != counters.end() && get<0>(*counter) == id) ? get<1>(*counter) : 0;
+}
+
+/*
+  vector<...>::iterator findCounter(uint16_t) returns counter of given id or position to insert it at.
+*/
+vector<tuple<uint16_t, uint16_t, uint16_t, uint8_t>>::iterator UsageLog::findCounter(uint16_t id)
+{
+  return lower_bound(counters.begin(), counters.end(), id,
+    [](const tuple<uint16_t, uint16_t, uint16_t, uint8_t>& counter, uint16_t id) { return get<0>(counter) < id; });
+}
+
+/*
+  uint16_t appendRecord(uint16_t, uint16_t) programs record with given base count at log head. A full or missing
+  log is compacted instead, which writes the counts kept in RAM.
+
+  Returns index of programmed record, USAGE_LOG_NO_RECORD if log was compacted.
+*/
+uint16_t UsageLog::appendRecord(uint16_t id, uint16_t base)
+{
+  uint8_t record[USAGE_LOG_RECORD_SIZE];
+  encodeRecord(record, ((uint32_t)id << 16) | base);
+
+  if(!appendJournalRecord(record))
+  {
+    return USAGE_LOG_NO_RECORD;
+  }
+
+  return nextRecord - 1;
+}
+
+/*
+  void programTallyBit(uint16_t, uint8_t) clears given tally bit of record in active half. Only this bit is
+  programmed, the rest of the page stays as it is.
+*/
+void UsageLog::programTallyBit(uint16_t record, uint8_t bit)
+{
+  uint32_t recordAddr = getRecordAddress(activeHalf, record);
+  uint8_t page[MT25Q_PAGE_SIZE];
+  fill_n(page, MT25Q_PAGE_SIZE, 0xFF);
+  page[recordAddr % MT25Q_PAGE_SIZE + 5 + bit / 8] = ~(0x80 >> (bit % 8));
+
+  flashMemory->writeBytes(recordAddr & ~(MT25Q_PAGE_SIZE - 1), page);
+}
+
+/*
+  void compact(void) writes one record per counted entry into the other half and makes it the active half.
+  Only the USAGE_LOG_COMPACT_RECORDS most used entries are kept, so compaction leaves room for appending.
+*/
+void UsageLog::compact(void)
+{
+  if(counters.size() > USAGE_LOG_COMPACT_RECORDS)
+  {
+    // Most used first, ties go to lower ids, so exactly USAGE_LOG_COMPACT_RECORDS counters are kept
+    nth_element(counters.begin(), counters.begin() + USAGE_LOG_COMPACT_RECORDS, counters.end(),
+      [](const tuple<uint16_t, uint16_t, uint16_t, uint8_t>& a, const tuple<uint16_t, uint16_t, uint16_t, uint8_t>& b)
+      {
+        return get<1>(a) != get<1>(b) ? get<1>(a) > get<1>(b) : get<0>(a) < get<0>(b);
+      });
+
+    counters.resize(USAGE_LOG_COMPACT_RECORDS);
+    sort(counters.begin(), counters.end());
+  }
+
+  beginCompaction();
+
+  for(auto& counter : counters)
+  {
+    uint8_t record[USAGE_LOG_RECORD_SIZE];
+    encodeRecord(record, ((uint32_t)get<0>(counter) << 16) | get<1>(counter));
+    get<2>(counter) = addCompactedRecord(record);
+    get<3>(counter) = 0;
+  }
+
+  finishCompaction();
+}
@@ -0,0 +1,52 @@
+#include "MT25Q.h"
+#include "EntryManager.h"
+#include "Journal.h"
+#include <cstdint>
+#include <vector>
+#include <tuple>
+
+#ifndef USAGE_LOG_H
+#define USAGE_LOG_H
+
+#define USAGE_LOG_RECORD_SIZE         8       // [ID 2 bytes] [BASE 2 bytes] [CHECK] [TALLY 3 bytes]
+#define USAGE_LOG_TALLY_BITS          24      // Uses counted by clearing tally bits of a record
+#define USAGE_LOG_HEADER              0xA5    // First record of a log half, followed by its generation (3 bytes)
+#define USAGE_LOG_HALF_RECORDS        (USAGE_LOG_HALF_SUBSECTORS * MT25Q_SUBSECTOR_SIZE / USAGE_LOG_RECORD_SIZE)
+#define USAGE_LOG_COMPACT_RECORDS     (USAGE_LOG_HALF_RECORDS / 2)  // Most used entries kept by compaction, rest starts over at 0
+#define USAGE_LOG_MAX_COUNT           0xFFFF
+#define USAGE_LOG_NO_RECORD           0xFFFF
+
+/*
+  UsageLog counts how often every entry is used, without an erase per use.
+
+  Counts live in an append-only log of 8 byte records. A record holds a base count and a tally of 24 bits: a use
+  clears the next tally bit of the newest record of its entry, which is a single page program since NOR flash
+  clears bits without erasing. Once the tally is used up a new record with the current count as base is appended.
+
+  The log is a Journal alternating between two halves. When the active half is full, the current counts are
+  written into the other half.
+*/
+class UsageLog : public Journal
+{
+  public:
+    UsageLog(MT25Q* flashMemory);
+    void mount(void);
+    void format(void);
+    bool increment(uint16_t id);
+    void reset(uint16_t id);
+    uint16_t getCount(uint16_t id);
+
+  private:
+    vector<tuple<uint16_t, uint16_t, uint16_t, uint8_t>> counters;  // Id, count, newest record and its used tally bits, sorted by id
+
+    vector<tuple<uint16_t, uint16_t, uint16_t, uint8_t>>::iterator findCounter(uint16_t id);
+    uint16_t appendRecord(uint16_t id, uint16_t base);
+    void programTallyBit(uint16_t record, uint8_t bit);
+    void encodeRecord(uint8_t* record, uint32_t value);
+    void encodeHeader(uint8_t* record, uint32_t headerGeneration) override;
+    uint32_t getHeaderGeneration(const uint8_t* record) override;
+    void replayRecord(uint16_t index, const uint8_t* record) override;
+    void compact(void) override;
+};
+
+#endif
@@ -0,0 +1,635 @@
+#include "WearLeveler.h"
+
+#define POOL_ADDRESS(physical)       (WEAR_POOL_START_ADDRESS + (uint32_t)(physical) * MT25Q_SUBSECTOR_SIZE)
+#define FREE_OWNER                   0xFF
+
+uint8_t WearLeveler::subsectorBuffer[];
+
+/*
+  WearLeveler(MT25Q*) initializes class. Must be mounted before use.
+*/
+WearLeveler::WearLeveler(MT25Q* flashMemory) : Journal(flashMemory, WEAR_JOURNAL_START_ADDRESS, 1, WEAR_JOURNAL_RECORD_SIZE)
+{
+  fill_n(logicalMap, WEAR_LOGICAL_SUBSECTOR_COUNT, WEAR_NO_SUBSECTOR);
+  fill_n(physicalOwner, WEAR_POOL_SUBSECTOR_COUNT, FREE_OWNER);
+  fill_n(eraseCount, WEAR_POOL_SUBSECTOR_COUNT, 0);
+  erasedSubsectors.markAllUsed();
+  skippedUpdates = 0;
+  programmedUpdates = 0;
+  relocatedUpdates = 0;
+}
+
+/*
+  uint8_t getLogicalSubsector(uint32_t) maps home address of a system region to its logical subsector:
+  device settings and address table are logical subsectors 0 and 1, title/URL index of first address table
+  segment follows, then further address table segments and title/URL index of those. Logical subsectors added
+  by a later firmware come last, so the numbering in the journal of existing devices stays valid.
+*/
+uint8_t WearLeveler::getLogicalSubsector(uint32_t addr)
+{
+  if(addr >= METADATA_SEGMENT_START_ADDRESS)
+  {
+    return 1 + ENTRY_TABLE_SEGMENT_COUNT + WEAR_METADATA_SUBSECTOR_COUNT + ((addr - METADATA_SEGMENT_START_ADDRESS) >> 12);
+  }
+
+  if(addr >= METADATA_START_ADDRESS)
+  {
+    return 2 + ((addr - METADATA_START_ADDRESS) >> 12);
+  }
+
+  if(addr >= ADDRESS_TABLE_SEGMENT_START_ADDRESS)
+  {
+    return WEAR_METADATA_SUBSECTOR_COUNT + 2 + ((addr - ADDRESS_TABLE_SEGMENT_START_ADDRESS) >> 12);
+  }
+
+  return addr >> 12;
+}
+
+/*
+  uint32_t getHomeAddress(uint8_t) returns home address of a logical subsector.
+*/
+uint32_t WearLeveler::getHomeAddress(uint8_t logical)
+{
+  if(logical < 2)
+  {
+    return logical * MT25Q_SUBSECTOR_SIZE;
+  }
+
+  if(logical < WEAR_METADATA_SUBSECTOR_COUNT + 2)
+  {
+    return METADATA_START_ADDRESS + (logical - 2) * MT25Q_SUBSECTOR_SIZE;
+  }
+
+  if(logical < WEAR_METADATA_SUBSECTOR_COUNT + 1 + ENTRY_TABLE_SEGMENT_COUNT)
+  {
+    return ADDRESS_TABLE_SEGMENT_START_ADDRESS + (logical - WEAR_METADATA_SUBSECTOR_COUNT - 2) * MT25Q_SUBSECTOR_SIZE;
+  }
+
+  return METADATA_SEGMENT_START_ADDRESS + (logical - WEAR_METADATA_SUBSECTOR_COUNT - 1 - ENTRY_TABLE_SEGMENT_COUNT) * MT25Q_SUBSECTOR_SIZE;
+}
+
+/*
+  uint32_t getPhysicalAddress(uint32_t) translates home address to address in physical pool.
+*/
+uint32_t WearLeveler::getPhysicalAddress(uint32_t addr)
+{
+  return POOL_ADDRESS(logicalMap[getLogicalSubsector(addr)]) | (addr & 0xFFF);
+}
+
+/*
+  void encodeRecord(uint8_t*, uint8_t, uint8_t, uint16_t, uint32_t) builds journal record with check byte.
+*/
+void WearLeveler::encodeRecord(uint8_t* record, uint8_t type, uint8_t logical, uint16_t physical, uint32_t value)
+{
+  record[0] = type;
+  record[1] = logical;
+  record[2] = (physical & 0xFF00) >> 8;
+  record[3] = physical & 0xFF;
+  record[4] = (value >> 16) & 0xFF;
+  record[5] = (value >> 8) & 0xFF;
+  record[6] = value & 0xFF;
+  record[7] = getRecordCheck(record, WEAR_JOURNAL_RECORD_SIZE - 1);
+}
+
+/*
+  void encodeHeader(uint8_t*, uint32_t) builds header record of a journal subsector with given generation.
+*/
+void WearLeveler::encodeHeader(uint8_t* record, uint32_t headerGeneration)
+{
+  encodeRecord(record, WEAR_JOURNAL_HEADER, 0xFF, 0xFFFF, headerGeneration);
+}
+
+/*
+  uint32_t getHeaderGeneration(const uint8_t*) returns generation stored in given header record.
+*/
+uint32_t WearLeveler::getHeaderGeneration(const uint8_t* record)
+{
+  return (record[4] << 16) | (record[5] << 8) | record[6];
+}
+
+/*
+  void mount(void) loads map and erase counts from newest journal. Devices without journal get formatted,
+  which moves existing data from the home addresses into the pool.
+*/
+void WearLeveler::mount(void)
+{
+  fill_n(logicalMap, WEAR_LOGICAL_SUBSECTOR_COUNT, WEAR_NO_SUBSECTOR);
+  fill_n(physicalOwner, WEAR_POOL_SUBSECTOR_COUNT, FREE_OWNER);
+  fill_n(eraseCount, WEAR_POOL_SUBSECTOR_COUNT, 0);
+  erasedSubsectors.markAllUsed();
+
+  if(!mountJournal())
+  {
+    format();
+    return;
+  }
+
+  mapMissingSubsectors();
+}
+
+/*
+  void mapMissingSubsectors(void) moves every logical subsector without mapping (e.g. added by a firmware
+  update) from its home address into the pool, like format() does for all of them.
+*/
+void WearLeveler::mapMissingSubsectors(void)
+{
+  for(uint8_t logical = 0; logical < WEAR_LOGICAL_SUBSECTOR_COUNT; logical++)
+  {
+    if(logicalMap[logical] != WEAR_NO_SUBSECTOR)
+    {
+      continue;
+    }
+
+    uint16_t target = findColdestFreeSubsector();
+    if(target == WEAR_NO_SUBSECTOR)
+    {
+      printf("[Error] Wear leveling pool is too small!\n");
+      return;
+    }
+
+    flashMemory->readBytes(getHomeAddress(logical), subsectorBuffer, MT25Q_SUBSECTOR_SIZE);
+    relocate(logical, subsectorBuffer, target);
+  }
+}
+
+/*
+  void replayRecord(uint16_t, const uint8_t*) applies mapping and erase count of given record while mounting.
+*/
+void WearLeveler::replayRecord(uint16_t, const uint8_t* record)
+{
+  uint8_t logical = record[1];
+  uint16_t physical = (record[2] << 8) | record[3];
+  uint32_t value = (record[4] << 16) | (record[5] << 8) | record[6];
+
+  // Skip records torn by power loss
+  if(getRecordCheck(record, WEAR_JOURNAL_RECORD_SIZE - 1) != record[7] || record[0] != WEAR_JOURNAL_MAPPING ||
+    physical >= WEAR_POOL_SUBSECTOR_COUNT || (logical >= WEAR_LOGICAL_SUBSECTOR_COUNT && logical != FREE_OWNER))
+  {
+    return;
+  }
+
+  if(physicalOwner[physical] != FREE_OWNER && logicalMap[physicalOwner[physical]] == physical)
+  {
+    logicalMap[physicalOwner[physical]] = WEAR_NO_SUBSECTOR;
+  }
+
+  if(logical != FREE_OWNER)
+  {
+    if(logicalMap[logical] != WEAR_NO_SUBSECTOR)
+    {
+      physicalOwner[logicalMap[logical]] = FREE_OWNER;
+    }
+
+    logicalMap[logical] = physical;
+  }
+
+  physicalOwner[physical] = logical;
+  eraseCount[physical] = value;
+}
+
+/*
+  void format(void) creates a new journal. Data found at the home addresses (written by firmware without
+  wear leveling) is copied into the pool, so existing devices keep their settings and entries.
+*/
+void WearLeveler::format(void)
+{
+  fill_n(physicalOwner, WEAR_POOL_SUBSECTOR_COUNT, FREE_OWNER);
+  fill_n(eraseCount, WEAR_POOL_SUBSECTOR_COUNT, 0);
+  erasedSubsectors.markAllUsed();
+
+  for(uint8_t logical = 0; logical < WEAR_LOGICAL_SUBSECTOR_COUNT; logical++)
+  {
+    flashMemory->readBytes(getHomeAddress(logical), subsectorBuffer, MT25Q_SUBSECTOR_SIZE);
+
+    logicalMap[logical] = logical;
+    physicalOwner[logical] = logical;
+
+    // Pool may hold data of a lost journal
+    if(!isSubsectorErased(POOL_ADDRESS(logical)))
+    {
+      flashMemory->eraseBytes(POOL_ADDRESS(logical));
+      eraseCount[logical]++;
+    }
+
+    for(auto i = 0; i < MT25Q_SUBSECTOR_SIZE / MT25Q_PAGE_SIZE; i++)
+    {
+      uint8_t* page = &subsectorBuffer[i * MT25Q_PAGE_SIZE];
+      if(!all_of(page, page + MT25Q_PAGE_SIZE, [](uint8_t value) { return value == 0xFF; }))
+      {
+        flashMemory->writeBytes(POOL_ADDRESS(logical) + i * MT25Q_PAGE_SIZE, page);
+      }
+    }
+  }
+
+  compact();
+}
+
+/*
+  bool isSubsectorErased(uint32_t) returns true if every byte of subsector at given address is 0xFF.
+*/
+bool WearLeveler::isSubsectorErased(uint32_t addr)
+{
+  uint8_t page[MT25Q_PAGE_SIZE];
+
+  for(auto i = 0; i < MT25Q_SUBSECTOR_SIZE / MT25Q_PAGE_SIZE; i++)
+  {
+    flashMemory->readBytes(addr + i * MT25Q_PAGE_SIZE, page, MT25Q_PAGE_SIZE);
+    if(!all_of(page, page + MT25Q_PAGE_SIZE, [](uint8_t value) { return value == 0xFF; }))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/*
+  void compact(void) writes map and erase counts of all physical subsectors into the other journal subsector and
+  makes it the active one.
+*/
+void WearLeveler::compact(void)
+{
+  beginCompaction();
+
+  for(uint16_t physical = 0; physical < WEAR_POOL_SUBSECTOR_COUNT; physical++)
+  {
+    uint8_t record[WEAR_JOURNAL_RECORD_SIZE];
+    encodeRecord(record, WEAR_JOURNAL_MAPPING, physicalOwner[physical], physical, eraseCount[physical]);
+    addCompactedRecord(record);
+  }
+
+  finishCompaction();
+}
+
+/*
+  void appendRecord(uint8_t, uint8_t, uint16_t, uint32_t) appends record to active journal. A full journal is
+  compacted instead, which already writes the state this record would describe.
+*/
+void WearLeveler::appendRecord(uint8_t type, uint8_t logical, uint16_t physical, uint32_t value)
+{
+  uint8_t record[WEAR_JOURNAL_RECORD_SIZE];
+  encodeRecord(record, type, logical, physical, value);
+  appendJournalRecord(record);
+}
+
+/*
+  uint16_t findColdestFreeSubsector(void) returns free physical subsector with lowest erase count. Subsectors
+  erased in advance are preferred, they are the coldest ones anyway (see prepareErasedSubsector()).
+*/
+uint16_t WearLeveler::findColdestFreeSubsector(void)
+{
+  uint16_t coldest = WEAR_NO_SUBSECTOR;
+
+  for(uint16_t physical = 0; physical < WEAR_POOL_SUBSECTOR_COUNT; physical++)
+  {
+    if(physicalOwner[physical] != FREE_OWNER)
+    {
+      continue;
+    }
+
+    if(coldest == WEAR_NO_SUBSECTOR || erasedSubsectors.isFree(physical) > erasedSubsectors.isFree(coldest) ||
+      (erasedSubsectors.isFree(physical) == erasedSubsectors.isFree(coldest) && eraseCount[physical] < eraseCount[coldest]))
+    {
+      coldest = physical;
+    }
+  }
+
+  return coldest;
+}
+
+/*
+  void relocate(uint8_t, const uint8_t*, uint16_t) writes content of logical subsector to target physical subsector
+  and records the new mapping. Old physical subsector stays intact until the journal record is written, so a
+  power loss keeps the previous content. Target is only erased if it was not erased in advance.
+*/
+void WearLeveler::relocate(uint8_t logical, const uint8_t* data, uint16_t target)
+{
+  if(!erasedSubsectors.isFree(target))
+  {
+    flashMemory->eraseBytes(POOL_ADDRESS(target));
+    eraseCount[target]++;
+  }
+
+  erasedSubsectors.markUsed(target);
+
+  for(auto i = 0; i < MT25Q_SUBSECTOR_SIZE / MT25Q_PAGE_SIZE; i++)
+  {
+    const uint8_t* page = &data[i * MT25Q_PAGE_SIZE];
+    if(!all_of(page, page + MT25Q_PAGE_SIZE, [](uint8_t value) { return value == 0xFF; }))
+    {
+      flashMemory->writeBytes(POOL_ADDRESS(target) + i * MT25Q_PAGE_SIZE, page);
+    }
+  }
+
+  uint16_t previous = logicalMap[logical];
+  if(previous != WEAR_NO_SUBSECTOR)
+  {
+    physicalOwner[previous] = FREE_OWNER;
+  }
+
+  physicalOwner[target] = logical;
+  logicalMap[logical] = target;
+
+  appendRecord(WEAR_JOURNAL_MAPPING, logical, target, eraseCount[target]);
+}
+
+/*
+  void readBytes(uint32_t, uint8_t*, size_t) reads bytes starting from home address of a system region.
+*/
+void WearLeveler::readBytes(uint32_t addr, uint8_t* buffer, size_t size)
+{
+  while(size > 0)
+  {
+    size_t chunkSize = min<size_t>(size, MT25Q_SUBSECTOR_SIZE - (addr & 0xFFF));
+    flashMemory->readBytes(getPhysicalAddress(addr), buffer, chunkSize);
+
+    addr += chunkSize;
+    buffer += chunkSize;
+    size -= chunkSize;
+  }
+}
+
+/*
+  void updateBytes(uint32_t, const uint8_t*) updates page at given home address. Unchanged pages are skipped and
+  pages which only need bits cleared (e.g. filling an erased slot) are programmed in place. Otherwise the
+  subsector holding the page is moved to the least erased free physical subsector.
+*/
+void WearLeveler::updateBytes(uint32_t addr, const uint8_t* data)
+{
+  flashMemory->readBytes(getPhysicalAddress(addr & 0xFFFFF000), subsectorBuffer, MT25Q_SUBSECTOR_SIZE);
+  uint8_t* page = &subsectorBuffer[addr & 0xF00];
+
+  if(equal(data, data + MT25Q_PAGE_SIZE, page))
+  {
+    skippedUpdates++;
+    return;
+  }
+
+  if(MT25Q::isProgrammable(page, data))
+  {
+    flashMemory->writeBytes(getPhysicalAddress(addr & 0xFFFFFF00), data);
+    programmedUpdates++;
+    return;
+  }
+
+  copy_n(data, MT25Q_PAGE_SIZE, page);
+  relocate(getLogicalSubsector(addr), subsectorBuffer, findColdestFreeSubsector());
+  relocatedUpdates++;
+}
+
+/*
+  void updateSubsector(uint32_t, const uint8_t*) replaces whole subsector (4KB) at given home address. Like
+  updateBytes() unchanged pages are skipped and pages only clearing bits are programmed in place, otherwise the
+  subsector is written with a single relocation.
+*/
+void WearLeveler::updateSubsector(uint32_t addr, const uint8_t* data)
+{
+  uint32_t physicalAddr = getPhysicalAddress(addr & 0xFFFFF000);
+  uint16_t changedPages = 0;
+  bool needsRelocation = false;
+
+  for(auto i = 0; i < MT25Q_SUBSECTOR_SIZE / MT25Q_PAGE_SIZE; i++)
+  {
+    uint8_t page[MT25Q_PAGE_SIZE];
+    const uint8_t* newPage = &data[i * MT25Q_PAGE_SIZE];
+    flashMemory->readBytes(physicalAddr + i * MT25Q_PAGE_SIZE, page, MT25Q_PAGE_SIZE);
+
+    if(equal(newPage, newPage + MT25Q_PAGE_SIZE, page))
+    {
+      continue;
+    }
+
+    changedPages |= 1 << i;
+    needsRelocation |= !MT25Q::isProgrammable(page, newPage);
+  }
+
+  if(changedPages == 0)
+  {
+    skippedUpdates++;
+    return;
+  }
+
+  if(needsRelocation)
+  {
+    relocate(getLogicalSubsector(addr), data, findColdestFreeSubsector());
+    relocatedUpdates++;
+    return;
+  }
+
+  for(auto i = 0; i < MT25Q_SUBSECTOR_SIZE / MT25Q_PAGE_SIZE; i++)
+  {
+    if(changedPages & (1 << i))
+    {
+      flashMemory->writeBytes(physicalAddr + i * MT25Q_PAGE_SIZE, &data[i * MT25Q_PAGE_SIZE]);
+      programmedUpdates++;
+    }
+  }
+}
+
+/*
+  bool balance(void) moves rarely written data off the least erased physical subsector, once the erase count
+  spread of the pool exceeds WEAR_BALANCE_THRESHOLD. This makes cold subsectors available for hot data.
+
+  Returns true if a subsector was moved.
+*/
+bool WearLeveler::balance(void)
+{
+  uint16_t coldestUsed = WEAR_NO_SUBSECTOR;
+  uint16_t hottestFree = WEAR_NO_SUBSECTOR;
+
+  for(uint16_t physical = 0; physical < WEAR_POOL_SUBSECTOR_COUNT; physical++)
+  {
+    if(physicalOwner[physical] == FREE_OWNER)
+    {
+      if(hottestFree == WEAR_NO_SUBSECTOR || eraseCount[physical] > eraseCount[hottestFree])
+      {
+        hottestFree = physical;
+      }
+    }
+    else if(coldestUsed == WEAR_NO_SUBSECTOR || eraseCount[physical] < eraseCount[coldestUsed])
+    {
+      coldestUsed = physical;
+    }
+  }
+
+  if(coldestUsed == WEAR_NO_SUBSECTOR || hottestFree == WEAR_NO_SUBSECTOR ||
+    eraseCount[hottestFree] < eraseCount[coldestUsed] + WEAR_BALANCE_THRESHOLD)
+  {
+    return false;
+  }
+
+  flashMemory->readBytes(POOL_ADDRESS(coldestUsed), subsectorBuffer, MT25Q_SUBSECTOR_SIZE);
+  relocate(physicalOwner[coldestUsed], subsectorBuffer, hottestFree);
+
+  return true;
+}
+
+/*
+  void destroyFreeCopies(uint16_t, uint16_t) programs zeros over given byte range of every page in every free
+  physical subsector which is not erased. Relocations leave older versions of a logical subsector behind, this
+  makes e.g. key material in old device settings records unreadable without erasing them. Free subsectors are
+  erased before re-use.
+*/
+void WearLeveler::destroyFreeCopies(uint16_t offset, uint16_t size)
+{
+  uint8_t page[MT25Q_PAGE_SIZE];
+  fill_n(page, MT25Q_PAGE_SIZE, 0xFF);
+  fill_n(&page[offset], min<uint16_t>(size, MT25Q_PAGE_SIZE - offset), 0x00);
+
+  for(uint16_t physical = 0; physical < WEAR_POOL_SUBSECTOR_COUNT; physical++)
+  {
+    if(physicalOwner[physical] != FREE_OWNER || erasedSubsectors.isFree(physical))
+    {
+      continue;
+    }
+
+    for(auto i = 0; i < MT25Q_SUBSECTOR_SIZE / MT25Q_PAGE_SIZE; i++)
+    {
+      flashMemory->writeBytes(POOL_ADDRESS(physical) + i * MT25Q_PAGE_SIZE, page);
+    }
+  }
+}
+
+/*
+  bool eraseFreeSubsector(uint16_t) erases given physical subsector if it is free and still holds old data.
+
+  Returns true if subsector was erased.
+*/
+bool WearLeveler::eraseFreeSubsector(uint16_t physical)
+{
+  if(physical >= WEAR_POOL_SUBSECTOR_COUNT || physicalOwner[physical] != FREE_OWNER || erasedSubsectors.isFree(physical))
+  {
+    return false;
+  }
+
+  if(isSubsectorErased(POOL_ADDRESS(physical)))
+  {
+    erasedSubsectors.markFree(physical);
+    return false;
+  }
+
+  erasePoolSubsector(physical);
+
+  return true;
+}
+
+/*
+  bool prepareErasedSubsector(void) erases the least erased free physical subsector until WEAR_ERASED_POOL_SIZE
+  free subsectors are erased in advance. Relocations to those subsectors only program pages, so updates of
+  system subsectors do not wait for an erase. Should be called from a low priority maintenance thread.
+
+  Returns true if a subsector was erased.
+*/
+bool WearLeveler::prepareErasedSubsector(void)
+{
+  while(erasedSubsectors.countFree() < WEAR_ERASED_POOL_SIZE)
+  {
+    uint16_t coldest = WEAR_NO_SUBSECTOR;
+
+    for(uint16_t physical = 0; physical < WEAR_POOL_SUBSECTOR_COUNT; physical++)
+    {
+      if(physicalOwner[physical] == FREE_OWNER && !erasedSubsectors.isFree(physical) &&
+        (coldest == WEAR_NO_SUBSECTOR || eraseCount[physical] < eraseCount[coldest]))
+      {
+        coldest = physical;
+      }
+    }
+
+    if(coldest == WEAR_NO_SUBSECTOR)
+    {
+      return false;
+    }
+
+    // Subsectors found erased (e.g. after mount) only need to be marked
+    if(eraseFreeSubsector(coldest))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*
+  void erasePoolSubsector(uint16_t) erases free physical subsector in advance and records its new erase count.
+*/
+void WearLeveler::erasePoolSubsector(uint16_t physical)
+{
+  flashMemory->eraseBytes(POOL_ADDRESS(physical));
+  eraseCount[physical]++;
+  erasedSubsectors.markFree(physical);
+
+  appendRecord(WEAR_JOURNAL_MAPPING, FREE_OWNER, physical, eraseCount[physical]);
+}
+
+/*
+  bool eraseHomeSubsector(uint8_t) erases home address of given logical subsector once the logical subsector
+  lives in the pool. Homes only hold data written by firmware without wear leveling, which was copied into
+  the pool by format() or mapMissingSubsectors().
+
+  Returns true if subsector was erased.
+*/
+bool WearLeveler::eraseHomeSubsector(uint8_t logical)
+{
+  if(logical >= WEAR_LOGICAL_SUBSECTOR_COUNT || logicalMap[logical] == WEAR_NO_SUBSECTOR ||
+    isSubsectorErased(getHomeAddress(logical)))
+  {
+    return false;
+  }
+
+  flashMemory->eraseBytes(getHomeAddress(logical));
+
+  return true;
+}
+
+/*
+  uint32_t getEraseCount(uint16_t) returns erase count of a physical pool subsector.
+*/
+uint32_t WearLeveler::getEraseCount(uint16_t physical)
+{
+  return physical < WEAR_POOL_SUBSECTOR_COUNT ? eraseCount[physical] : 0;
+}
+
+/*
+  void getWearStats(uint32_t*, uint32_t*, uint32_t*) returns lowest, highest and summed erase count of the pool.
+*/
+void WearLeveler::getWearStats(uint32_t* minErases, uint32_t* maxErases, uint32_t* totalErases)
+{
+  *minErases = UINT32_MAX;
+  *maxErases = 0;
+  *totalErases = 0;
+
+  for(uint16_t physical = 0; physical < WEAR_POOL_SUBSECTOR_COUNT; physical++)
+  {
+    *minErases = min(*minErases, eraseCount[physical]);
+    *maxErases = max(*maxErases, eraseCount[physical]);
+    *totalErases += eraseCount[physical];
+  }
+}
+
+/*
+  uint32_t getRemainingErases(void) returns how many more subsector updates the pool can take before its
+  subsectors reach MT25Q_ERASE_ENDURANCE. Divided by the update rate this gives the expected lifetime.
+*/
+uint32_t WearLeveler::getRemainingErases(void)
+{
+  uint32_t remaining = 0;
+
+  for(uint16_t physical = 0; physical < WEAR_POOL_SUBSECTOR_COUNT; physical++)
+  {
+    remaining += eraseCount[physical] < MT25Q_ERASE_ENDURANCE ? MT25Q_ERASE_ENDURANCE - eraseCount[physical] : 0;
+  }
+
+  return remaining;
+}
+
+/*
+  void getUpdateStats(uint32_t*, uint32_t*, uint32_t*) returns how many page updates were skipped (unchanged),
+  programmed in place or written by relocating their subsector.
+*/
+void WearLeveler::getUpdateStats(uint32_t* skipped, uint32_t* programmed, uint32_t* relocated)
+{
+  *skipped = skippedUpdates;
+  *programmed = programmedUpdates;
+  *relocated = relocatedUpdates;
+}
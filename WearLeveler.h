@@ -0,0 +1,68 @@
+#include "MT25Q.h"
+#include "EntryManager.h"
+#include "Journal.h"
+#include <cstdint>
+
+#ifndef WEAR_LEVELER_H
+#define WEAR_LEVELER_H
+
+#define WEAR_NO_SUBSECTOR             0xFFFF  // Logical subsector is not mapped / physical subsector is free
+#define WEAR_JOURNAL_RECORD_SIZE      8       // [TYPE] [LOGICAL] [PHYSICAL 2 bytes] [VALUE 3 bytes] [CHECK]
+#define WEAR_JOURNAL_HEADER           0xA5    // First record of a journal subsector, value is its generation
+#define WEAR_JOURNAL_MAPPING          0x01    // Physical subsector holds logical subsector (0xFF = free), value is its erase count
+
+/*
+  WearLeveler spreads erases of the frequently re-written system subsectors (device settings, address table
+  segments and title/URL index) over a pool of physical subsectors.
+
+  Callers keep using the fixed home addresses of those regions. Every update writes the changed logical subsector
+  to the least erased free physical subsector, so no physical subsector is erased twice in a row. A few free
+  subsectors are erased in advance by prepareErasedSubsector(), so most updates do not wait for an erase. Erase counts and
+  the logical to physical map are kept in a Journal alternating between two subsectors.
+*/
+class WearLeveler : public Journal
+{
+  public:
+    WearLeveler(MT25Q* flashMemory);
+    void mount(void);
+    void readBytes(uint32_t addr, uint8_t* buffer, size_t size);
+    void updateBytes(uint32_t addr, const uint8_t* data);
+    void updateSubsector(uint32_t addr, const uint8_t* data);
+    bool balance(void);
+    bool prepareErasedSubsector(void);
+    void destroyFreeCopies(uint16_t offset, uint16_t size);
+    bool eraseFreeSubsector(uint16_t physical);
+    bool eraseHomeSubsector(uint8_t logical);
+    uint32_t getEraseCount(uint16_t physical);
+    void getWearStats(uint32_t* minErases, uint32_t* maxErases, uint32_t* totalErases);
+    uint32_t getRemainingErases(void);
+    void getUpdateStats(uint32_t* skipped, uint32_t* programmed, uint32_t* relocated);
+
+  private:
+    uint16_t logicalMap[WEAR_LOGICAL_SUBSECTOR_COUNT];
+    uint8_t physicalOwner[WEAR_POOL_SUBSECTOR_COUNT];
+    uint32_t eraseCount[WEAR_POOL_SUBSECTOR_COUNT];
+    FreeBitmap<WEAR_POOL_SUBSECTOR_COUNT> erasedSubsectors;  // Free physical subsectors known to be erased
+    uint32_t skippedUpdates;
+    uint32_t programmedUpdates;
+    uint32_t relocatedUpdates;
+    static uint8_t subsectorBuffer[MT25Q_SUBSECTOR_SIZE];
+
+    uint8_t getLogicalSubsector(uint32_t addr);
+    uint32_t getHomeAddress(uint8_t logical);
+    uint32_t getPhysicalAddress(uint32_t addr);
+    uint16_t findColdestFreeSubsector(void);
+    void relocate(uint8_t logical, const uint8_t* data, uint16_t target);
+    void erasePoolSubsector(uint16_t physical);
+    void format(void);
+    void mapMissingSubsectors(void);
+    bool isSubsectorErased(uint32_t addr);
+    void appendRecord(uint8_t type, uint8_t logical, uint16_t physical, uint32_t value);
+    void encodeRecord(uint8_t* record, uint8_t type, uint8_t logical, uint16_t physical, uint32_t value);
+    void encodeHeader(uint8_t* record, uint32_t headerGeneration) override;
+    uint32_t getHeaderGeneration(const uint8_t* record) override;
+    void replayRecord(uint16_t index, const uint8_t* record) override;
+    void compact(void) override;
+};
+
+#endif
@@ -35,6 +35,14 @@ const char COMM_REM_ACC         = 0x27;
 const char COMM_EDIT_ACC        = 0x28;
 const char COMM_GET_UNIQUE_ID   = 0x29;
 const char COMM_GET_ALL_ENTRIES = 0x30;
+//Followed by entry data like COMM_ADD_ACC, queues entry of bulk import. Without entry data the import gets finished.
+const char COMM_BULK_ADD        = 0x31;
+//Followed by FIND_BY_TITLE or FIND_BY_DOMAIN and the query, answered with COMM_SEND_FOUND_IDS.
+const char COMM_FIND            = 0x32;
+//Answered with COMM_SEND_INTEGRITY.
+const char COMM_CHECK_INTEGRITY = 0x33;
+//Answered with COMM_SEND_STATS.
+const char COMM_GET_STATS       = 0x34;
 
 //PC and Device commands
 const char COMM_DISCONNECT = 0x35;
@@ -43,6 +51,21 @@ const char COMM_DISCONNECT = 0x35;
 const char COMM_SEND_ACC_NUM    = 0x40;
 const char COMM_SEND_ACC			  = 0x41;
 const char COMM_SEND_UNIQUE_ID  = 0x42;
+//Followed by total count of matches (2 bytes) and the ids of the first MAX_FOUND_IDS matches (2 bytes each).
+const char COMM_SEND_FOUND_IDS  = 0x43;
+//Followed by integrity status (0 = OK, 1 = damaged, 2 = still checking), check progress in percent, root digest (4 bytes),
+//total count of damaged subsectors (2 bytes) and the first MAX_DAMAGED_SUBSECTORS of them (2 bytes each).
+const char COMM_SEND_INTEGRITY  = 0x44;
+//Followed by count of counters (1 byte) and the counters (4 bytes each) in order of STATS_* in EntryManager.h.
+const char COMM_SEND_STATS      = 0x45;
+
+//COMM_FIND query types
+const char FIND_BY_TITLE        = 'T';  //Title prefix, case insensitive
+const char FIND_BY_DOMAIN       = 'D';  //Domain of an URL, e.g. "https://www.example.com/login" matches "example.com"
+const uint8_t MAX_FOUND_IDS     = 32;
+
+//COMM_SEND_INTEGRITY
+const uint8_t MAX_DAMAGED_SUBSECTORS = 16;
 
 //Internal Control Commands
 const char CTRL_TYPE_KB = 0x50;
@@ -110,14 +110,20 @@ uint8_t CryptoEngine::generateAesKeyAndIV(void)
 }
 
 /*
-  uint8_t cryptWithAesCBC(void) en- or decrypts a 128 byte array using AES-CBC algorithm.
+  uint8_t cryptWithAesCBC(void) en- or decrypts an array (128 bytes by default) using AES-CBC algorithm.
+  Size must be a multiple of the 16 byte AES block size.
 
   Error Return Values:
     (1) -> Parameter error
 */
-uint8_t CryptoEngine::cryptWithAesCBC(uint8_t* input, uint8_t* output, int mode)
+uint8_t CryptoEngine::cryptWithAesCBC(uint8_t* input, uint8_t* output, int mode, size_t size)
 {
   mbedtls_aes_context aes_context;
+
+  if(size % 16 != 0)
+  {
+    return 1;
+  }
   
   switch(mode)
   {
@@ -137,7 +143,7 @@ uint8_t CryptoEngine::cryptWithAesCBC(uint8_t* input, uint8_t* output, int mode)
     iv[i] = generatedAesIV[i];
   }
 
-  mbedtls_aes_crypt_cbc(&aes_context, mode, 128, iv, input, output);
+  mbedtls_aes_crypt_cbc(&aes_context, mode, size, iv, input, output);
 
   return 0;
 }
@@ -162,4 +168,22 @@ void CryptoEngine::setMasterPassword(uint8_t* pwd)
   {
     masterPassword[i] = pwd[i];
   }
+}
+
+/*
+  void clearKeys(void) overwrites master password, AES key, IV and salt in RAM.
+*/
+void CryptoEngine::clearKeys(void)
+{
+  volatile uint8_t* keyMaterial[] = {masterPassword, generatedAesKey, generatedAesIV, generatedSalt};
+  const size_t keyMaterialSize[] = {MASTER_PASSWORD_LENGTH, sizeof(generatedAesKey), sizeof(generatedAesIV), MAX_SALT_LENGTH};
+
+  // Volatile writes are not optimized away although the buffers are not read afterwards
+  for(auto i = 0; i < 4; i++)
+  {
+    for(size_t j = 0; j < keyMaterialSize[i]; j++)
+    {
+      keyMaterial[i][j] = 0;
+    }
+  }
 }
\ No newline at end of file
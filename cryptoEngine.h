@@ -14,10 +14,11 @@ class CryptoEngine
     CryptoEngine(void);
     uint8_t hashWithSha256(uint8_t* input, uint8_t* output);
     uint8_t generateRandomSalt(uint8_t* output);
-    uint8_t cryptWithAesCBC(uint8_t* input, uint8_t* output, int mode);
+    uint8_t cryptWithAesCBC(uint8_t* input, uint8_t* output, int mode, size_t size = 128);
     uint8_t generateAesKeyAndIV(void);
     void setSalt(uint8_t* salt);
     void setMasterPassword(uint8_t* pwd);
+    void clearKeys(void);
 
   private:
     uint8_t masterPassword[MASTER_PASSWORD_LENGTH];
@@ -0,0 +1,156 @@
+#include "SlotIndex.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/*
+  Host benchmark of SlotIndex, the address table and id index of EntryManager, against the address table scan it
+  replaced, for 10, 500 and 2047 stored entries (2047 filled the single address table segment of that time).
+  Lookups and updates run the code of SlotIndex.h the firmware uses, only the table size is set here.
+
+  Build and run from repository root:
+    g++ -std=gnu++14 -O2 -Itest/stub -I. test/IdIndexBenchmark.cpp -o test/IdIndexBenchmark && test/IdIndexBenchmark
+*/
+
+#define BENCH_TABLE_SLOTS             2047    // Address table slots scanned by the old lookup
+#define BENCH_LOOKUPS                 200000  // Lookups timed per entry count
+#define BENCH_UPDATES                 20000   // Remove and re-add cycles timed per entry count
+
+static SlotIndex<BENCH_TABLE_SLOTS, BENCH_TABLE_SLOTS> slotIndex;
+static volatile uint32_t sink;
+
+/*
+  uint16_t scanSlotOfId(uint16_t) is the lookup used before the index: walk address table until id is found.
+*/
+static uint16_t scanSlotOfId(uint16_t id)
+{
+  for(uint16_t slot = 0; slot < BENCH_TABLE_SLOTS; slot++)
+  {
+    if(slotIndex.getIdAtSlot(slot) == id)
+    {
+      return slot;
+    }
+  }
+
+  return SLOT_INDEX_UNUSED;
+}
+
+/*
+  void setTableEntry(uint16_t, uint16_t) writes id to an address table slot without index, as done before it.
+*/
+static void setTableEntry(uint16_t slot, uint16_t id)
+{
+  slotIndex.getTable()[slot * 2] = (id & 0xFF00) >> 8;
+  slotIndex.getTable()[(slot * 2) + 1] = id & 0xFF;
+}
+
+/*
+  void fillTable(uint16_t, mt19937*) stores given count of entries in the lowest slots, as entries are added, with
+  ids in random order as left by edits and removals.
+*/
+static void fillTable(uint16_t entryCount, mt19937* random)
+{
+  vector<uint16_t> ids(entryCount);
+  for(uint16_t id = 0; id < entryCount; id++)
+  {
+    ids[id] = id;
+  }
+  shuffle(ids.begin(), ids.end(), *random);
+
+  slotIndex.clear();
+
+  for(uint16_t slot = 0; slot < entryCount; slot++)
+  {
+    slotIndex.setIdAtSlot(slot, ids[slot]);
+  }
+}
+
+/*
+  double getNanoseconds(F) returns time taken by given function in nanoseconds.
+*/
+template<typename F>
+static double getNanoseconds(F function)
+{
+  auto start = chrono::steady_clock::now();
+  function();
+  return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+  const uint16_t entryCounts[] = {10, 500, 2047};
+  mt19937 random(1);
+
+  printf("%8s %14s %14s %14s %14s\n", "entries", "scan ns/find", "index ns/find", "scan ns/upd", "index ns/upd");
+
+  for(uint16_t entryCount : entryCounts)
+  {
+    fillTable(entryCount, &random);
+
+    vector<uint16_t> ids(BENCH_LOOKUPS);
+    uniform_int_distribution<uint16_t> idDistribution(0, entryCount - 1);
+    for(uint16_t& id : ids)
+    {
+      id = idDistribution(random);
+    }
+
+    double scanFind = getNanoseconds([&]()
+    {
+      for(uint16_t id : ids)
+      {
+        sink += scanSlotOfId(id);
+      }
+    });
+
+    double indexFind = getNanoseconds([&]()
+    {
+      for(uint16_t id : ids)
+      {
+        sink += slotIndex.getSlotOfId(id);
+      }
+    });
+
+    // Removing and re-adding an entry: old code scanned for the id, then for a free slot. With the index the freed
+    // slot is taken again, EntryManager gets free slots from FreeBitmap.
+    double scanUpdate = getNanoseconds([&]()
+    {
+      for(uint32_t i = 0; i < BENCH_UPDATES; i++)
+      {
+        uint16_t id = ids[i];
+        setTableEntry(scanSlotOfId(id), SLOT_INDEX_UNUSED);
+        setTableEntry(scanSlotOfId(SLOT_INDEX_UNUSED), id);
+      }
+    });
+
+    fillTable(entryCount, &random);
+
+    double indexUpdate = getNanoseconds([&]()
+    {
+      for(uint32_t i = 0; i < BENCH_UPDATES; i++)
+      {
+        uint16_t id = ids[i];
+        uint16_t slot = slotIndex.getSlotOfId(id);
+        slotIndex.setIdAtSlot(slot, SLOT_INDEX_UNUSED);
+        slotIndex.setIdAtSlot(slot, id);
+      }
+    });
+
+    for(uint16_t id = 0; id < entryCount; id++)
+    {
+      uint16_t slot = slotIndex.getSlotOfId(id);
+
+      if(slot == SLOT_INDEX_UNUSED || slotIndex.getIdAtSlot(slot) != id)
+      {
+        printf("[Error] Id index lost id %u\n", id);
+        return 1;
+      }
+    }
+
+    printf("%8u %14.1f %14.1f %14.1f %14.1f\n", entryCount, scanFind / BENCH_LOOKUPS, indexFind / BENCH_LOOKUPS,
+      scanUpdate / BENCH_UPDATES, indexUpdate / BENCH_UPDATES);
+  }
+
+  return 0;
+}
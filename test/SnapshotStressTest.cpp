@@ -0,0 +1,132 @@
+#include "Snapshot.h"
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+/*
+  Stress test of SnapshotPublisher on a host: one writer publishes STRESS_PUBLISHES versions while STRESS_READERS
+  threads keep taking and copying snapshots. Every snapshot has to stay internally consistent and every version
+  has to be deleted exactly once, which AddressSanitizer checks for use after free and leaks.
+
+  Build and run from repository root:
+    g++ -std=gnu++14 -g -O1 -fsanitize=address,undefined -pthread -Itest/stub -I. test/SnapshotStressTest.cpp -o test/SnapshotStressTest && test/SnapshotStressTest
+*/
+
+#define STRESS_PUBLISHES              200000
+#define STRESS_READERS                4
+#define STRESS_MAX_ITEMS              64      // Version v holds v % STRESS_MAX_ITEMS items, all set to v
+
+static atomic<int32_t> liveItems(0);
+static atomic<uint32_t> errorCount(0);
+
+/*
+  Item counts its live instances, so versions deleted twice or never show up in liveItems.
+*/
+struct Item
+{
+  uint32_t version;
+
+  Item(uint32_t version)
+  {
+    this->version = version;
+    liveItems++;
+  }
+
+  Item(const Item& other)
+  {
+    version = other.version;
+    liveItems++;
+  }
+
+  ~Item(void)
+  {
+    liveItems--;
+  }
+};
+
+/*
+  void check(bool, const char*) counts and reports a failed condition.
+*/
+static void check(bool condition, const char* message)
+{
+  if(!condition && errorCount++ < 10)
+  {
+    printf("[Error] %s\n", message);
+  }
+}
+
+/*
+  void readSnapshots(SnapshotPublisher<vector<Item>>*, atomic<bool>*) takes snapshots until done is set and
+  checks that versions only grow and every snapshot holds the items of its version.
+*/
+static void readSnapshots(SnapshotPublisher<vector<Item>>* publisher, atomic<bool>* done)
+{
+  uint32_t lastVersion = 0;
+  uint64_t reads = 0;
+
+  while(!*done)
+  {
+    Snapshot<vector<Item>> snapshot = publisher->read();
+    check(snapshot.getVersion() >= lastVersion, "Snapshot version went back");
+    lastVersion = snapshot.getVersion();
+
+    check(snapshot->size() == snapshot.getVersion() % STRESS_MAX_ITEMS, "Snapshot has wrong item count");
+    for(const Item& item : *snapshot)
+    {
+      check(item.version == snapshot.getVersion(), "Snapshot item belongs to other version");
+    }
+
+    // Copies and assignments hand references over between versions
+    Snapshot<vector<Item>> copy = snapshot;
+    copy = publisher->read();
+    check(copy.getVersion() >= snapshot.getVersion(), "Newer snapshot has older version");
+
+    reads++;
+  }
+
+  printf("Reader took %llu snapshots\n", (unsigned long long)reads);
+}
+
+int main()
+{
+  {
+    SnapshotPublisher<vector<Item>> publisher;
+    atomic<bool> done(false);
+    vector<thread> readers;
+
+    for(uint8_t i = 0; i < STRESS_READERS; i++)
+    {
+      readers.emplace_back(readSnapshots, &publisher, &done);
+    }
+
+    for(uint32_t version = 1; version <= STRESS_PUBLISHES; version++)
+    {
+      vector<Item> next;
+      for(uint32_t i = 0; i < version % STRESS_MAX_ITEMS; i++)
+      {
+        next.emplace_back(version);
+      }
+
+      publisher.publish(move(next));
+      check(publisher.getVersion() == version, "Publisher has wrong version");
+    }
+
+    done = true;
+    for(thread& reader : readers)
+    {
+      reader.join();
+    }
+  }
+
+  check(liveItems == 0, "Versions were not deleted exactly once");
+
+  if(errorCount > 0)
+  {
+    printf("[Error] Snapshot stress test failed with %u errors\n", (unsigned int)errorCount);
+    return 1;
+  }
+
+  printf("Snapshot stress test passed (%d publishes, %d readers)\n", STRESS_PUBLISHES, STRESS_READERS);
+  return 0;
+}
@@ -0,0 +1,88 @@
+#include "UsageLog.h"
+#include <cstdio>
+
+/*
+  Host test of UsageLog compaction with many equal counts. Every id is used once until the log half is full, so
+  all counts tie at the threshold of compaction. Exactly USAGE_LOG_COMPACT_RECORDS counters have to be kept: the
+  most used entry and the lowest ids of the tied rest, in RAM and after mounting the compacted half again.
+
+  Build and run from repository root:
+    g++ -std=gnu++14 -g -O1 -fsanitize=address,undefined -Itest/stub -I. test/UsageLogTest.cpp UsageLog.cpp Journal.cpp -o test/UsageLogTest && test/UsageLogTest
+*/
+
+#define TEST_ENTRY_COUNT              (USAGE_LOG_HALF_RECORDS - 1)  // One record per entry fills a half behind its header
+#define TEST_HOT_ID                   (TEST_ENTRY_COUNT - 1)        // Used until a record is appended, which compacts
+#define TEST_HOT_COUNT                (USAGE_LOG_TALLY_BITS + 2)
+
+static uint32_t errorCount = 0;
+
+/*
+  void check(bool, const char*) counts and reports a failed condition.
+*/
+static void check(bool condition, const char* message)
+{
+  if(!condition && errorCount++ < 10)
+  {
+    printf("[Error] %s\n", message);
+  }
+}
+
+/*
+  void checkCounts(UsageLog*, const char*) checks counts kept by compaction.
+*/
+static void checkCounts(UsageLog* usageLog, const char* stage)
+{
+  uint16_t keptCount = 0;
+
+  for(uint16_t id = 0; id < TEST_ENTRY_COUNT; id++)
+  {
+    uint16_t count = usageLog->getCount(id);
+    keptCount += count > 0 ? 1 : 0;
+
+    if(id == TEST_HOT_ID)
+    {
+      check(count == TEST_HOT_COUNT, "Most used entry lost its count");
+    }
+    else
+    {
+      check(count == (id < USAGE_LOG_COMPACT_RECORDS - 1 ? 1 : 0), "Tied count kept or dropped out of id order");
+    }
+  }
+
+  printf("%s: %u of %u counters kept\n", stage, keptCount, TEST_ENTRY_COUNT);
+  check(keptCount == USAGE_LOG_COMPACT_RECORDS, "Compaction did not keep USAGE_LOG_COMPACT_RECORDS counters");
+}
+
+int main()
+{
+  MT25Q flashMemory;
+  UsageLog usageLog(&flashMemory);
+  usageLog.format();
+  usageLog.mount();
+
+  for(uint16_t id = 0; id < TEST_ENTRY_COUNT; id++)
+  {
+    check(usageLog.increment(id), "Use was not counted");
+  }
+
+  // Tally bits of the record are used up first, the next use appends to the full half
+  for(uint16_t i = 1; i < TEST_HOT_COUNT; i++)
+  {
+    check(usageLog.increment(TEST_HOT_ID), "Use was not counted");
+  }
+
+  checkCounts(&usageLog, "Compacted");
+
+  UsageLog mountedLog(&flashMemory);
+  mountedLog.mount();
+  checkCounts(&mountedLog, "Mounted");
+
+  if(errorCount > 0)
+  {
+    printf("[Error] Usage log test failed with %u errors\n", (unsigned int)errorCount);
+    return 1;
+  }
+
+  printf("Usage log test passed\n");
+  return 0;
+}
@@ -0,0 +1,9 @@
+#ifndef CRYPTO_ENGINE_H
+#define CRYPTO_ENGINE_H
+
+/*
+  Host stand-in of CryptoEngine, classes tested on a PC only pass it on.
+*/
+class CryptoEngine;
+
+#endif
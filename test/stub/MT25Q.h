@@ -0,0 +1,58 @@
+#include "mbed.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// MT25Q Memory Constants (from datasheet of Micron MT25QL256ABA)
+#define MT25Q_PAGE_SIZE           256   // 256 Byte
+#define MT25Q_SUBSECTOR_SIZE      4096  // 4KB
+#define MT25Q_ERASE_ENDURANCE     100000  // Minimum erase cycles per subsector
+#define MT25Q_MEMORY_SIZE         0x2000000  // 32MB
+
+#ifndef MT25Q_H
+#define MT25Q_H
+
+/*
+  Host stand-in of MT25Q keeping flash content in RAM. Programming only clears bits and erasing sets a subsector
+  back to 0xFF, like NOR flash, so journals behave as on the device.
+*/
+class MT25Q
+{
+  public:
+    MT25Q(void) : memory(MT25Q_MEMORY_SIZE, 0xFF), eraseCount(0) {}
+
+    void readBytes(uint32_t addr, uint8_t* buffer, size_t size)
+    {
+      copy_n(&memory[addr], size, buffer);
+    }
+
+    void readBurst(uint32_t addr, uint8_t* buffer, size_t size)
+    {
+      readBytes(addr, buffer, size);
+    }
+
+    void writeBytes(uint32_t addr, const uint8_t* data)
+    {
+      for(uint16_t i = 0; i < MT25Q_PAGE_SIZE; i++)
+      {
+        memory[(addr & ~(MT25Q_PAGE_SIZE - 1)) + ((addr + i) % MT25Q_PAGE_SIZE)] &= data[i];
+      }
+    }
+
+    void eraseBytes(uint32_t addr)
+    {
+      fill_n(&memory[addr & ~(MT25Q_SUBSECTOR_SIZE - 1)], MT25Q_SUBSECTOR_SIZE, 0xFF);
+      eraseCount++;
+    }
+
+    uint32_t getEraseCount(void)
+    {
+      return eraseCount;
+    }
+
+  private:
+    vector<uint8_t> memory;
+    uint32_t eraseCount;
+};
+
+#endif
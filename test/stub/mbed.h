@@ -0,0 +1,74 @@
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#ifndef MBED_H
+#define MBED_H
+
+using namespace std;
+
+/*
+  Host stand-ins for the few Mbed OS functions and types used by header-only parts of the firmware and by the
+  classes tested on a PC (see Snapshot.h, UsageLog). Interrupts are not disabled on a host, the critical section
+  is a global recursive mutex instead, which keeps the same mutual exclusion between threads.
+*/
+
+typedef void* osThreadId_t;
+
+class Mutex
+{
+  public:
+    void lock(void) { mutex.lock(); }
+    void unlock(void) { mutex.unlock(); }
+
+  private:
+    recursive_mutex mutex;
+};
+
+class ConditionVariable
+{
+  public:
+    ConditionVariable(Mutex& mutex) : mutex(mutex) {}
+    void wait(void) { condition.wait(mutex); }
+    void notify_all(void) { condition.notify_all(); }
+
+  private:
+    Mutex& mutex;
+    condition_variable_any condition;
+};
+
+inline uint32_t __CLZ(uint32_t value)
+{
+  return value == 0 ? 32 : __builtin_clz(value);
+}
+
+inline recursive_mutex& getCriticalSectionMutex(void)
+{
+  static recursive_mutex criticalSection;
+  return criticalSection;
+}
+
+inline void core_util_critical_section_enter(void)
+{
+  getCriticalSectionMutex().lock();
+}
+
+inline void core_util_critical_section_exit(void)
+{
+  getCriticalSectionMutex().unlock();
+}
+
+inline uint32_t core_util_atomic_incr_u32(volatile uint32_t* valuePtr, uint32_t delta)
+{
+  return __atomic_add_fetch(valuePtr, delta, __ATOMIC_SEQ_CST);
+}
+
+inline uint32_t core_util_atomic_decr_u32(volatile uint32_t* valuePtr, uint32_t delta)
+{
+  return __atomic_sub_fetch(valuePtr, delta, __ATOMIC_SEQ_CST);
+}
+
+#endif